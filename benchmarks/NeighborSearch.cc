@@ -0,0 +1,148 @@
+/*
+ * NeighborSearch.cc
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+/*
+ * @file  NeighborSearch.cc
+ * @brief Benchmarks comparing the agent k-D tree and the agent grid as the
+ *        spatial data structure searched for agent neighbors.
+ */
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "RVO.h"
+#include "benchmark/benchmark.h"
+
+namespace {
+/**
+ * @brief     Sets up a crowd of agents distributed uniformly at random in a
+ *            square with a density of about one agent per four square units,
+ *            each heading to the opposite side of the square.
+ * @param[in]  simulator     The simulator instance.
+ * @param[in]  numAgents     The number of agents.
+ * @param[in]  numFarSighted The number of agents whose neighbor distance is
+ *                           four times the default.
+ * @param[out] goals         The goals of the agents.
+ */
+void setupScenario(
+    RVO::RVOSimulator &simulator, /* NOLINT(runtime/references) */
+    std::size_t numAgents, std::size_t numFarSighted,
+    std::vector<RVO::Vector2> &goals) { /* NOLINT(runtime/references) */
+  const float halfSize = std::sqrt(static_cast<float>(numAgents));
+
+  simulator.setTimeStep(0.25F);
+  simulator.setAgentDefaults(5.0F, 10U, 5.0F, 5.0F, 0.5F, 1.5F);
+
+  std::srand(1U);
+  goals.resize(numAgents);
+
+  for (std::size_t i = 0U; i < numAgents; ++i) {
+    const RVO::Vector2 position(
+        halfSize * (2.0F * std::rand() / RAND_MAX - 1.0F),
+        halfSize * (2.0F * std::rand() / RAND_MAX - 1.0F));
+    simulator.addAgent(position);
+    goals[i] = -position;
+  }
+
+  for (std::size_t i = 0U; i < numFarSighted; ++i) {
+    simulator.setAgentNeighborDist(i * (numAgents / numFarSighted), 20.0F);
+  }
+}
+
+/**
+ * @brief     Sets the preferred velocity of each agent toward its goal.
+ * @param[in] simulator The simulator instance.
+ * @param[in] goals     The goals of the agents.
+ */
+void setPreferredVelocities(
+    RVO::RVOSimulator &simulator, /* NOLINT(runtime/references) */
+    const std::vector<RVO::Vector2> &goals) {
+  std::vector<RVO::Vector2> prefVelocities(goals.size());
+
+  for (std::size_t i = 0U; i < goals.size(); ++i) {
+    const RVO::Vector2 goalVector = goals[i] - simulator.getAgentPosition(i);
+    prefVelocities[i] = RVO::absSq(goalVector) > 1.0F
+                            ? RVO::normalize(goalVector)
+                            : goalVector;
+  }
+
+  simulator.setAgentPrefVelocities(&prefVelocities[0], prefVelocities.size());
+}
+
+/**
+ * @brief     Benchmarks simulation steps.
+ * @param[in] state The benchmark state. The first argument is the number of
+ *                  agents, the second is the spatial data structure searched
+ *                  for agent neighbors, and the third is the number of agents
+ *                  with a larger neighbor distance than the rest.
+ */
+void BM_DoStep(benchmark::State &state) { /* NOLINT(runtime/references) */
+  RVO::RVOSimulator simulator;
+  std::vector<RVO::Vector2> goals;
+  setupScenario(simulator, static_cast<std::size_t>(state.range(0)),
+                static_cast<std::size_t>(state.range(2)), goals);
+  simulator.setAgentNeighborSearch(
+      static_cast<RVO::AgentNeighborSearch>(state.range(1)));
+
+  while (state.KeepRunning()) {
+    setPreferredVelocities(simulator, goals);
+    simulator.doStep();
+  }
+
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          state.range(0));
+  state.SetLabel(state.range(1) == RVO::RVO_AGENT_GRID ? "grid" : "k-D tree");
+}
+} /* namespace */
+
+/* Uniform neighbor distances, where the grid is expected to win. */
+BENCHMARK(BM_DoStep)
+    ->ArgNames({"agents", "search", "farSighted"})
+    ->ArgsProduct({{1000, 10000, 100000},
+                   {RVO::RVO_AGENT_KD_TREE, RVO::RVO_AGENT_GRID},
+                   {0}})
+    ->Unit(benchmark::kMillisecond);
+
+/* A few agents with a large neighbor distance inflate the grid cells of every
+ * agent, where the k-D tree is expected to win. */
+BENCHMARK(BM_DoStep)
+    ->ArgNames({"agents", "search", "farSighted"})
+    ->ArgsProduct({{10000, 100000},
+                   {RVO::RVO_AGENT_KD_TREE, RVO::RVO_AGENT_GRID},
+                   {10}})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
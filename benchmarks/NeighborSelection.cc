@@ -0,0 +1,87 @@
+/*
+ * NeighborSelection.cc
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+/*
+ * @file  NeighborSelection.cc
+ * @brief Benchmarks comparing insertion sort and a bounded max-heap for the
+ *        selection of the nearest agent neighbors.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include "RVO.h"
+#include "benchmark/benchmark.h"
+
+namespace {
+/**
+ * @brief     Benchmarks simulation steps of a dense, static crowd in which
+ *            every agent has more agents in range than its maximum neighbor
+ *            count.
+ * @param[in] state The benchmark state. The first argument is the maximum
+ *                  neighbor count, and the second is nonzero to select agent
+ *                  neighbors with a bounded max-heap.
+ */
+void BM_DoStep(benchmark::State &state) { /* NOLINT(runtime/references) */
+  const std::size_t maxNeighbors = static_cast<std::size_t>(state.range(0));
+  const int numAgentsPerSide = 100;
+
+  RVO::RVOSimulator simulator(0.25F, 15.0F, maxNeighbors, 5.0F, 5.0F, 0.5F,
+                              1.5F);
+  simulator.setAgentNeighborHeap(state.range(1) != 0);
+
+  for (int i = 0; i < numAgentsPerSide; ++i) {
+    for (int j = 0; j < numAgentsPerSide; ++j) {
+      /* Jitter the grid so that few neighbors are at equal distances. */
+      simulator.addAgent(
+          RVO::Vector2(1.5F * static_cast<float>(i) + 0.01F * (j % 7),
+                       1.5F * static_cast<float>(j) + 0.01F * (i % 5)));
+    }
+  }
+
+  while (state.KeepRunning()) {
+    simulator.doStep();
+  }
+
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          numAgentsPerSide * numAgentsPerSide);
+  state.SetLabel(state.range(1) != 0 ? "heap" : "insertion sort");
+}
+} /* namespace */
+
+BENCHMARK(BM_DoStep)
+    ->ArgNames({"maxNeighbors", "heap"})
+    ->ArgsProduct({{10, 30, 60}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
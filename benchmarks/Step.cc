@@ -0,0 +1,486 @@
+/*
+ * Step.cc
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+/*
+ * @file  Step.cc
+ * @brief Benchmarks of a simulation step and of each of its phases on the
+ *        Circle and Blocks scenarios of the examples, scaled up to a given
+ *        number of agents, for a range of thread counts.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif /* _OPENMP */
+
+#include "RVO.h"
+#include "benchmark/benchmark.h"
+
+namespace {
+const float RVO_TWO_PI = 6.28318530717958647692F;
+
+/**
+ * @brief The scenarios of the benchmarks.
+ */
+enum Scenario {
+  /**
+   * @brief Agents on a circle heading to the antipodal positions, as in the
+   *        Circle example.
+   */
+  SCENARIO_CIRCLE,
+
+  /**
+   * @brief Groups of agents crossing between four blocks, as in the Blocks
+   *        example, tiled to add agents and obstacles.
+   */
+  SCENARIO_BLOCKS
+};
+
+/**
+ * @brief The layout of the Blocks scenario for a given number of agents.
+ */
+class BlocksLayout {
+ public:
+  /**
+   * @brief     Constructs the layout of the Blocks scenario.
+   * @param[in] numAgents The number of agents.
+   */
+  explicit BlocksLayout(std::size_t numAgents);
+
+  std::size_t tilesPerSide;
+  std::size_t groupSize;
+  std::size_t groupSide;
+  float scale;
+  float pitch;
+};
+
+BlocksLayout::BlocksLayout(std::size_t numAgents) {
+  /* At most 16 x 16 tiles, so that the obstacles stay few enough to build the
+   * obstacle k-D tree in reasonable time. Past that, tiles grow instead. */
+  const std::size_t numTiles =
+      std::min(std::max(numAgents / 100U, static_cast<std::size_t>(1U)),
+               static_cast<std::size_t>(256U));
+  tilesPerSide = static_cast<std::size_t>(
+      std::sqrt(static_cast<float>(numTiles)));
+  groupSize = (numAgents + 4U * tilesPerSide * tilesPerSide - 1U) /
+              (4U * tilesPerSide * tilesPerSide);
+  groupSide = static_cast<std::size_t>(
+      std::ceil(std::sqrt(static_cast<float>(groupSize))));
+  scale = std::max(static_cast<float>(groupSide) / 5.0F, 1.0F);
+  pitch = 2.0F * (55.0F * scale + 10.0F * static_cast<float>(groupSide)) +
+          20.0F;
+}
+
+/**
+ * @brief     Returns the center of a tile of the Blocks scenario.
+ * @param[in] layout The layout of the Blocks scenario.
+ * @param[in] tileNo The number of the tile.
+ * @return    The center of the tile.
+ */
+RVO::Vector2 getTileCenter(const BlocksLayout &layout, std::size_t tileNo) {
+  const float offset = 0.5F * static_cast<float>(layout.tilesPerSide - 1U);
+
+  return layout.pitch *
+         RVO::Vector2(
+             static_cast<float>(tileNo % layout.tilesPerSide) - offset,
+             static_cast<float>(tileNo / layout.tilesPerSide) - offset);
+}
+
+/**
+ * @brief     Adds an axis-aligned rectangular obstacle.
+ * @param[in] simulator The simulator instance.
+ * @param[in] min       The minimum corner of the obstacle.
+ * @param[in] max       The maximum corner of the obstacle.
+ */
+void addBlock(RVO::RVOSimulator &simulator, /* NOLINT(runtime/references) */
+              const RVO::Vector2 &min, const RVO::Vector2 &max) {
+  std::vector<RVO::Vector2> vertices;
+  vertices.push_back(max);
+  vertices.push_back(RVO::Vector2(min.x(), max.y()));
+  vertices.push_back(min);
+  vertices.push_back(RVO::Vector2(max.x(), min.y()));
+  simulator.addObstacle(vertices);
+}
+
+/**
+ * @brief     Adds the four blocks of each tile of the Blocks scenario and
+ *            processes them.
+ * @param[in] simulator The simulator instance.
+ * @param[in] layout    The layout of the Blocks scenario.
+ */
+void addBlocks(RVO::RVOSimulator &simulator, /* NOLINT(runtime/references) */
+               const BlocksLayout &layout) {
+  for (std::size_t i = 0U; i < layout.tilesPerSide * layout.tilesPerSide;
+       ++i) {
+    const RVO::Vector2 center = getTileCenter(layout, i);
+
+    for (int sx = -1; sx <= 1; sx += 2) {
+      for (int sy = -1; sy <= 1; sy += 2) {
+        const RVO::Vector2 corner(static_cast<float>(sx),
+                                  static_cast<float>(sy));
+        const RVO::Vector2 a = center + 10.0F * layout.scale * corner;
+        const RVO::Vector2 b = center + 40.0F * layout.scale * corner;
+        addBlock(simulator,
+                 RVO::Vector2(std::min(a.x(), b.x()), std::min(a.y(), b.y())),
+                 RVO::Vector2(std::max(a.x(), b.x()), std::max(a.y(), b.y())));
+      }
+    }
+  }
+}
+
+/**
+ * @brief      Sets up a scenario.
+ * @param[in]  simulator The simulator instance.
+ * @param[in]  scenario  The scenario.
+ * @param[in]  numAgents The number of agents.
+ * @param[out] goals     The goals of the agents.
+ */
+void setupScenario(
+    RVO::RVOSimulator &simulator, /* NOLINT(runtime/references) */
+    Scenario scenario, std::size_t numAgents,
+    std::vector<RVO::Vector2> &goals) { /* NOLINT(runtime/references) */
+  simulator.setTimeStep(0.25F);
+  goals.clear();
+  goals.reserve(numAgents);
+
+  if (scenario == SCENARIO_CIRCLE) {
+    /* The same spacing between agents as 250 agents on a circle of radius
+     * 200 in the Circle example. */
+    const float radius = 0.8F * static_cast<float>(numAgents);
+    simulator.setAgentDefaults(15.0F, 10U, 10.0F, 10.0F, 1.5F, 2.0F);
+
+    for (std::size_t i = 0U; i < numAgents; ++i) {
+      const float angle = static_cast<float>(i) * RVO_TWO_PI /
+                          static_cast<float>(numAgents);
+      simulator.addAgent(radius *
+                         RVO::Vector2(std::cos(angle), std::sin(angle)));
+      goals.push_back(-simulator.getAgentPosition(i));
+    }
+  } else {
+    const BlocksLayout layout(numAgents);
+    simulator.setAgentDefaults(15.0F, 10U, 5.0F, 5.0F, 2.0F, 2.0F);
+
+    for (std::size_t i = 0U; i < layout.tilesPerSide * layout.tilesPerSide;
+         ++i) {
+      const RVO::Vector2 center = getTileCenter(layout, i);
+
+      for (std::size_t j = 0U; j < layout.groupSize; ++j) {
+        const float u = 55.0F * layout.scale +
+                        10.0F * static_cast<float>(j % layout.groupSide);
+        const float v = 55.0F * layout.scale +
+                        10.0F * static_cast<float>(j / layout.groupSide);
+
+        for (int sx = -1; sx <= 1; sx += 2) {
+          for (int sy = -1; sy <= 1; sy += 2) {
+            if (simulator.getNumAgents() < numAgents) {
+              simulator.addAgent(
+                  center + RVO::Vector2(static_cast<float>(sx) * u,
+                                        static_cast<float>(sy) * v));
+              goals.push_back(center +
+                              75.0F * layout.scale *
+                                  RVO::Vector2(static_cast<float>(-sx),
+                                               static_cast<float>(-sy)));
+            }
+          }
+        }
+      }
+    }
+
+    addBlocks(simulator, layout);
+    simulator.processObstacles();
+  }
+}
+
+/**
+ * @brief     Sets the preferred velocity of each agent toward its goal.
+ * @param[in] simulator The simulator instance.
+ * @param[in] goals     The goals of the agents.
+ */
+void setPreferredVelocities(
+    RVO::RVOSimulator &simulator, /* NOLINT(runtime/references) */
+    const std::vector<RVO::Vector2> &goals) {
+  std::vector<RVO::Vector2> prefVelocities(goals.size());
+
+  for (std::size_t i = 0U; i < goals.size(); ++i) {
+    const RVO::Vector2 goalVector = goals[i] - simulator.getAgentPosition(i);
+    prefVelocities[i] = RVO::absSq(goalVector) > 1.0F
+                            ? RVO::normalize(goalVector)
+                            : goalVector;
+  }
+
+  simulator.setAgentPrefVelocities(&prefVelocities[0], prefVelocities.size());
+}
+
+/**
+ * @brief     Sets the number of threads of the simulation.
+ * @param[in] numThreads The number of threads.
+ */
+void setNumThreads(std::int64_t numThreads) {
+#ifdef _OPENMP
+  omp_set_num_threads(static_cast<int>(numThreads));
+#else
+  static_cast<void>(numThreads);
+#endif /* _OPENMP */
+}
+
+/**
+ * @brief     Sets up the scenario and thread count of a benchmark and takes a
+ *            few simulation steps so that the agents are moving and have
+ *            neighbors.
+ * @param[in] state     The benchmark state. The first argument is the
+ *                      scenario, the second is the number of agents, and the
+ *                      third is the number of threads.
+ * @param[in] simulator The simulator instance.
+ */
+void setupBenchmark(
+    const benchmark::State &state,
+    RVO::RVOSimulator &simulator) { /* NOLINT(runtime/references) */
+  std::vector<RVO::Vector2> goals;
+  setNumThreads(state.range(2));
+  setupScenario(simulator, static_cast<Scenario>(state.range(0)),
+                static_cast<std::size_t>(state.range(1)), goals);
+
+  for (std::size_t i = 0U; i < 4U; ++i) {
+    setPreferredVelocities(simulator, goals);
+    simulator.doStep();
+  }
+}
+
+/**
+ * @brief     Reports the agents processed per second by a benchmark.
+ * @param[in] state     The benchmark state.
+ * @param[in] simulator The simulator instance.
+ */
+void setAgentsProcessed(
+    benchmark::State &state, /* NOLINT(runtime/references) */
+    const RVO::RVOSimulator &simulator) {
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          static_cast<std::int64_t>(simulator.getNumAgents()));
+  state.SetLabel(state.range(0) == SCENARIO_CIRCLE ? "Circle" : "Blocks");
+}
+
+/**
+ * @brief     Benchmarks whole simulation steps.
+ * @param[in] state The benchmark state.
+ */
+void BM_DoStep(benchmark::State &state) { /* NOLINT(runtime/references) */
+  RVO::RVOSimulator simulator;
+  setupBenchmark(state, simulator);
+
+  while (state.KeepRunning()) {
+    simulator.doStep();
+  }
+
+  setAgentsProcessed(state, simulator);
+}
+
+/**
+ * @brief     Benchmarks whole simulation steps taken four at a time with
+ *            doStep(std::size_t), reusing candidate agent neighbors across
+ *            the steps.
+ * @param[in] state The benchmark state.
+ */
+void BM_DoSubSteps(benchmark::State &state) { /* NOLINT(runtime/references) */
+  const std::size_t numSubSteps = 4U;
+  RVO::RVOSimulator simulator;
+  setupBenchmark(state, simulator);
+
+  /* Half the skin is the distance an agent moves at its maximum speed in the
+   * steps, so that the candidates last a whole call. */
+  simulator.setAgentNeighborSkin(2.0F * static_cast<float>(numSubSteps) *
+                                 simulator.getTimeStep() *
+                                 simulator.getAgentMaxSpeed(0U));
+
+  while (state.KeepRunning()) {
+    simulator.doStep(numSubSteps);
+  }
+
+  setAgentsProcessed(state, simulator);
+  state.SetItemsProcessed(state.items_processed() *
+                          static_cast<std::int64_t>(numSubSteps));
+}
+
+/**
+ * @brief     Benchmarks building the agent k-D tree.
+ * @param[in] state The benchmark state.
+ */
+void BM_BuildAgentTree(
+    benchmark::State &state) { /* NOLINT(runtime/references) */
+  RVO::RVOSimulator simulator;
+  setupBenchmark(state, simulator);
+
+  while (state.KeepRunning()) {
+    simulator.buildAgentTree();
+  }
+
+  setAgentsProcessed(state, simulator);
+}
+
+/**
+ * @brief     Benchmarks computing the neighbors of the agents.
+ * @param[in] state The benchmark state.
+ */
+void BM_ComputeAgentNeighbors(
+    benchmark::State &state) { /* NOLINT(runtime/references) */
+  RVO::RVOSimulator simulator;
+  setupBenchmark(state, simulator);
+
+  while (state.KeepRunning()) {
+    simulator.computeAgentNeighbors();
+  }
+
+  setAgentsProcessed(state, simulator);
+}
+
+/**
+ * @brief     Benchmarks computing the new velocities of the agents.
+ * @param[in] state The benchmark state.
+ */
+void BM_ComputeAgentNewVelocities(
+    benchmark::State &state) { /* NOLINT(runtime/references) */
+  RVO::RVOSimulator simulator;
+  setupBenchmark(state, simulator);
+
+  while (state.KeepRunning()) {
+    simulator.computeAgentNewVelocities();
+  }
+
+  setAgentsProcessed(state, simulator);
+}
+
+/**
+ * @brief     Benchmarks updating the positions and velocities of the agents.
+ * @param[in] state The benchmark state.
+ */
+void BM_UpdateAgents(benchmark::State &state) { /* NOLINT(runtime/references) */
+  RVO::RVOSimulator simulator;
+  setupBenchmark(state, simulator);
+
+  while (state.KeepRunning()) {
+    simulator.updateAgents();
+  }
+
+  setAgentsProcessed(state, simulator);
+}
+
+/**
+ * @brief     Benchmarks building the obstacle k-D tree of the Blocks scenario,
+ *            reporting the obstacle vertices processed per second.
+ * @param[in] state The benchmark state. The arguments are the number of agents
+ *                  that the scenario is tiled for and the number of split
+ *                  candidates, zero to evaluate every obstacle edge.
+ */
+void BM_BuildObstacleTree(
+    benchmark::State &state) { /* NOLINT(runtime/references) */
+  const BlocksLayout layout(static_cast<std::size_t>(state.range(0)));
+  std::size_t numVertices = 0U;
+
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    RVO::RVOSimulator *const simulator = new RVO::RVOSimulator();
+    simulator->setObstacleTreeSplitCandidates(
+        static_cast<std::size_t>(state.range(1)));
+    addBlocks(*simulator, layout);
+    numVertices = simulator->getNumObstacleVertices();
+    state.ResumeTiming();
+
+    simulator->processObstacles();
+
+    state.PauseTiming();
+    delete simulator;
+    state.ResumeTiming();
+  }
+
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          static_cast<std::int64_t>(numVertices));
+}
+
+/**
+ * @brief     Returns the thread counts to sweep, the powers of two less than
+ *            the number of processors followed by the number of processors.
+ * @return    The thread counts.
+ */
+std::vector<std::int64_t> getThreadCounts() {
+  std::vector<std::int64_t> threadCounts;
+#ifdef _OPENMP
+  const std::int64_t numProcs = omp_get_num_procs();
+#else
+  const std::int64_t numProcs = 1;
+#endif /* _OPENMP */
+
+  for (std::int64_t i = 1; i < numProcs; i *= 2) {
+    threadCounts.push_back(i);
+  }
+
+  threadCounts.push_back(numProcs);
+
+  return threadCounts;
+}
+
+/**
+ * @brief     Sweeps the scenarios, numbers of agents, and thread counts.
+ * @param[in] benchmark The benchmark.
+ */
+void applyStepArguments(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgNames({"scenario", "agents", "threads"})
+      ->ArgsProduct({{SCENARIO_CIRCLE, SCENARIO_BLOCKS},
+                     {1000, 10000, 100000, 1000000},
+                     getThreadCounts()})
+      ->Unit(benchmark::kMillisecond)
+      ->UseRealTime();
+}
+} /* namespace */
+
+BENCHMARK(BM_DoStep)->Apply(applyStepArguments);
+BENCHMARK(BM_DoSubSteps)->Apply(applyStepArguments);
+BENCHMARK(BM_BuildAgentTree)->Apply(applyStepArguments);
+BENCHMARK(BM_ComputeAgentNeighbors)->Apply(applyStepArguments);
+BENCHMARK(BM_ComputeAgentNewVelocities)->Apply(applyStepArguments);
+BENCHMARK(BM_UpdateAgents)->Apply(applyStepArguments);
+
+/* The obstacle k-D tree is built serially, so there is no thread sweep. */
+BENCHMARK(BM_BuildObstacleTree)
+    ->ArgNames({"agents", "candidates"})
+    ->Args({1000, 0})
+    ->Args({10000, 0})
+    ->Args({100000, 0})
+    ->Args({100000, 64})
+    ->Args({100000, 16})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
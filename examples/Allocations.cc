@@ -0,0 +1,146 @@
+/*
+ * Allocations.cc
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+/*
+ * @file  Allocations.cc
+ * @brief Test that counts the heap allocations of simulation steps and checks
+ *        that, once agents have their neighbors, a step makes none.
+ */
+
+#include <atomic> /* NOLINT(build/c++11) */
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "RVO.h"
+
+namespace {
+const float RVO_TWO_PI = 6.28318530717958647692F;
+
+const std::size_t RVO_NUM_AGENTS = 250U;
+
+const std::size_t RVO_NUM_WARM_UP_STEPS = 100U;
+
+const std::size_t RVO_NUM_COUNTED_STEPS = 100U;
+
+/* Counts calls to the replaceable global allocation functions, from any
+ * thread. */
+std::atomic<std::size_t> numAllocations(0U);
+
+void setupScenario(
+    RVO::RVOSimulator *simulator,
+    std::vector<RVO::Vector2> &goals) { /* NOLINT(runtime/references) */
+  simulator->setTimeStep(0.25F);
+  simulator->setAgentDefaults(15.0F, 10U, 10.0F, 10.0F, 1.5F, 2.0F);
+
+  /* Agents on a circle moving to the antipodal positions, around an obstacle
+   * at the center so that the obstacle neighbor search runs too. */
+  for (std::size_t i = 0U; i < RVO_NUM_AGENTS; ++i) {
+    const float angle = static_cast<float>(i) * RVO_TWO_PI /
+                        static_cast<float>(RVO_NUM_AGENTS);
+    simulator->addAgent(200.0F *
+                        RVO::Vector2(std::cos(angle), std::sin(angle)));
+    goals.push_back(-simulator->getAgentPosition(i));
+  }
+
+  std::vector<RVO::Vector2> obstacle;
+  obstacle.push_back(RVO::Vector2(-10.0F, -10.0F));
+  obstacle.push_back(RVO::Vector2(10.0F, -10.0F));
+  obstacle.push_back(RVO::Vector2(10.0F, 10.0F));
+  obstacle.push_back(RVO::Vector2(-10.0F, 10.0F));
+  simulator->addObstacle(obstacle);
+  simulator->processObstacles();
+}
+
+void setPreferredVelocities(RVO::RVOSimulator *simulator,
+                            const std::vector<RVO::Vector2> &goals) {
+  for (std::size_t i = 0U; i < simulator->getNumAgents(); ++i) {
+    RVO::Vector2 goalVector = goals[i] - simulator->getAgentPosition(i);
+
+    if (RVO::absSq(goalVector) > 1.0F) {
+      goalVector = RVO::normalize(goalVector);
+    }
+
+    simulator->setAgentPrefVelocity(i, goalVector);
+  }
+}
+} /* namespace */
+
+void *operator new(std::size_t size) {
+  ++numAllocations;
+
+  void *const pointer = std::malloc(size > 0U ? size : 1U);
+
+  if (pointer == NULL) {
+    throw std::bad_alloc();
+  }
+
+  return pointer;
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete(void *pointer) throw() { std::free(pointer); }
+
+void operator delete[](void *pointer) throw() { std::free(pointer); }
+
+int main() {
+  RVO::RVOSimulator simulator;
+  std::vector<RVO::Vector2> goals;
+  setupScenario(&simulator, goals);
+
+  /* Lets the agents find their neighbors, so that the scratch storage of the
+   * steps reaches its steady-state capacity. */
+  for (std::size_t i = 0U; i < RVO_NUM_WARM_UP_STEPS; ++i) {
+    setPreferredVelocities(&simulator, goals);
+    simulator.doStep();
+  }
+
+  const std::size_t numWarmUpAllocations = numAllocations;
+
+  for (std::size_t i = 0U; i < RVO_NUM_COUNTED_STEPS; ++i) {
+    setPreferredVelocities(&simulator, goals);
+    simulator.doStep();
+  }
+
+  const std::size_t numStepAllocations = numAllocations - numWarmUpAllocations;
+
+  std::printf("%lu allocations in %lu steady-state steps\n",
+              static_cast<unsigned long>(numStepAllocations),
+              static_cast<unsigned long>(RVO_NUM_COUNTED_STEPS));
+
+  return numStepAllocations == 0U ? 0 : 1;
+}
@@ -81,15 +81,18 @@ void setupScenario(
 }
 
 #if RVO_OUTPUT_TIME_AND_POSITIONS
-void updateVisualization(RVO::RVOSimulator *simulator) {
+void updateVisualization(RVO::RVOSimulator *simulator, float agentRadius) {
   /* Output the current global time. */
   std::cout << simulator->getGlobalTime();
   RVO::Vector2 origin = {GetScreenWidth() / 2.0f, GetScreenHeight() / 2.0f};
 
-  /* Output the current position of all the agents. */
+  /* Output the current position of all the agents, read directly from the
+   * simulator's contiguous position storage. The radius of the agents is
+   * passed in, since it may not be queried while a step is pending. */
+  const RVO::Vector2 *agentPositions = simulator->getAgentPositionBuffer();
+
   for (std::size_t i = 0U; i < simulator->getNumAgents(); ++i) {
-    RVO::Vector2 agentPosition = simulator->getAgentPosition(i);
-    float agentRadius = simulator->getAgentRadius(i);
+    RVO::Vector2 agentPosition = agentPositions[i];
     std::cout << " " << agentPosition;
     DrawCircle(agentPosition.x() + origin.x(), agentPosition.y() + origin.y(), agentRadius, RED);
   }
@@ -102,18 +105,23 @@ void setPreferredVelocities(RVO::RVOSimulator *simulator,
                             const std::vector<RVO::Vector2> &goals) {
   /* Set the preferred velocity to be a vector of unit magnitude (speed) in the
    * direction of the goal. */
+  const RVO::Vector2 *agentPositions = simulator->getAgentPositionBuffer();
+  std::vector<RVO::Vector2> prefVelocities(simulator->getNumAgents());
+
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif /* _OPENMP */
   for (int i = 0; i < static_cast<int>(simulator->getNumAgents()); ++i) {
-    RVO::Vector2 goalVector = goals[i] - simulator->getAgentPosition(i);
+    RVO::Vector2 goalVector = goals[i] - agentPositions[i];
 
     if (RVO::absSq(goalVector) > 1.0F) {
       goalVector = RVO::normalize(goalVector);
     }
 
-    simulator->setAgentPrefVelocity(i, goalVector);
+    prefVelocities[i] = goalVector;
   }
+
+  simulator->setAgentPrefVelocities(&prefVelocities[0], prefVelocities.size());
 }
 
 bool reachedGoal(RVO::RVOSimulator *simulator,
@@ -140,16 +148,29 @@ int main() {
   /* Set up the scenario. */
   setupScenario(simulator, goals);
 
+#if RVO_OUTPUT_TIME_AND_POSITIONS
+  /* All agents share the default radius. */
+  const float agentRadius = simulator->getAgentRadius(0U);
+#endif /* RVO_OUTPUT_TIME_AND_POSITIONS */
+
   /* Perform and manipulate the simulation. */
   InitWindow(800, 600, "Circle ORCA Visualization");
+  setPreferredVelocities(simulator, goals);
+
   do {
     BeginDrawing();
     ClearBackground(BLACK);
+
+    /* Run the step while this frame is drawn and the preferred velocities of
+     * the next step are set. Until waitStep(), only the positions as of the
+     * start of the step may be read, so the preferred velocities trail the
+     * positions by one frame. */
+    simulator->beginStepAsync();
 #if RVO_OUTPUT_TIME_AND_POSITIONS
-    updateVisualization(simulator);
+    updateVisualization(simulator, agentRadius);
 #endif /* RVO_OUTPUT_TIME_AND_POSITIONS */
     setPreferredVelocities(simulator, goals);
-    simulator->doStep();
+    simulator->waitStep();
     EndDrawing();
   } while (!reachedGoal(simulator, goals));
 
@@ -239,15 +239,26 @@ void updateVisualization(RVO::RVOSimulator *simulator) {
 void buildRoadmap(
     RVO::RVOSimulator *simulator,
     std::vector<RoadmapVertex> &roadmap) { /* NOLINT(runtime/references) */
-  /* Connect the roadmap vertices by edges if mutually visible. */
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif /* _OPENMP */
-  for (int i = 0; i < static_cast<int>(roadmap.size()); ++i) {
-    for (int j = 0; j < static_cast<int>(roadmap.size()); ++j) {
-      if (simulator->queryVisibility(roadmap[i].position, roadmap[j].position,
-                                     simulator->getAgentRadius(0U))) {
-        roadmap[i].neighbors.push_back(j);
+  /* Connect the roadmap vertices by edges if mutually visible, querying the
+   * visibility of all pairs of vertices at once. */
+  std::vector<std::pair<RVO::Vector2, RVO::Vector2> > segments;
+  segments.reserve(roadmap.size() * roadmap.size());
+
+  for (std::size_t i = 0U; i < roadmap.size(); ++i) {
+    for (std::size_t j = 0U; j < roadmap.size(); ++j) {
+      segments.push_back(
+          std::make_pair(roadmap[i].position, roadmap[j].position));
+    }
+  }
+
+  bool *const visible = new bool[segments.size()];
+  simulator->queryVisibility(&segments[0], segments.size(),
+                             simulator->getAgentRadius(0U), visible);
+
+  for (std::size_t i = 0U; i < roadmap.size(); ++i) {
+    for (std::size_t j = 0U; j < roadmap.size(); ++j) {
+      if (visible[i * roadmap.size() + j]) {
+        roadmap[i].neighbors.push_back(static_cast<int>(j));
       }
     }
 
@@ -255,6 +266,8 @@ void buildRoadmap(
     roadmap[i].distToGoal.resize(4U, std::numeric_limits<float>::infinity());
   }
 
+  delete[] visible;
+
   /* Compute the distance to each of the four goals (the first four vertices)
    * for all vertices using Dijkstra's algorithm. */
 #ifdef _OPENMP
@@ -42,8 +42,12 @@
 #include <cmath>
 #include <limits>
 
+#include "AgentGrid.h"
+#include "AgentProfile.h"
 #include "KdTree.h"
 #include "Obstacle.h"
+#include "RVOSimulator.h"
+#include "Simd.h"
 
 namespace RVO {
 namespace {
@@ -53,14 +57,15 @@ namespace {
  *                 subject to linear constraints defined by lines and a circular
  *                 constraint.
  * @param[in]      lines        Lines defining the linear constraints.
- * @param[in]      lineNo       The specified line constraint.
+ * @param[in]      lineNo       The specified line constraint. The lines before
+ *                              it are the constraints.
  * @param[in]      radius       The radius of the circular constraint.
  * @param[in]      optVelocity  The optimization velocity.
  * @param[in]      directionOpt True if the direction should be optimized.
  * @param[in, out] result       A reference to the result of the linear program.
  * @return         True if successful.
  */
-bool linearProgram1(const std::vector<Line> &lines, std::size_t lineNo,
+bool linearProgram1(const Line *lines, std::size_t lineNo,
                     float radius, const Vector2 &optVelocity, bool directionOpt,
                     Vector2 &result) { /* NOLINT(runtime/references) */
   const float dotProduct = lines[lineNo].point * lines[lineNo].direction;
@@ -136,6 +141,7 @@ bool linearProgram1(const std::vector<Line> &lines, std::size_t lineNo,
  * @brief          Solves a two-dimensional linear program subject to linear
  *                 constraints defined by lines and a circular constraint.
  * @param[in]      lines        Lines defining the linear constraints.
+ * @param[in]      numLines     The number of lines.
  * @param[in]      radius       The radius of the circular constraint.
  * @param[in]      optVelocity  The optimization velocity.
  * @param[in]      directionOpt True if the direction should be optimized.
@@ -143,8 +149,9 @@ bool linearProgram1(const std::vector<Line> &lines, std::size_t lineNo,
  * @return         The number of the line it fails on, and the number of lines
  *                 if successful.
  */
-std::size_t linearProgram2(const std::vector<Line> &lines, float radius,
-                           const Vector2 &optVelocity, bool directionOpt,
+std::size_t linearProgram2(const Line *lines, std::size_t numLines,
+                           float radius, const Vector2 &optVelocity,
+                           bool directionOpt,
                            Vector2 &result) { /* NOLINT(runtime/references) */
   if (directionOpt) {
     /* Optimize direction. Note that the optimization velocity is of unit length
@@ -159,7 +166,7 @@ std::size_t linearProgram2(const std::vector<Line> &lines, float radius,
     result = optVelocity;
   }
 
-  for (std::size_t i = 0U; i < lines.size(); ++i) {
+  for (std::size_t i = 0U; i < numLines; ++i) {
     if (det(lines[i].direction, lines[i].point - result) > 0.0F) {
       /* Result does not satisfy constraint i. Compute new optimal result. */
       const Vector2 tempResult = result;
@@ -173,7 +180,7 @@ std::size_t linearProgram2(const std::vector<Line> &lines, float radius,
     }
   }
 
-  return lines.size();
+  return numLines;
 }
 
 /**
@@ -181,22 +188,26 @@ std::size_t linearProgram2(const std::vector<Line> &lines, float radius,
  * @brief          Solves a two-dimensional linear program subject to linear
  *                 constraints defined by lines and a circular constraint.
  * @param[in]      lines        Lines defining the linear constraints.
+ * @param[in]      numLines     The number of lines.
  * @param[in]      numObstLines Count of obstacle lines.
  * @param[in]      beginLine    The line on which the 2-d linear program failed.
  * @param[in]      radius       The radius of the circular constraint.
  * @param[in, out] result       A reference to the result of the linear program.
+ * @param[out]     projLines    Scratch storage for the projected lines, with
+ *                              room for at least numLines lines.
  */
-void linearProgram3(const std::vector<Line> &lines, std::size_t numObstLines,
-                    std::size_t beginLine, float radius,
-                    Vector2 &result) { /* NOLINT(runtime/references) */
+void linearProgram3(const Line *lines, std::size_t numLines,
+                    std::size_t numObstLines, std::size_t beginLine,
+                    float radius,
+                    Vector2 &result, /* NOLINT(runtime/references) */
+                    Line *projLines) {
   float distance = 0.0F;
 
-  for (std::size_t i = beginLine; i < lines.size(); ++i) {
+  for (std::size_t i = beginLine; i < numLines; ++i) {
     if (det(lines[i].direction, lines[i].point - result) > distance) {
       /* Result does not satisfy constraint of line i. */
-      std::vector<Line> projLines(
-          lines.begin(),
-          lines.begin() + static_cast<std::ptrdiff_t>(numObstLines));
+      std::copy(lines, lines + numObstLines, projLines);
+      std::size_t numProjLines = numObstLines;
 
       for (std::size_t j = numObstLines; j < i; ++j) {
         Line line;
@@ -220,15 +231,15 @@ void linearProgram3(const std::vector<Line> &lines, std::size_t numObstLines,
         }
 
         line.direction = normalize(lines[j].direction - lines[i].direction);
-        projLines.push_back(line);
+        projLines[numProjLines++] = line;
       }
 
       const Vector2 tempResult = result;
 
       if (linearProgram2(
-              projLines, radius,
+              projLines, numProjLines, radius,
               Vector2(-lines[i].direction.y(), lines[i].direction.x()), true,
-              result) < projLines.size()) {
+              result) < numProjLines) {
         /* This should in principle not happen. The result is by definition
          * already in the feasible region of this linear program. If it fails,
          * it is due to small floating point error, and the current result is
@@ -240,45 +251,222 @@ void linearProgram3(const std::vector<Line> &lines, std::size_t numObstLines,
     }
   }
 }
+
+/**
+ * @relates   Agent
+ * @brief     Returns the squared range within which agent neighbors can tie
+ *            with the farthest agent neighbor found so far.
+ * @param[in] distSq The squared distance to the farthest agent neighbor.
+ * @return    The smallest float greater than the squared distance.
+ */
+inline float tieRangeSq(float distSq) {
+  return std::nextafter(distSq, std::numeric_limits<float>::infinity());
+}
+
+/**
+ * @relates        Agent
+ * @brief          Replaces the largest element of a max-heap and restores the
+ *                 heap by sifting the replacement down.
+ * @param[in, out] heap  The max-heap. Must not be empty.
+ * @param[in]      value The replacement of the largest element. Must be less
+ *                       than it.
+ */
+void replaceHeapTop(
+    std::vector<std::pair<float, std::size_t> >
+        &heap, /* NOLINT(runtime/references) */
+    const std::pair<float, std::size_t> &value) {
+  const std::size_t size = heap.size();
+  std::size_t i = 0U;
+
+  while (2U * i + 1U < size) {
+    std::size_t child = 2U * i + 1U;
+
+    if (child + 1U < size && heap[child] < heap[child + 1U]) {
+      ++child;
+    }
+
+    if (!(value < heap[child])) {
+      break;
+    }
+
+    heap[i] = heap[child];
+    i = child;
+  }
+
+  heap[i] = value;
+}
 } /* namespace */
 
-Agent::Agent()
-    : id_(0U),
+Agent::Agent(RVOSimulator *simulator)
+    : simulator_(simulator),
+      id_(0U),
       maxNeighbors_(0U),
-      maxSpeed_(0.0F),
-      neighborDist_(0.0F),
-      radius_(0.0F),
-      timeHorizon_(0.0F),
-      timeHorizonObst_(0.0F) {}
+      profileNo_(0U),
+      collectingAgentCandidates_(false),
+      ghost_(false),
+      sleeping_(false),
+      stationary_(false) {
+#ifdef RVO_ENABLE_PROFILING
+  agentNeighborsInserted_ = 0U;
+  agentTreeNodesVisited_ = 0U;
+  linearProgram3Calls_ = 0U;
+  obstacleLinesSkipped_ = 0U;
+  obstacleTreeNodesVisited_ = 0U;
+#endif /* RVO_ENABLE_PROFILING */
+}
 
 Agent::~Agent() {}
 
-void Agent::computeNeighbors(const KdTree *kdTree) {
+void Agent::computeAgentORCALines(float invTimeHorizon, float invTimeStep,
+                                  Line *lines) const {
+  const Vector2 &position = simulator_->agentPositions_[id_];
+  const Vector2 &velocity = simulator_->agentVelocities_[id_];
+  const float radius = simulator_->agentRadii_[id_];
+
+  /* A batch of neighbors at a time. */
+  AgentLineBatch batch;
+
+  for (std::size_t i = 0U; i < agentNeighbors_.size();
+       i += RVO_AGENT_LINE_BATCH_SIZE) {
+    const std::size_t numNeighbors =
+        std::min(agentNeighbors_.size() - i, RVO_AGENT_LINE_BATCH_SIZE);
+
+    for (std::size_t j = 0U; j < RVO_AGENT_LINE_BATCH_SIZE; ++j) {
+      if (j < numNeighbors) {
+        const std::size_t other = agentNeighbors_[i + j].second;
+
+        const Vector2 relativePosition =
+            simulator_->agentPositions_[other] - position;
+        const Vector2 relativeVelocity =
+            velocity - simulator_->agentVelocities_[other];
+
+        batch.relativePositionX[j] = relativePosition.x();
+        batch.relativePositionY[j] = relativePosition.y();
+        batch.relativeVelocityX[j] = relativeVelocity.x();
+        batch.relativeVelocityY[j] = relativeVelocity.y();
+        batch.combinedRadius[j] = radius + simulator_->agentRadii_[other];
+      } else {
+        /* Pad the batch with a neighbor that does not collide. */
+        batch.relativePositionX[j] = 1.0F;
+        batch.relativePositionY[j] = 0.0F;
+        batch.relativeVelocityX[j] = 0.0F;
+        batch.relativeVelocityY[j] = 0.0F;
+        batch.combinedRadius[j] = 0.0F;
+      }
+    }
+
+    computeAgentLines(batch, numNeighbors, velocity, invTimeHorizon,
+                      invTimeStep, lines + i);
+  }
+}
+
+void Agent::computeAgentCandidates(const KdTree *kdTree,
+                                   const AgentGrid *agentGrid,
+                                   float neighborDist) {
+  const float range = neighborDist + simulator_->agentNeighborSkin_;
+  float rangeSq = range * range;
+
+  /* Every agent within range is inserted, so the range never shrinks. */
+  agentCandidates_.clear();
+  collectingAgentCandidates_ = true;
+
+  if (agentGrid != NULL) {
+    agentGrid->computeAgentNeighbors(this, rangeSq);
+  } else {
+    kdTree->computeAgentNeighbors(this, rangeSq);
+  }
+
+  collectingAgentCandidates_ = false;
+}
+
+void Agent::computeNeighbors(const KdTree *kdTree,
+                             const AgentGrid *agentGrid) {
+#ifdef RVO_ENABLE_PROFILING
+  agentNeighborsInserted_ = 0U;
+  agentTreeNodesVisited_ = 0U;
+  obstacleTreeNodesVisited_ = 0U;
+#endif /* RVO_ENABLE_PROFILING */
+
+  const AgentProfile &profile = simulator_->agentProfiles_[profileNo_];
+  maxNeighbors_ = profile.maxNeighbors;
+
   obstacleNeighbors_.clear();
-  const float range = timeHorizonObst_ * maxSpeed_ + radius_;
-  kdTree->computeObstacleNeighbors(this, range * range);
+  kdTree->computeObstacleNeighbors(this, profile.obstacleRangeSq);
 
   agentNeighbors_.clear();
 
   if (maxNeighbors_ > 0U) {
-    float rangeSq = neighborDist_ * neighborDist_;
-    kdTree->computeAgentNeighbors(this, rangeSq);
+    /* Only allocates the first time, or when the maximum neighbor count is
+     * raised. */
+    agentNeighbors_.reserve(
+        std::min(maxNeighbors_, simulator_->agents_.size() - 1U));
+
+    float rangeSq = profile.neighborDistSq;
+
+    if (simulator_->subStepping_) {
+      if (simulator_->agentCandidatesStale_) {
+        computeAgentCandidates(kdTree, agentGrid, profile.neighborDist);
+      }
+
+      for (std::size_t i = 0U; i < agentCandidates_.size(); ++i) {
+        insertAgentNeighbor(agentCandidates_[i], rangeSq);
+      }
+    } else if (agentGrid != NULL) {
+      agentGrid->computeAgentNeighbors(this, rangeSq);
+    } else {
+      kdTree->computeAgentNeighbors(this, rangeSq);
+    }
+
+    if (simulator_->agentNeighborHeap_) {
+      std::sort(agentNeighbors_.begin(), agentNeighbors_.end());
+    }
   }
 }
 
 /* Search for the best new velocity. */
-void Agent::computeNewVelocity(float timeStep) {
+void Agent::computeNewVelocity(
+    float invTimeStep,
+    std::vector<Line> &projLines) { /* NOLINT(runtime/references) */
+  /* Selects the fixed-capacity kernel if there are no obstacle lines and the
+   * agent lines fit. */
+  if (obstacleNeighbors_.empty()) {
+    if (agentNeighbors_.size() <= RVO_SMALL_AGENT_LINE_CAPACITY) {
+      computeNewVelocityWithoutObstacles<RVO_SMALL_AGENT_LINE_CAPACITY>(
+          invTimeStep);
+      return;
+    }
+
+    if (agentNeighbors_.size() <= RVO_LARGE_AGENT_LINE_CAPACITY) {
+      computeNewVelocityWithoutObstacles<RVO_LARGE_AGENT_LINE_CAPACITY>(
+          invTimeStep);
+      return;
+    }
+  }
+
+  const Vector2 &position = simulator_->agentPositions_[id_];
+  const Vector2 &velocity = simulator_->agentVelocities_[id_];
+  const float radius = simulator_->agentRadii_[id_];
+
+#ifdef RVO_ENABLE_PROFILING
+  linearProgram3Calls_ = 0U;
+  obstacleLinesSkipped_ = 0U;
+#endif /* RVO_ENABLE_PROFILING */
+
   orcaLines_.clear();
+  orcaLines_.reserve(obstacleNeighbors_.size() + agentNeighbors_.capacity());
 
-  const float invTimeHorizonObst = 1.0F / timeHorizonObst_;
+  const AgentProfile &profile = simulator_->agentProfiles_[profileNo_];
+  const float invTimeHorizonObst = profile.invTimeHorizonObst;
+  const std::vector<Obstacle> &obstacles =
+      simulator_->obstacleWorld_->obstacles_;
 
   /* Create obstacle ORCA lines. */
   for (std::size_t i = 0U; i < obstacleNeighbors_.size(); ++i) {
-    const Obstacle *obstacle1 = obstacleNeighbors_[i].second;
-    const Obstacle *obstacle2 = obstacle1->next_;
+    const Obstacle *obstacle1 = &obstacles[obstacleNeighbors_[i].second];
+    const Obstacle *obstacle2 = &obstacles[obstacle1->next_];
 
-    const Vector2 relativePosition1 = obstacle1->point_ - position_;
-    const Vector2 relativePosition2 = obstacle2->point_ - position_;
+    const Vector2 relativePosition1 = obstacle1->point_ - position;
+    const Vector2 relativePosition2 = obstacle2->point_ - position;
 
     /* Check if velocity obstacle of obstacle is already taken care of by
      * previously constructed obstacle ORCA lines. */
@@ -287,11 +475,11 @@ void Agent::computeNewVelocity(float timeStep) {
     for (std::size_t j = 0U; j < orcaLines_.size(); ++j) {
       if (det(invTimeHorizonObst * relativePosition1 - orcaLines_[j].point,
               orcaLines_[j].direction) -
-                  invTimeHorizonObst * radius_ >=
+                  invTimeHorizonObst * radius >=
               -RVO_EPSILON &&
           det(invTimeHorizonObst * relativePosition2 - orcaLines_[j].point,
               orcaLines_[j].direction) -
-                  invTimeHorizonObst * radius_ >=
+                  invTimeHorizonObst * radius >=
               -RVO_EPSILON) {
         alreadyCovered = true;
         break;
@@ -299,6 +487,9 @@ void Agent::computeNewVelocity(float timeStep) {
     }
 
     if (alreadyCovered) {
+#ifdef RVO_ENABLE_PROFILING
+      ++obstacleLinesSkipped_;
+#endif /* RVO_ENABLE_PROFILING */
       continue;
     }
 
@@ -306,7 +497,7 @@ void Agent::computeNewVelocity(float timeStep) {
     const float distSq1 = absSq(relativePosition1);
     const float distSq2 = absSq(relativePosition2);
 
-    const float radiusSq = radius_ * radius_;
+    const float radiusSq = radius * radius;
 
     const Vector2 obstacleVector = obstacle2->point_ - obstacle1->point_;
     const float s =
@@ -367,13 +558,13 @@ void Agent::computeNewVelocity(float timeStep) {
       const float leg1 = std::sqrt(distSq1 - radiusSq);
       leftLegDirection =
           Vector2(
-              relativePosition1.x() * leg1 - relativePosition1.y() * radius_,
-              relativePosition1.x() * radius_ + relativePosition1.y() * leg1) /
+              relativePosition1.x() * leg1 - relativePosition1.y() * radius,
+              relativePosition1.x() * radius + relativePosition1.y() * leg1) /
           distSq1;
       rightLegDirection =
           Vector2(
-              relativePosition1.x() * leg1 + relativePosition1.y() * radius_,
-              -relativePosition1.x() * radius_ + relativePosition1.y() * leg1) /
+              relativePosition1.x() * leg1 + relativePosition1.y() * radius,
+              -relativePosition1.x() * radius + relativePosition1.y() * leg1) /
           distSq1;
     } else if (s > 1.0F && distSqLine <= radiusSq) {
       /* Obstacle viewed obliquely so that right vertex defines velocity
@@ -388,21 +579,21 @@ void Agent::computeNewVelocity(float timeStep) {
       const float leg2 = std::sqrt(distSq2 - radiusSq);
       leftLegDirection =
           Vector2(
-              relativePosition2.x() * leg2 - relativePosition2.y() * radius_,
-              relativePosition2.x() * radius_ + relativePosition2.y() * leg2) /
+              relativePosition2.x() * leg2 - relativePosition2.y() * radius,
+              relativePosition2.x() * radius + relativePosition2.y() * leg2) /
           distSq2;
       rightLegDirection =
           Vector2(
-              relativePosition2.x() * leg2 + relativePosition2.y() * radius_,
-              -relativePosition2.x() * radius_ + relativePosition2.y() * leg2) /
+              relativePosition2.x() * leg2 + relativePosition2.y() * radius,
+              -relativePosition2.x() * radius + relativePosition2.y() * leg2) /
           distSq2;
     } else {
       /* Usual situation. */
       if (obstacle1->isConvex_) {
         const float leg1 = std::sqrt(distSq1 - radiusSq);
         leftLegDirection = Vector2(relativePosition1.x() * leg1 -
-                                       relativePosition1.y() * radius_,
-                                   relativePosition1.x() * radius_ +
+                                       relativePosition1.y() * radius,
+                                   relativePosition1.x() * radius +
                                        relativePosition1.y() * leg1) /
                            distSq1;
       } else {
@@ -413,8 +604,8 @@ void Agent::computeNewVelocity(float timeStep) {
       if (obstacle2->isConvex_) {
         const float leg2 = std::sqrt(distSq2 - radiusSq);
         rightLegDirection = Vector2(relativePosition2.x() * leg2 +
-                                        relativePosition2.y() * radius_,
-                                    -relativePosition2.x() * radius_ +
+                                        relativePosition2.y() * radius,
+                                    -relativePosition2.x() * radius +
                                         relativePosition2.y() * leg2) /
                             distSq2;
       } else {
@@ -426,7 +617,7 @@ void Agent::computeNewVelocity(float timeStep) {
     /* Legs can never point into neighboring edge when convex vertex, take
      * cutoff-line of neighboring edge instead. If velocity projected on
      * "foreign" leg, no constraint is added. */
-    const Obstacle *const leftNeighbor = obstacle1->previous_;
+    const Obstacle *const leftNeighbor = &obstacles[obstacle1->previous_];
 
     bool isLeftLegForeign = false;
     bool isRightLegForeign = false;
@@ -447,9 +638,9 @@ void Agent::computeNewVelocity(float timeStep) {
 
     /* Compute cut-off centers. */
     const Vector2 leftCutoff =
-        invTimeHorizonObst * (obstacle1->point_ - position_);
+        invTimeHorizonObst * (obstacle1->point_ - position);
     const Vector2 rightCutoff =
-        invTimeHorizonObst * (obstacle2->point_ - position_);
+        invTimeHorizonObst * (obstacle2->point_ - position);
     const Vector2 cutoffVector = rightCutoff - leftCutoff;
 
     /* Project current velocity on velocity obstacle. */
@@ -458,27 +649,27 @@ void Agent::computeNewVelocity(float timeStep) {
     const float t =
         obstacle1 == obstacle2
             ? 0.5F
-            : (velocity_ - leftCutoff) * cutoffVector / absSq(cutoffVector);
-    const float tLeft = (velocity_ - leftCutoff) * leftLegDirection;
-    const float tRight = (velocity_ - rightCutoff) * rightLegDirection;
+            : (velocity - leftCutoff) * cutoffVector / absSq(cutoffVector);
+    const float tLeft = (velocity - leftCutoff) * leftLegDirection;
+    const float tRight = (velocity - rightCutoff) * rightLegDirection;
 
     if ((t < 0.0F && tLeft < 0.0F) ||
         (obstacle1 == obstacle2 && tLeft < 0.0F && tRight < 0.0F)) {
       /* Project on left cut-off circle. */
-      const Vector2 unitW = normalize(velocity_ - leftCutoff);
+      const Vector2 unitW = normalize(velocity - leftCutoff);
 
       line.direction = Vector2(unitW.y(), -unitW.x());
-      line.point = leftCutoff + radius_ * invTimeHorizonObst * unitW;
+      line.point = leftCutoff + radius * invTimeHorizonObst * unitW;
       orcaLines_.push_back(line);
       continue;
     }
 
     if (t > 1.0F && tRight < 0.0F) {
       /* Project on right cut-off circle. */
-      const Vector2 unitW = normalize(velocity_ - rightCutoff);
+      const Vector2 unitW = normalize(velocity - rightCutoff);
 
       line.direction = Vector2(unitW.y(), -unitW.x());
-      line.point = rightCutoff + radius_ * invTimeHorizonObst * unitW;
+      line.point = rightCutoff + radius * invTimeHorizonObst * unitW;
       orcaLines_.push_back(line);
       continue;
     }
@@ -488,21 +679,21 @@ void Agent::computeNewVelocity(float timeStep) {
     const float distSqCutoff =
         (t < 0.0F || t > 1.0F || obstacle1 == obstacle2)
             ? std::numeric_limits<float>::infinity()
-            : absSq(velocity_ - (leftCutoff + t * cutoffVector));
+            : absSq(velocity - (leftCutoff + t * cutoffVector));
     const float distSqLeft =
         tLeft < 0.0F
             ? std::numeric_limits<float>::infinity()
-            : absSq(velocity_ - (leftCutoff + tLeft * leftLegDirection));
+            : absSq(velocity - (leftCutoff + tLeft * leftLegDirection));
     const float distSqRight =
         tRight < 0.0F
             ? std::numeric_limits<float>::infinity()
-            : absSq(velocity_ - (rightCutoff + tRight * rightLegDirection));
+            : absSq(velocity - (rightCutoff + tRight * rightLegDirection));
 
     if (distSqCutoff <= distSqLeft && distSqCutoff <= distSqRight) {
       /* Project on cut-off line. */
       line.direction = -obstacle1->direction_;
       line.point =
-          leftCutoff + radius_ * invTimeHorizonObst *
+          leftCutoff + radius * invTimeHorizonObst *
                            Vector2(-line.direction.y(), line.direction.x());
       orcaLines_.push_back(line);
       continue;
@@ -516,7 +707,7 @@ void Agent::computeNewVelocity(float timeStep) {
 
       line.direction = leftLegDirection;
       line.point =
-          leftCutoff + radius_ * invTimeHorizonObst *
+          leftCutoff + radius * invTimeHorizonObst *
                            Vector2(-line.direction.y(), line.direction.x());
       orcaLines_.push_back(line);
       continue;
@@ -529,137 +720,178 @@ void Agent::computeNewVelocity(float timeStep) {
 
     line.direction = -rightLegDirection;
     line.point =
-        rightCutoff + radius_ * invTimeHorizonObst *
+        rightCutoff + radius * invTimeHorizonObst *
                           Vector2(-line.direction.y(), line.direction.x());
     orcaLines_.push_back(line);
   }
 
   const std::size_t numObstLines = orcaLines_.size();
 
-  const float invTimeHorizon = 1.0F / timeHorizon_;
+  const float invTimeHorizon = profile.invTimeHorizon;
 
   /* Create agent ORCA lines. */
-  for (std::size_t i = 0U; i < agentNeighbors_.size(); ++i) {
-    const Agent *const other = agentNeighbors_[i].second;
+  orcaLines_.resize(numObstLines + agentNeighbors_.size());
 
-    const Vector2 relativePosition = other->position_ - position_;
-    const Vector2 relativeVelocity = velocity_ - other->velocity_;
-    const float distSq = absSq(relativePosition);
-    const float combinedRadius = radius_ + other->radius_;
-    const float combinedRadiusSq = combinedRadius * combinedRadius;
-
-    Line line;
-    Vector2 u;
-
-    if (distSq > combinedRadiusSq) {
-      /* No collision. */
-      const Vector2 w = relativeVelocity - invTimeHorizon * relativePosition;
-      /* Vector from cutoff center to relative velocity. */
-      const float wLengthSq = absSq(w);
+  if (!agentNeighbors_.empty()) {
+    computeAgentORCALines(invTimeHorizon, invTimeStep,
+                          &orcaLines_[numObstLines]);
+  }
 
-      const float dotProduct = w * relativePosition;
+  Line *const lines = orcaLines_.empty() ? NULL : &orcaLines_[0];
+  const float maxSpeed = simulator_->agentMaxSpeeds_[id_];
+  const std::size_t lineFail = linearProgram2(
+      lines, orcaLines_.size(), maxSpeed,
+      simulator_->agentPrefVelocities_[id_], false, newVelocity_);
 
-      if (dotProduct < 0.0F &&
-          dotProduct * dotProduct > combinedRadiusSq * wLengthSq) {
-        /* Project on cut-off circle. */
-        const float wLength = std::sqrt(wLengthSq);
-        const Vector2 unitW = w / wLength;
+  if (lineFail < orcaLines_.size()) {
+#ifdef RVO_ENABLE_PROFILING
+    ++linearProgram3Calls_;
+#endif /* RVO_ENABLE_PROFILING */
+    /* Only allocates the first time, or when the number of lines is raised. */
+    if (projLines.size() < orcaLines_.size()) {
+      projLines.resize(orcaLines_.size());
+    }
 
-        line.direction = Vector2(unitW.y(), -unitW.x());
-        u = (combinedRadius * invTimeHorizon - wLength) * unitW;
-      } else {
-        /* Project on legs. */
-        const float leg = std::sqrt(distSq - combinedRadiusSq);
-
-        if (det(relativePosition, w) > 0.0F) {
-          /* Project on left leg. */
-          line.direction = Vector2(relativePosition.x() * leg -
-                                       relativePosition.y() * combinedRadius,
-                                   relativePosition.x() * combinedRadius +
-                                       relativePosition.y() * leg) /
-                           distSq;
-        } else {
-          /* Project on right leg. */
-          line.direction = -Vector2(relativePosition.x() * leg +
-                                        relativePosition.y() * combinedRadius,
-                                    -relativePosition.x() * combinedRadius +
-                                        relativePosition.y() * leg) /
-                           distSq;
-        }
+    linearProgram3(lines, orcaLines_.size(), numObstLines, lineFail, maxSpeed,
+                   newVelocity_, &projLines[0]);
+  }
+}
 
-        u = (relativeVelocity * line.direction) * line.direction -
-            relativeVelocity;
-      }
-    } else {
-      /* Collision. Project on cut-off circle of time timeStep. */
-      const float invTimeStep = 1.0F / timeStep;
+template <std::size_t MaxNeighbors>
+void Agent::computeNewVelocityWithoutObstacles(float invTimeStep) {
+  const std::size_t numLines = agentNeighbors_.size();
 
-      /* Vector from cutoff center to relative velocity. */
-      const Vector2 w = relativeVelocity - invTimeStep * relativePosition;
+#ifdef RVO_ENABLE_PROFILING
+  linearProgram3Calls_ = 0U;
+  obstacleLinesSkipped_ = 0U;
+#endif /* RVO_ENABLE_PROFILING */
 
-      const float wLength = abs(w);
-      const Vector2 unitW = w / wLength;
+  /* Computed in place for the queries of the ORCA lines of the agent. */
+  orcaLines_.resize(numLines);
+  Line *const lines = numLines > 0U ? &orcaLines_[0] : NULL;
 
-      line.direction = Vector2(unitW.y(), -unitW.x());
-      u = (combinedRadius * invTimeStep - wLength) * unitW;
-    }
+  if (numLines > 0U) {
+    computeAgentORCALines(
+        simulator_->agentProfiles_[profileNo_].invTimeHorizon, invTimeStep,
+        lines);
+  }
 
-    line.point = velocity_ + 0.5F * u;
-    orcaLines_.push_back(line);
+  const float maxSpeed = simulator_->agentMaxSpeeds_[id_];
+  const std::size_t lineFail = linearProgram2(
+      lines, numLines, maxSpeed, simulator_->agentPrefVelocities_[id_], false,
+      newVelocity_);
+
+  if (lineFail < numLines) {
+#ifdef RVO_ENABLE_PROFILING
+    ++linearProgram3Calls_;
+#endif /* RVO_ENABLE_PROFILING */
+    Line projLines[MaxNeighbors];
+    linearProgram3(lines, numLines, 0U, lineFail, maxSpeed, newVelocity_,
+                   projLines);
   }
+}
 
-  const std::size_t lineFail =
-      linearProgram2(orcaLines_, maxSpeed_, prefVelocity_, false, newVelocity_);
+void Agent::insertAgentNeighbor(std::size_t agentNo, float &rangeSq) {
+  const float distSq = absSq(simulator_->agentPositions_[id_] -
+                             simulator_->agentPositions_[agentNo]);
 
-  if (lineFail < orcaLines_.size()) {
-    linearProgram3(orcaLines_, numObstLines, lineFail, maxSpeed_, newVelocity_);
+  if (distSq < rangeSq) {
+    insertAgentNeighbor(agentNo, distSq, rangeSq);
   }
 }
 
-void Agent::insertAgentNeighbor(const Agent *agent, float &rangeSq) {
-  if (this != agent) {
-    const float distSq = absSq(position_ - agent->position_);
+void Agent::insertAgentNeighbor(std::size_t agentNo, float distSq,
+                                float &rangeSq) {
+  if (id_ != agentNo) {
+#ifdef RVO_ENABLE_PROFILING
+    ++agentNeighborsInserted_;
+#endif /* RVO_ENABLE_PROFILING */
+
+    if (collectingAgentCandidates_) {
+      agentCandidates_.push_back(agentNo);
+
+      return;
+    }
 
-    if (distSq < rangeSq) {
+    const std::pair<float, std::size_t> neighbor(distSq, agentNo);
+    const bool deterministic = simulator_->deterministic_;
+
+    if (deterministic && agentNeighbors_.size() == maxNeighbors_ &&
+        !(neighbor < (simulator_->agentNeighborHeap_
+                          ? agentNeighbors_.front()
+                          : agentNeighbors_.back()))) {
+      /* Ties with the farthest agent neighbor, which has a lower number. */
+      return;
+    }
+
+    if (simulator_->agentNeighborHeap_) {
+      /* Unordered until full, then a max-heap of the nearest agent neighbors
+       * found so far. Sorted once all are found. */
       if (agentNeighbors_.size() < maxNeighbors_) {
-        agentNeighbors_.push_back(std::make_pair(distSq, agent));
-      }
+        agentNeighbors_.push_back(neighbor);
 
-      std::size_t i = agentNeighbors_.size() - 1U;
+        if (agentNeighbors_.size() < maxNeighbors_) {
+          return;
+        }
 
-      while (i != 0U && distSq < agentNeighbors_[i - 1U].first) {
-        agentNeighbors_[i] = agentNeighbors_[i - 1U];
-        --i;
+        std::make_heap(agentNeighbors_.begin(), agentNeighbors_.end());
+      } else {
+        replaceHeapTop(agentNeighbors_, neighbor);
       }
 
-      agentNeighbors_[i] = std::make_pair(distSq, agent);
+      rangeSq = deterministic ? tieRangeSq(agentNeighbors_.front().first)
+                              : agentNeighbors_.front().first;
 
-      if (agentNeighbors_.size() == maxNeighbors_) {
-        rangeSq = agentNeighbors_.back().first;
-      }
+      return;
+    }
+
+    if (agentNeighbors_.size() < maxNeighbors_) {
+      agentNeighbors_.push_back(neighbor);
+    }
+
+    std::size_t i = agentNeighbors_.size() - 1U;
+
+    while (i != 0U &&
+           (deterministic ? neighbor < agentNeighbors_[i - 1U]
+                          : distSq < agentNeighbors_[i - 1U].first)) {
+      agentNeighbors_[i] = agentNeighbors_[i - 1U];
+      --i;
+    }
+
+    agentNeighbors_[i] = neighbor;
+
+    if (agentNeighbors_.size() == maxNeighbors_) {
+      /* In deterministic mode, agent neighbors that tie with the farthest are
+       * still searched for so that the lowest numbers are kept. */
+      rangeSq = deterministic ? tieRangeSq(agentNeighbors_.back().first)
+                              : agentNeighbors_.back().first;
     }
   }
 }
 
-void Agent::insertObstacleNeighbor(const Obstacle *obstacle, float rangeSq) {
-  const Obstacle *const nextObstacle = obstacle->next_;
+void Agent::insertObstacleNeighbor(std::size_t obstacleNo, float rangeSq) {
+  const std::vector<Obstacle> &obstacles =
+      simulator_->obstacleWorld_->obstacles_;
+  const Obstacle *const obstacle = &obstacles[obstacleNo];
+  const Obstacle *const nextObstacle = &obstacles[obstacle->next_];
+  const Vector2 &position = simulator_->agentPositions_[id_];
 
   float distSq = 0.0F;
-  const float r = ((position_ - obstacle->point_) *
+  const float r = ((position - obstacle->point_) *
                    (nextObstacle->point_ - obstacle->point_)) /
                   absSq(nextObstacle->point_ - obstacle->point_);
 
   if (r < 0.0F) {
-    distSq = absSq(position_ - obstacle->point_);
+    distSq = absSq(position - obstacle->point_);
   } else if (r > 1.0F) {
-    distSq = absSq(position_ - nextObstacle->point_);
+    distSq = absSq(position - nextObstacle->point_);
   } else {
-    distSq = absSq(position_ - (obstacle->point_ +
+    distSq = absSq(position - (obstacle->point_ +
                                 r * (nextObstacle->point_ - obstacle->point_)));
   }
 
   if (distSq < rangeSq) {
-    obstacleNeighbors_.push_back(std::make_pair(distSq, obstacle));
+    obstacleNeighbors_.push_back(std::make_pair(distSq, obstacleNo));
 
     std::size_t i = obstacleNeighbors_.size() - 1U;
 
@@ -668,12 +900,12 @@ void Agent::insertObstacleNeighbor(const Obstacle *obstacle, float rangeSq) {
       --i;
     }
 
-    obstacleNeighbors_[i] = std::make_pair(distSq, obstacle);
+    obstacleNeighbors_[i] = std::make_pair(distSq, obstacleNo);
   }
 }
 
 void Agent::update(float timeStep) {
-  velocity_ = newVelocity_;
-  position_ += velocity_ * timeStep;
+  simulator_->agentVelocities_[id_] = newVelocity_;
+  simulator_->agentPositions_[id_] += newVelocity_ * timeStep;
 }
 } /* namespace RVO */
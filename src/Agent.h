@@ -47,8 +47,24 @@
 #include "Vector2.h"
 
 namespace RVO {
+class AgentGrid;
 class KdTree;
-class Obstacle;
+class RVOSimulator;
+class RegionSimulator;
+
+/**
+ * @brief The capacity of the fixed-size line storage used to compute the new
+ *        velocity of an agent without obstacle neighbors and with no more
+ *        agent neighbors.
+ */
+const std::size_t RVO_SMALL_AGENT_LINE_CAPACITY = 16U;
+
+/**
+ * @brief The capacity of the fixed-size line storage used to compute the new
+ *        velocity of an agent without obstacle neighbors and with more agent
+ *        neighbors than RVO_SMALL_AGENT_LINE_CAPACITY but no more than this.
+ */
+const std::size_t RVO_LARGE_AGENT_LINE_CAPACITY = 64U;
 
 /**
  * @brief Defines an agent in the simulation.
@@ -56,44 +72,110 @@ class Obstacle;
 class Agent {
  private:
   /**
-   * @brief Constructs an agent instance.
+   * @brief     Constructs an agent instance.
+   * @param[in] simulator The simulator instance that stores the position,
+   *                      velocity, preferred velocity, radius, and maximum
+   *                      speed of this agent.
    */
-  Agent();
+  explicit Agent(RVOSimulator *simulator);
 
   /**
    * @brief Destroys this agent instance.
    */
   ~Agent();
 
+  /**
+   * @brief      Computes the agent ORCA lines of this agent, one for each of
+   *             its agent neighbors.
+   * @param[in]  invTimeHorizon The inverse of the time horizon of this agent.
+   * @param[in]  invTimeStep    The inverse of the time step of the simulation.
+   * @param[out] lines          An array of at least as many elements as there
+   *                            are agent neighbors to which the lines are
+   *                            written.
+   */
+  void computeAgentORCALines(float invTimeHorizon, float invTimeStep,
+                             Line *lines) const;
+
+  /**
+   * @brief     Computes the candidate agent neighbors of this agent, the agents
+   *            within its neighbor distance plus the agent neighbor skin of
+   *            the simulation, from which its agent neighbors are selected
+   *            while sub-stepping.
+   * @param[in] kdTree       A pointer to the k-D trees for agents and static
+   *                         obstacles in the simulation.
+   * @param[in] agentGrid    A pointer to the agent grid in the simulation to
+   *                         query instead of the agent k-D tree, or NULL.
+   * @param[in] neighborDist The neighbor distance of this agent.
+   */
+  void computeAgentCandidates(const KdTree *kdTree, const AgentGrid *agentGrid,
+                              float neighborDist);
+
   /**
    * @brief     Computes the neighbors of this agent.
-   * @param[in] kdTree A pointer to the k-D trees for agents and static
-   *                   obstacles in the simulation.
+   * @param[in] kdTree    A pointer to the k-D trees for agents and static
+   *                      obstacles in the simulation.
+   * @param[in] agentGrid A pointer to the agent grid in the simulation to
+   *                      query for agent neighbors instead of the agent k-D
+   *                      tree, or NULL.
+   * @note      While the simulation is sub-stepping, selects the agent
+   *            neighbors from the candidate agent neighbors instead, computing
+   *            those first if they are stale.
    */
-  void computeNeighbors(const KdTree *kdTree);
+  void computeNeighbors(const KdTree *kdTree, const AgentGrid *agentGrid);
 
   /**
-   * @brief     Computes the new velocity of this agent.
-   * @param[in] timeStep The time step of the simulation.
+   * @brief          Computes the new velocity of this agent, with the
+   *                 fixed-capacity kernel selected by the simulator if any.
+   * @param[in]      invTimeStep The inverse of the time step of the
+   *                             simulation.
+   * @param[in, out] projLines   Scratch storage for the linear program, owned
+   *                             by the calling thread and reused across
+   *                             agents.
+   */
+  void computeNewVelocity(
+      float invTimeStep,
+      std::vector<Line> &projLines); /* NOLINT(runtime/references) */
+
+  /**
+   * @brief     Computes the new velocity of this agent, which has no obstacle
+   *            neighbors, with its projected lines stored in a fixed-size
+   *            array.
+   * @tparam    MaxNeighbors The capacity of the array. Must be at least the
+   *                         number of agent neighbors of this agent.
+   * @param[in] invTimeStep  The inverse of the time step of the simulation.
    */
-  void computeNewVelocity(float timeStep);
+  template <std::size_t MaxNeighbors>
+  void computeNewVelocityWithoutObstacles(float invTimeStep);
 
   /**
    * @brief          Inserts an agent neighbor into the set of neighbors of this
    *                 agent.
-   * @param[in]      agent   A pointer to the agent to be inserted.
+   * @param[in]      agentNo The number of the agent to be inserted.
    * @param[in, out] rangeSq The squared range around this agent.
    */
-  void insertAgentNeighbor(const Agent *agent,
+  void insertAgentNeighbor(std::size_t agentNo,
+                           float &rangeSq); /* NOLINT(runtime/references) */
+
+  /**
+   * @brief          Inserts an agent neighbor whose squared distance to this
+   *                 agent is already known into the set of neighbors of this
+   *                 agent.
+   * @param[in]      agentNo The number of the agent to be inserted.
+   * @param[in]      distSq  The squared distance between this agent and the
+   *                         agent to be inserted. Must be less than rangeSq.
+   * @param[in, out] rangeSq The squared range around this agent.
+   */
+  void insertAgentNeighbor(std::size_t agentNo, float distSq,
                            float &rangeSq); /* NOLINT(runtime/references) */
 
   /**
    * @brief          Inserts a static obstacle neighbor into the set of
    *                 neighbors of this agent.
-   * @param[in]      obstacle The number of the static obstacle to be inserted.
-   * @param[in, out] rangeSq  The squared range around this agent.
+   * @param[in]      obstacleNo The number of the static obstacle to be
+   *                            inserted.
+   * @param[in, out] rangeSq    The squared range around this agent.
    */
-  void insertObstacleNeighbor(const Obstacle *obstacle, float rangeSq);
+  void insertObstacleNeighbor(std::size_t obstacleNo, float rangeSq);
 
   /**
    * @brief     Updates the two-dimensional position and two-dimensional
@@ -108,23 +190,36 @@ class Agent {
   /* Not implemented. */
   Agent &operator=(const Agent &other);
 
-  std::vector<std::pair<float, const Agent *> > agentNeighbors_;
-  std::vector<std::pair<float, const Obstacle *> > obstacleNeighbors_;
+  std::vector<std::size_t> agentCandidates_;
+  std::vector<std::pair<float, std::size_t> > agentNeighbors_;
+  std::vector<std::pair<float, std::size_t> > obstacleNeighbors_;
   std::vector<Line> orcaLines_;
   Vector2 newVelocity_;
-  Vector2 position_;
-  Vector2 prefVelocity_;
-  Vector2 velocity_;
+  RVOSimulator *simulator_;
   std::size_t id_;
+  /* Copied from the agent profile by computeNeighbors() for the neighbor
+   * search. */
   std::size_t maxNeighbors_;
-  float maxSpeed_;
-  float neighborDist_;
-  float radius_;
-  float timeHorizon_;
-  float timeHorizonObst_;
-
+  std::size_t profileNo_;
+  bool collectingAgentCandidates_;
+  bool ghost_;
+  bool sleeping_;
+  bool stationary_;
+
+#ifdef RVO_ENABLE_PROFILING
+  /* Counts for the step profile of the simulator, reset by each agent so that
+   * they are not shared between threads. */
+  std::size_t agentNeighborsInserted_;
+  std::size_t agentTreeNodesVisited_;
+  std::size_t linearProgram3Calls_;
+  std::size_t obstacleLinesSkipped_;
+  std::size_t obstacleTreeNodesVisited_;
+#endif /* RVO_ENABLE_PROFILING */
+
+  friend class AgentGrid;
   friend class KdTree;
   friend class RVOSimulator;
+  friend class RegionSimulator;
 };
 } /* namespace RVO */
 
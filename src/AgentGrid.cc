@@ -0,0 +1,186 @@
+/*
+ * AgentGrid.cc
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+/**
+ * @file  AgentGrid.cc
+ * @brief Defines the AgentGrid class.
+ */
+
+#include "AgentGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Agent.h"
+#include "AgentProfile.h"
+#include "RVOSimulator.h"
+
+namespace RVO {
+namespace {
+/**
+ * @relates   AgentGrid
+ * @brief     Computes the hash bucket of a grid cell.
+ * @param[in] cellX The column of the cell.
+ * @param[in] cellY The row of the cell.
+ * @param[in] mask  The number of hash buckets minus one. The number of hash
+ *                  buckets must be a power of two.
+ * @return    The hash bucket of the cell.
+ */
+std::size_t hashCell(int cellX, int cellY, std::size_t mask) {
+  return ((static_cast<std::size_t>(cellX) * 73856093U) ^
+          (static_cast<std::size_t>(cellY) * 19349663U)) &
+         mask;
+}
+
+/**
+ * @relates AgentGrid
+ * @brief   The offsets of the three by three block of cells around a cell,
+ *          ordered by their distance to it, so that the range of a query
+ *          shrinks as early as possible.
+ */
+const int RVO_CELL_OFFSETS[9][2] = {{0, 0},  {-1, 0}, {1, 0},
+                                    {0, -1}, {0, 1},  {-1, -1},
+                                    {1, -1}, {-1, 1}, {1, 1}};
+} /* namespace */
+
+AgentGrid::AgentGrid(RVOSimulator *simulator)
+    : simulator_(simulator), cellMask_(0U), invCellSize_(1.0F) {}
+
+AgentGrid::~AgentGrid() {}
+
+void AgentGrid::buildAgentGrid() {
+  const std::vector<Vector2> &positions = simulator_->agentPositions_;
+  const std::size_t numAgents = positions.size();
+  float cellSize = 0.0F;
+
+  for (std::size_t i = 0U; i < numAgents; ++i) {
+    cellSize = std::max(
+        cellSize,
+        simulator_->agentProfiles_[simulator_->agents_[i]->profileNo_]
+            .neighborDist);
+  }
+
+  /* Candidate agent neighbors are searched for past the neighbor distance
+   * while sub-stepping. */
+  if (simulator_->subStepping_) {
+    cellSize += simulator_->agentNeighborSkin_;
+  }
+
+  /* Any cell size works when no agent has a neighbor distance. */
+  invCellSize_ = cellSize > 0.0F ? 1.0F / cellSize : 1.0F;
+
+  std::size_t numCells = 1U;
+
+  while (numCells < 2U * numAgents) {
+    numCells <<= 1U;
+  }
+
+  cellMask_ = numCells - 1U;
+  cellBegins_.assign(numCells + 1U, 0U);
+  agentCells_.resize(numAgents);
+  agents_.resize(numAgents);
+  positions_.resize(numAgents);
+
+  for (std::size_t i = 0U; i < numAgents; ++i) {
+    agentCells_[i] =
+        hashCell(static_cast<int>(std::floor(positions[i].x() * invCellSize_)),
+                 static_cast<int>(std::floor(positions[i].y() * invCellSize_)),
+                 cellMask_);
+    ++cellBegins_[agentCells_[i]];
+  }
+
+  for (std::size_t i = 1U; i <= numCells; ++i) {
+    cellBegins_[i] += cellBegins_[i - 1U];
+  }
+
+  /* cellBegins_ holds the end of each cell. Scattering the agents in reverse
+   * order moves it to the beginning and keeps each cell sorted by agent
+   * number. */
+  for (std::size_t i = numAgents; i-- > 0U;) {
+    const std::size_t index = --cellBegins_[agentCells_[i]];
+    agents_[index] = i;
+    positions_[index] = positions[i];
+  }
+}
+
+void AgentGrid::computeAgentNeighbors(Agent *agent, float &rangeSq) const {
+  if (agents_.empty()) {
+    return;
+  }
+
+  const Vector2 &position = simulator_->agentPositions_[agent->id_];
+  const int cellX = static_cast<int>(std::floor(position.x() * invCellSize_));
+  const int cellY = static_cast<int>(std::floor(position.y() * invCellSize_));
+
+  /* Distances from the agent to the near edges of the neighboring cells. */
+  const float cellSize = 1.0F / invCellSize_;
+  const float distLeft = position.x() - static_cast<float>(cellX) * cellSize;
+  const float distBottom = position.y() - static_cast<float>(cellY) * cellSize;
+  const float distX[3] = {distLeft, 0.0F, cellSize - distLeft};
+  const float distY[3] = {distBottom, 0.0F, cellSize - distBottom};
+
+  std::size_t visitedCells[9];
+  std::size_t numVisitedCells = 0U;
+
+  for (std::size_t j = 0U; j < 9U; ++j) {
+    const int offsetX = RVO_CELL_OFFSETS[j][0];
+    const int offsetY = RVO_CELL_OFFSETS[j][1];
+
+    const float cellDistX = distX[offsetX + 1];
+    const float cellDistY = distY[offsetY + 1];
+
+    if (cellDistX * cellDistX + cellDistY * cellDistY >= rangeSq) {
+      continue;
+    }
+
+    const std::size_t cell =
+        hashCell(cellX + offsetX, cellY + offsetY, cellMask_);
+
+    /* Distinct cells may share a hash bucket, which must be scanned once. */
+    if (std::find(visitedCells, visitedCells + numVisitedCells, cell) !=
+        visitedCells + numVisitedCells) {
+      continue;
+    }
+
+    visitedCells[numVisitedCells++] = cell;
+
+    for (std::size_t i = cellBegins_[cell]; i < cellBegins_[cell + 1U]; ++i) {
+      const float distSq = absSq(position - positions_[i]);
+
+      if (distSq < rangeSq) {
+        agent->insertAgentNeighbor(agents_[i], distSq, rangeSq);
+      }
+    }
+  }
+}
+} /* namespace RVO */
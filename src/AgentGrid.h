@@ -0,0 +1,104 @@
+/*
+ * AgentGrid.h
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+#ifndef RVO_AGENT_GRID_H_
+#define RVO_AGENT_GRID_H_
+
+/**
+ * @file  AgentGrid.h
+ * @brief Declares the AgentGrid class.
+ */
+
+#include <cstddef>
+#include <vector>
+
+#include "Vector2.h"
+
+namespace RVO {
+class Agent;
+class RVOSimulator;
+
+/**
+ * @brief Defines a uniform grid of agents in the simulation. The agents are
+ *        bucketed by a spatial hash of their cell, and the cells are at least
+ *        as large as the largest neighbor distance, so that the neighbors of
+ *        an agent lie in the three by three block of cells around it.
+ */
+class AgentGrid {
+ private:
+  /**
+   * @brief     Constructs an agent grid instance.
+   * @param[in] simulator The simulator instance.
+   */
+  explicit AgentGrid(RVOSimulator *simulator);
+
+  /**
+   * @brief Destroys this agent grid instance.
+   */
+  ~AgentGrid();
+
+  /**
+   * @brief Builds an agent grid by a counting sort of the agents by cell.
+   */
+  void buildAgentGrid();
+
+  /**
+   * @brief          Computes the agent neighbors of the specified agent.
+   * @param[in]      agent   A pointer to the agent for which agent neighbors
+   *                         are to be computed.
+   * @param[in, out] rangeSq The squared range around the agent. Must not
+   *                         exceed the squared cell size.
+   */
+  void computeAgentNeighbors(
+      Agent *agent, float &rangeSq) const; /* NOLINT(runtime/references) */
+
+  /* Not implemented. */
+  AgentGrid(const AgentGrid &other);
+
+  /* Not implemented. */
+  AgentGrid &operator=(const AgentGrid &other);
+
+  std::vector<std::size_t> agents_;
+  std::vector<std::size_t> agentCells_;
+  std::vector<std::size_t> cellBegins_;
+  std::vector<Vector2> positions_;
+  RVOSimulator *simulator_;
+  std::size_t cellMask_;
+  float invCellSize_;
+
+  friend class Agent;
+  friend class RVOSimulator;
+};
+} /* namespace RVO */
+
+#endif /* RVO_AGENT_GRID_H_ */
@@ -0,0 +1,83 @@
+/*
+ * AgentProfile.cc
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+/**
+ * @file  AgentProfile.cc
+ * @brief Defines the AgentProfile class.
+ */
+
+#include "AgentProfile.h"
+
+namespace RVO {
+AgentProfile::AgentProfile()
+    : maxNeighbors(0U),
+      numReferences(0U),
+      invTimeHorizon(0.0F),
+      invTimeHorizonObst(0.0F),
+      maxSpeed(0.0F),
+      neighborDist(0.0F),
+      neighborDistSq(0.0F),
+      obstacleRangeSq(0.0F),
+      radius(0.0F),
+      timeHorizon(0.0F),
+      timeHorizonObst(0.0F) {}
+
+AgentProfile::AgentProfile(float neighborDist, std::size_t maxNeighbors,
+                           float timeHorizon, float timeHorizonObst,
+                           float radius, float maxSpeed)
+    : maxNeighbors(maxNeighbors),
+      numReferences(0U),
+      invTimeHorizon(0.0F),
+      invTimeHorizonObst(0.0F),
+      maxSpeed(maxSpeed),
+      neighborDist(neighborDist),
+      neighborDistSq(0.0F),
+      obstacleRangeSq(0.0F),
+      radius(radius),
+      timeHorizon(timeHorizon),
+      timeHorizonObst(timeHorizonObst) {
+  update();
+}
+
+AgentProfile::~AgentProfile() {}
+
+void AgentProfile::update() {
+  /* The same operations as each agent performed each step. */
+  const float obstacleRange = timeHorizonObst * maxSpeed + radius;
+
+  invTimeHorizon = 1.0F / timeHorizon;
+  invTimeHorizonObst = 1.0F / timeHorizonObst;
+  neighborDistSq = neighborDist * neighborDist;
+  obstacleRangeSq = obstacleRange * obstacleRange;
+}
+} /* namespace RVO */
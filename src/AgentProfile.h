@@ -0,0 +1,148 @@
+/*
+ * AgentProfile.h
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+#ifndef RVO_AGENT_PROFILE_H_
+#define RVO_AGENT_PROFILE_H_
+
+/**
+ * @file  AgentProfile.h
+ * @brief Declares the AgentProfile class.
+ */
+
+#include <cstddef>
+
+namespace RVO {
+/**
+ * @brief Defines a set of agent parameters shared by the agents that reference
+ *        it, with the values derived from them each step precomputed. Stored
+ *        by value in a contiguous array of the simulator.
+ */
+class AgentProfile {
+ public:
+  /**
+   * @brief Constructs an agent profile instance without references.
+   */
+  AgentProfile();
+
+  /**
+   * @brief     Constructs an agent profile instance without references.
+   * @param[in] neighborDist    The maximum distance center-point to
+   *                            center-point to other agents an agent takes
+   *                            into account in the navigation.
+   * @param[in] maxNeighbors    The maximum number of other agents an agent
+   *                            takes into account in the navigation.
+   * @param[in] timeHorizon     The minimal amount of time for which the
+   *                            velocities of an agent that are computed by
+   *                            the simulation are safe with respect to other
+   *                            agents.
+   * @param[in] timeHorizonObst The minimal amount of time for which the
+   *                            velocities of an agent that are computed by
+   *                            the simulation are safe with respect to
+   *                            obstacles.
+   * @param[in] radius          The radius of an agent.
+   * @param[in] maxSpeed        The maximum speed of an agent.
+   */
+  AgentProfile(float neighborDist, std::size_t maxNeighbors, float timeHorizon,
+               float timeHorizonObst, float radius, float maxSpeed);
+
+  /**
+   * @brief Destroys this agent profile instance.
+   */
+  ~AgentProfile();
+
+  /**
+   * @brief Recomputes the derived values from the parameters.
+   */
+  void update();
+
+  /**
+   * @brief The maximum number of agent neighbors.
+   */
+  std::size_t maxNeighbors;
+
+  /**
+   * @brief The number of agents, and of other holders, that reference this
+   *        profile. Shared when greater than one.
+   */
+  std::size_t numReferences;
+
+  /**
+   * @brief The inverse of the time horizon. Derived.
+   */
+  float invTimeHorizon;
+
+  /**
+   * @brief The inverse of the time horizon with respect to obstacles.
+   *        Derived.
+   */
+  float invTimeHorizonObst;
+
+  /**
+   * @brief The maximum speed.
+   */
+  float maxSpeed;
+
+  /**
+   * @brief The maximum neighbor distance.
+   */
+  float neighborDist;
+
+  /**
+   * @brief The squared maximum neighbor distance. Derived.
+   */
+  float neighborDistSq;
+
+  /**
+   * @brief The squared range within which obstacles are obstacle neighbors.
+   *        Derived.
+   */
+  float obstacleRangeSq;
+
+  /**
+   * @brief The radius.
+   */
+  float radius;
+
+  /**
+   * @brief The time horizon.
+   */
+  float timeHorizon;
+
+  /**
+   * @brief The time horizon with respect to obstacles.
+   */
+  float timeHorizonObst;
+};
+} /* namespace RVO */
+
+#endif /* RVO_AGENT_PROFILE_H_ */
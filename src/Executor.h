@@ -0,0 +1,106 @@
+/*
+ * Executor.h
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+#ifndef RVO_EXECUTOR_H_
+#define RVO_EXECUTOR_H_
+
+/**
+ * @file  Executor.h
+ * @brief Declares the Executor class.
+ */
+
+#include <cstddef>
+
+#include "Export.h"
+
+namespace RVO {
+/**
+ * @brief Defines an interface to a pool of threads on which the simulator runs
+ *        its parallel loops. May be implemented on top of the job system of
+ *        an application so that the simulator shares its cores.
+ */
+class RVO_EXPORT Executor {
+ public:
+  /**
+   * @brief     Defines a function that processes a contiguous range of the
+   *            items of a parallel loop.
+   * @param[in] begin    The first item of the range.
+   * @param[in] end      One past the last item of the range.
+   * @param[in] threadNo The number of the calling thread, less than
+   *                     getNumThreads() and not shared by any concurrent call
+   *                     in the same loop.
+   * @param[in] userData The user data passed to parallelFor().
+   */
+  typedef void (*Task)(std::size_t begin, std::size_t end,
+                       std::size_t threadNo, void *userData);
+
+  /**
+   * @brief Destroys this executor instance.
+   */
+  virtual ~Executor();
+
+  /**
+   * @brief     Creates a persistent pool of threads that hands out the ranges
+   *            of each parallel loop dynamically, as setNumThreads() of a
+   *            simulation would, to be shared by several simulations.
+   * @param[in] numThreads The number of threads, including the thread that
+   *                       calls parallelFor(). At least one.
+   * @return    A pointer to the executor, to be deleted by the caller once no
+   *            simulation uses it.
+   * @note      Its parallel loops must not be run concurrently.
+   */
+  static Executor *createThreadPool(std::size_t numThreads);
+
+  /**
+   * @brief  Returns the number of threads that may run a parallel loop.
+   * @return The number of threads, at least one.
+   */
+  virtual std::size_t getNumThreads() const = 0;
+
+  /**
+   * @brief     Runs a parallel loop, calling a function on disjoint ranges of
+   *            items until every item has been processed, and returns once all
+   *            calls have returned.
+   * @param[in] numItems  The number of items.
+   * @param[in] chunkSize The suggested number of items in a range. Ranges of
+   *                      this size are best handed out dynamically, since the
+   *                      cost of an item may vary greatly.
+   * @param[in] task      The function to be called on each range.
+   * @param[in] userData  User data passed to the function.
+   */
+  virtual void parallelFor(std::size_t numItems, std::size_t chunkSize,
+                           Task task, void *userData) = 0;
+};
+} /* namespace RVO */
+
+#endif /* RVO_EXECUTOR_H_ */
@@ -39,20 +39,262 @@
 #include "KdTree.h"
 
 #include <algorithm>
+#include <cstring>
+#include <limits>
 #include <utility>
 
 #include "Agent.h"
 #include "Obstacle.h"
 #include "RVOSimulator.h"
+#include "Simd.h"
 #include "Vector2.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif /* _OPENMP */
+
 namespace RVO {
 namespace {
 /**
  * @relates KdTree
- * @brief   The maximum k-D tree node leaf size.
+ * @brief   The maximum k-D tree node leaf size. May be overridden at compile
+ *          time by defining RVO_KD_TREE_MAX_LEAF_SIZE. A multiple of the
+ *          vector width, such as 8 or 16, lets the leaf scan run without a
+ *          scalar remainder.
  */
+#ifdef RVO_KD_TREE_MAX_LEAF_SIZE
+const std::size_t RVO_MAX_LEAF_SIZE = RVO_KD_TREE_MAX_LEAF_SIZE;
+#else
 const std::size_t RVO_MAX_LEAF_SIZE = 10U;
+#endif /* RVO_KD_TREE_MAX_LEAF_SIZE */
+
+/**
+ * @relates KdTree
+ * @brief   The default growth factor of the bounds of an agent k-D tree node
+ *          past which the node is rebuilt when refitting.
+ */
+const float RVO_DEFAULT_REFIT_THRESHOLD = 1.5F;
+
+/**
+ * @relates KdTree
+ * @brief   The maximum number of dynamic obstacles in a leaf node of their
+ *          bounding volume hierarchy.
+ */
+const std::size_t RVO_MAX_DYNAMIC_OBSTACLE_LEAF_SIZE = 4U;
+
+/**
+ * @relates KdTree
+ * @brief   The number of consecutive segments whose visibility queries
+ *          traverse the obstacle k-D tree together.
+ */
+const std::size_t RVO_VISIBILITY_PACKET_SIZE = 64U;
+
+/**
+ * @relates KdTree
+ * @brief   Flags a visibility query that must search the left subtree of an
+ *          obstacle k-D tree node.
+ */
+const unsigned int RVO_VISIBILITY_LEFT = 1U;
+
+/**
+ * @relates KdTree
+ * @brief   Flags a visibility query that must search the right subtree of an
+ *          obstacle k-D tree node.
+ */
+const unsigned int RVO_VISIBILITY_RIGHT = 2U;
+
+/**
+ * @relates KdTree
+ * @brief   Flags a visibility query that is blocked by the obstacle of an
+ *          obstacle k-D tree node.
+ */
+const unsigned int RVO_VISIBILITY_BLOCKED = 4U;
+
+/**
+ * @relates KdTree
+ * @brief   The number of an absent obstacle k-D tree node.
+ */
+const std::size_t RVO_NULL_OBSTACLE_TREE_NODE =
+    std::numeric_limits<std::size_t>::max();
+
+/**
+ * @relates KdTree
+ * @brief   The magic number at the start of saved obstacle data.
+ */
+const char RVO_OBSTACLE_DATA_MAGIC[8] = {'R', 'V', 'O', '2',
+                                         'O', 'B', 'S', 'T'};
+
+/**
+ * @relates KdTree
+ * @brief   The version of the format of saved obstacle data. To be incremented
+ *          whenever the format changes.
+ */
+const std::size_t RVO_OBSTACLE_DATA_VERSION = 1U;
+
+/**
+ * @relates KdTree
+ * @brief   The size in bytes of the header of saved obstacle data: the magic
+ *          number, the 32-bit version, 32 reserved bits, and the 64-bit counts
+ *          of obstacle vertices and of obstacle k-D tree nodes.
+ */
+const std::size_t RVO_OBSTACLE_DATA_HEADER_SIZE = 32U;
+
+/**
+ * @relates KdTree
+ * @brief   The size in bytes of a saved obstacle vertex: its point and
+ *          direction as 32-bit floats, the 64-bit numbers of its next and
+ *          previous vertices, its 32-bit convexity, and 32 reserved bits.
+ */
+const std::size_t RVO_OBSTACLE_DATA_VERTEX_SIZE = 40U;
+
+/**
+ * @relates KdTree
+ * @brief   The size in bytes of a saved obstacle k-D tree node: its endpoints
+ *          as 32-bit floats, followed by the 64-bit numbers of its obstacle and
+ *          of its left and right nodes. A node number of zero, which is the
+ *          root, stands for no node.
+ */
+const std::size_t RVO_OBSTACLE_DATA_NODE_SIZE = 40U;
+
+/**
+ * @relates KdTree
+ * @brief   Classifies a visibility query at an obstacle k-D tree node.
+ * @param[in] point1  The first endpoint of the obstacle of the node.
+ * @param[in] point2  The second endpoint of the obstacle of the node.
+ * @param[in] vector1 The first point between which visibility is to be tested.
+ * @param[in] vector2 The second point between which visibility is to be
+ *                    tested.
+ * @param[in] radius  The radius within which visibility is to be tested.
+ * @return    RVO_VISIBILITY_BLOCKED if the obstacle blocks the query, or else
+ *            the subtrees, RVO_VISIBILITY_LEFT and RVO_VISIBILITY_RIGHT, that
+ *            the query must search.
+ */
+unsigned int classifyVisibility(const Vector2 &point1, const Vector2 &point2,
+                                const Vector2 &vector1, const Vector2 &vector2,
+                                float radius) {
+  const float q1LeftOfI = leftOf(point1, point2, vector1);
+  const float q2LeftOfI = leftOf(point1, point2, vector2);
+  const float invLengthI = 1.0F / absSq(point2 - point1);
+  const bool beyondRadius =
+      q1LeftOfI * q1LeftOfI * invLengthI >= radius * radius &&
+      q2LeftOfI * q2LeftOfI * invLengthI >= radius * radius;
+
+  if (q1LeftOfI >= 0.0F && q2LeftOfI >= 0.0F) {
+    return beyondRadius ? RVO_VISIBILITY_LEFT
+                        : RVO_VISIBILITY_LEFT | RVO_VISIBILITY_RIGHT;
+  }
+
+  if (q1LeftOfI <= 0.0F && q2LeftOfI <= 0.0F) {
+    return beyondRadius ? RVO_VISIBILITY_RIGHT
+                        : RVO_VISIBILITY_LEFT | RVO_VISIBILITY_RIGHT;
+  }
+
+  if (q1LeftOfI >= 0.0F && q2LeftOfI <= 0.0F) {
+    /* One can see through obstacle from left to right. */
+    return RVO_VISIBILITY_LEFT | RVO_VISIBILITY_RIGHT;
+  }
+
+  const float point1LeftOfQ = leftOf(vector1, vector2, point1);
+  const float point2LeftOfQ = leftOf(vector1, vector2, point2);
+  const float invLengthQ = 1.0F / absSq(vector2 - vector1);
+
+  return point1LeftOfQ * point2LeftOfQ >= 0.0F &&
+                 point1LeftOfQ * point1LeftOfQ * invLengthQ > radius * radius &&
+                 point2LeftOfQ * point2LeftOfQ * invLengthQ > radius * radius
+             ? RVO_VISIBILITY_LEFT | RVO_VISIBILITY_RIGHT
+             : RVO_VISIBILITY_BLOCKED;
+}
+
+/**
+ * @relates KdTree
+ * @brief   Reads a little-endian unsigned integer from saved obstacle data.
+ * @param[in]      data     A pointer to the integer.
+ * @param[in]      numBytes The size in bytes of the integer.
+ * @param[in, out] valid    Set to false if the integer does not fit in a
+ *                          std::size_t.
+ * @return         The integer.
+ */
+std::size_t readObstacleData(const unsigned char *data, std::size_t numBytes,
+                             bool &valid) { /* NOLINT(runtime/references) */
+  std::size_t value = 0U;
+
+  for (std::size_t i = numBytes; i-- != 0U;) {
+    if (value > (std::numeric_limits<std::size_t>::max() >> 8U)) {
+      valid = false;
+    }
+
+    value = (value << 8U) | data[i];
+  }
+
+  return value;
+}
+
+/**
+ * @relates KdTree
+ * @brief   Reads a 32-bit float from saved obstacle data.
+ * @param[in] data A pointer to the float.
+ * @return    The float.
+ */
+float readObstacleData(const unsigned char *data) {
+  bool valid = true;
+  const unsigned int bits =
+      static_cast<unsigned int>(readObstacleData(data, 4U, valid));
+  float value = 0.0F;
+  std::memcpy(&value, &bits, sizeof(value));
+
+  return value;
+}
+
+/**
+ * @relates KdTree
+ * @brief   Writes a little-endian unsigned integer to saved obstacle data.
+ * @param[in] data     A pointer to the integer.
+ * @param[in] value    The integer.
+ * @param[in] numBytes The size in bytes of the integer.
+ */
+void writeObstacleData(unsigned char *data, std::size_t value,
+                       std::size_t numBytes) {
+  for (std::size_t i = 0U; i < numBytes; ++i) {
+    data[i] = static_cast<unsigned char>(value & 0xFFU);
+    value >>= 8U;
+  }
+}
+
+/**
+ * @relates KdTree
+ * @brief   Writes a 32-bit float to saved obstacle data.
+ * @param[in] data  A pointer to the float.
+ * @param[in] value The float.
+ */
+void writeObstacleData(unsigned char *data, float value) {
+  unsigned int bits = 0U;
+  std::memcpy(&bits, &value, sizeof(bits));
+  writeObstacleData(data, bits, 4U);
+}
+
+#if defined(_OPENMP) && _OPENMP >= 201107
+/**
+ * @relates KdTree
+ * @brief   The minimum number of agents in an agent k-D tree node for its
+ *          bounds to be computed by a parallel reduction.
+ */
+const std::size_t RVO_PARALLEL_BOUNDS_SIZE = 65536U;
+
+/**
+ * @relates KdTree
+ * @brief   The minimum number of agents in an agent k-D tree node for its
+ *          subtrees to be built as separate tasks.
+ */
+const std::size_t RVO_PARALLEL_TASK_SIZE = 4096U;
+
+/**
+ * @relates KdTree
+ * @brief   The minimum product of the numbers of split candidates and of
+ *          obstacles in an obstacle k-D tree node for its split candidates to
+ *          be evaluated in parallel.
+ */
+const std::size_t RVO_PARALLEL_SPLIT_SIZE = 1048576U;
+#endif /* _OPENMP && _OPENMP >= 201107 */
 } /* namespace */
 
 /**
@@ -104,6 +346,12 @@ class KdTree::AgentTreeNode {
    * @brief The minimum y-coordinate.
    */
   float minY;
+
+  /**
+   * @brief The half-perimeter of the bounds when the node was last
+   *        partitioned.
+   */
+  float partitionExtent;
 };
 
 KdTree::AgentTreeNode::AgentTreeNode()
@@ -114,88 +362,186 @@ KdTree::AgentTreeNode::AgentTreeNode()
       maxX(0.0F),
       maxY(0.0F),
       minX(0.0F),
-      minY(0.0F) {}
+      minY(0.0F),
+      partitionExtent(0.0F) {}
 
 /**
- * @brief Defines an obstacle k-D tree node.
+ * @brief Defines a node of the bounding volume hierarchy of the dynamic
+ *        obstacles.
  */
-class KdTree::ObstacleTreeNode {
+class KdTree::DynamicObstacleTreeNode {
  public:
   /**
-   * @brief Constructs an obstacle k-D tree node instance.
+   * @brief Constructs a dynamic obstacle tree node instance.
    */
-  ObstacleTreeNode();
+  DynamicObstacleTreeNode();
 
   /**
-   * @brief Destroys this obstacle k-D tree node instance.
+   * @brief The beginning dynamic obstacle.
    */
-  ~ObstacleTreeNode();
+  std::size_t begin;
 
   /**
-   * @brief The obstacle number.
+   * @brief The ending dynamic obstacle.
    */
-  const Obstacle *obstacle;
+  std::size_t end;
 
   /**
-   * @brief The left obstacle tree node.
+   * @brief The left node number.
    */
-  ObstacleTreeNode *left;
+  std::size_t left;
 
   /**
-   * @brief The right obstacle tree node.
+   * @brief The right node number.
    */
-  ObstacleTreeNode *right;
+  std::size_t right;
 
- private:
-  /* Not implemented. */
-  ObstacleTreeNode(const ObstacleTreeNode &other);
+  /**
+   * @brief The maximum x-coordinate.
+   */
+  float maxX;
 
-  /* Not implemented. */
-  ObstacleTreeNode &operator=(const ObstacleTreeNode &other);
+  /**
+   * @brief The maximum y-coordinate.
+   */
+  float maxY;
+
+  /**
+   * @brief The minimum x-coordinate.
+   */
+  float minX;
+
+  /**
+   * @brief The minimum y-coordinate.
+   */
+  float minY;
 };
 
-KdTree::ObstacleTreeNode::ObstacleTreeNode()
-    : obstacle(NULL), left(NULL), right(NULL) {}
+KdTree::DynamicObstacleTreeNode::DynamicObstacleTreeNode()
+    : begin(0U),
+      end(0U),
+      left(0U),
+      right(0U),
+      maxX(0.0F),
+      maxY(0.0F),
+      minX(0.0F),
+      minY(0.0F) {}
 
-KdTree::ObstacleTreeNode::~ObstacleTreeNode() {}
+ObstacleTreeNode::ObstacleTreeNode()
+    : obstacle(0U),
+      left(RVO_NULL_OBSTACLE_TREE_NODE),
+      right(RVO_NULL_OBSTACLE_TREE_NODE) {}
 
 KdTree::KdTree(RVOSimulator *simulator)
-    : obstacleTree_(NULL), simulator_(simulator) {}
+    : simulator_(simulator),
+      obstacleTreeSplitCandidates_(0U),
+      agentTreeRefitThreshold_(RVO_DEFAULT_REFIT_THRESHOLD),
+      agentTreeRebuild_(false),
+      agentTreeRefit_(false) {}
 
-KdTree::~KdTree() { deleteObstacleTree(obstacleTree_); }
+KdTree::~KdTree() {}
 
 void KdTree::buildAgentTree() {
-  if (agents_.size() < simulator_->agents_.size()) {
-    agents_.insert(agents_.end(),
-                   simulator_->agents_.begin() +
-                       static_cast<std::ptrdiff_t>(agents_.size()),
-                   simulator_->agents_.end());
-    agentTree_.resize(2U * agents_.size() - 1U);
+  const std::size_t numAgents = simulator_->agents_.size();
+  bool rebuild = !agentTreeRefit_ || agentTreeRebuild_;
+  agentTreeRebuild_ = false;
+
+  if (agentTreePositions_.size() < numAgents) {
+    rebuild = true;
+  }
+
+  if (rebuild) {
+    if (agents_.size() > agentTreePositions_.size()) {
+      /* Drop the holes left by removed agents. */
+      agents_.erase(std::remove(agents_.begin(), agents_.end(), RVO_ERROR),
+                    agents_.end());
+    }
+
+    for (std::size_t i = agents_.size(); i < numAgents; ++i) {
+      agents_.push_back(i);
+    }
   }
 
   if (!agents_.empty()) {
-    buildAgentTreeRecursive(0U, agents_.size(), 0U);
+    if (rebuild) {
+      agentTree_.resize(2U * agents_.size() - 1U);
+      buildAgentTreeRecursive(0U, agents_.size(), 0U);
+    } else {
+      refitAgentTreeRecursive(0U);
+    }
+  }
+
+  /* Copy the positions in tree order for the leaf scan. Holes are placed at
+   * infinity, so that the scan never finds them. */
+  const std::vector<Vector2> &positions = simulator_->agentPositions_;
+
+  agentPositionsX_.resize(agents_.size());
+  agentPositionsY_.resize(agents_.size());
+  agentTreePositions_.resize(numAgents);
+
+  for (std::size_t i = 0U; i < agents_.size(); ++i) {
+    if (agents_[i] == RVO_ERROR) {
+      agentPositionsX_[i] = agentPositionsY_[i] =
+          std::numeric_limits<float>::infinity();
+    } else {
+      agentPositionsX_[i] = positions[agents_[i]].x();
+      agentPositionsY_[i] = positions[agents_[i]].y();
+      agentTreePositions_[agents_[i]] = i;
+    }
   }
 }
 
 void KdTree::buildAgentTreeRecursive(std::size_t begin, std::size_t end,
                                      std::size_t node) {
+  const std::vector<Vector2> &positions = simulator_->agentPositions_;
+
   agentTree_[node].begin = begin;
   agentTree_[node].end = end;
-  agentTree_[node].minX = agentTree_[node].maxX = agents_[begin]->position_.x();
-  agentTree_[node].minY = agentTree_[node].maxY = agents_[begin]->position_.y();
+  agentTree_[node].minX = agentTree_[node].maxX = positions[agents_[begin]].x();
+  agentTree_[node].minY = agentTree_[node].maxY = positions[agents_[begin]].y();
+
+#if defined(_OPENMP) && _OPENMP >= 201107
+  if (end - begin >= RVO_PARALLEL_BOUNDS_SIZE && !omp_in_parallel() &&
+      !simulator_->agentTreeSerial_) {
+    /* Top-level node outside of any team. Reduce the bounds in parallel. */
+    float maxX = agentTree_[node].maxX;
+    float minX = agentTree_[node].minX;
+    float maxY = agentTree_[node].maxY;
+    float minY = agentTree_[node].minY;
+
+#pragma omp parallel for reduction(max : maxX, maxY) reduction(min : minX, minY)
+    for (long i = static_cast<long>(begin) + 1L; i < static_cast<long>(end);
+         ++i) {
+      const Vector2 &position = positions[agents_[i]];
+      maxX = std::max(maxX, position.x());
+      minX = std::min(minX, position.x());
+      maxY = std::max(maxY, position.y());
+      minY = std::min(minY, position.y());
+    }
 
-  for (std::size_t i = begin + 1U; i < end; ++i) {
-    agentTree_[node].maxX =
-        std::max(agentTree_[node].maxX, agents_[i]->position_.x());
-    agentTree_[node].minX =
-        std::min(agentTree_[node].minX, agents_[i]->position_.x());
-    agentTree_[node].maxY =
-        std::max(agentTree_[node].maxY, agents_[i]->position_.y());
-    agentTree_[node].minY =
-        std::min(agentTree_[node].minY, agents_[i]->position_.y());
+    agentTree_[node].maxX = maxX;
+    agentTree_[node].minX = minX;
+    agentTree_[node].maxY = maxY;
+    agentTree_[node].minY = minY;
+  } else
+#endif /* _OPENMP && _OPENMP >= 201107 */
+  {
+    for (std::size_t i = begin + 1U; i < end; ++i) {
+      agentTree_[node].maxX =
+          std::max(agentTree_[node].maxX, positions[agents_[i]].x());
+      agentTree_[node].minX =
+          std::min(agentTree_[node].minX, positions[agents_[i]].x());
+      agentTree_[node].maxY =
+          std::max(agentTree_[node].maxY, positions[agents_[i]].y());
+      agentTree_[node].minY =
+          std::min(agentTree_[node].minY, positions[agents_[i]].y());
+    }
   }
 
+  agentTree_[node].partitionExtent =
+      agentTree_[node].maxX - agentTree_[node].minX + agentTree_[node].maxY -
+      agentTree_[node].minY;
+
   if (end - begin > RVO_MAX_LEAF_SIZE) {
     /* No leaf node. */
     const bool isVertical = agentTree_[node].maxX - agentTree_[node].minX >
@@ -209,14 +555,14 @@ void KdTree::buildAgentTreeRecursive(std::size_t begin, std::size_t end,
 
     while (left < right) {
       while (left < right &&
-             (isVertical ? agents_[left]->position_.x()
-                         : agents_[left]->position_.y()) < splitValue) {
+             (isVertical ? positions[agents_[left]].x()
+                         : positions[agents_[left]].y()) < splitValue) {
         ++left;
       }
 
       while (right > left &&
-             (isVertical ? agents_[right - 1U]->position_.x()
-                         : agents_[right - 1U]->position_.y()) >= splitValue) {
+             (isVertical ? positions[agents_[right - 1U]].x()
+                         : positions[agents_[right - 1U]].y()) >= splitValue) {
         --right;
       }
 
@@ -232,143 +578,304 @@ void KdTree::buildAgentTreeRecursive(std::size_t begin, std::size_t end,
       ++right;
     }
 
-    agentTree_[node].left = node + 1U;
-    agentTree_[node].right = node + 2U * (left - begin);
+    const std::size_t leftNode = node + 1U;
+    const std::size_t rightNode = node + 2U * (left - begin);
 
-    buildAgentTreeRecursive(begin, left, agentTree_[node].left);
-    buildAgentTreeRecursive(left, end, agentTree_[node].right);
+    agentTree_[node].left = leftNode;
+    agentTree_[node].right = rightNode;
+
+#if defined(_OPENMP) && _OPENMP >= 201107
+    if (end - begin >= RVO_PARALLEL_TASK_SIZE &&
+        !simulator_->agentTreeSerial_) {
+      /* The subtrees occupy disjoint ranges of agents_ and agentTree_, so they
+       * can be built concurrently without synchronization. */
+      if (omp_in_parallel()) {
+#pragma omp task firstprivate(begin, left, leftNode)
+        buildAgentTreeRecursive(begin, left, leftNode);
+
+        buildAgentTreeRecursive(left, end, rightNode);
+
+#pragma omp taskwait
+      } else {
+#pragma omp parallel
+#pragma omp single nowait
+        {
+#pragma omp task firstprivate(begin, left, leftNode)
+          buildAgentTreeRecursive(begin, left, leftNode);
+
+          buildAgentTreeRecursive(left, end, rightNode);
+
+#pragma omp taskwait
+        }
+      }
+
+      return;
+    }
+#endif /* _OPENMP && _OPENMP >= 201107 */
+
+    buildAgentTreeRecursive(begin, left, leftNode);
+    buildAgentTreeRecursive(left, end, rightNode);
+  } else if (simulator_->deterministic_) {
+    /* Lists the agents of the leaf by number, so that sorting the agents does
+     * not depend on the order in which they were partitioned. */
+    std::sort(agents_.begin() + static_cast<std::ptrdiff_t>(begin),
+              agents_.begin() + static_cast<std::ptrdiff_t>(end));
+  }
+}
+
+void KdTree::buildDynamicObstacleTree(std::size_t obstacleNo) {
+  const std::vector<Obstacle> &obstacles =
+      simulator_->obstacleWorld_->obstacles_;
+
+  /* The vertices of each dynamic obstacle are contiguous, so the last one
+   * precedes the first vertex of the next obstacle. */
+  dynamicObstacles_.clear();
+
+  for (std::size_t i = obstacleNo; i < obstacles.size();
+       i = obstacles[i].previous_ + 1U) {
+    dynamicObstacles_.push_back(i);
+  }
+
+  dynamicObstacleTree_.clear();
+
+  if (!dynamicObstacles_.empty()) {
+    dynamicObstacleTree_.resize(2U * dynamicObstacles_.size() - 1U);
+    buildDynamicObstacleTreeRecursive(0U, dynamicObstacles_.size(), 0U);
+  }
+}
+
+void KdTree::buildDynamicObstacleTreeRecursive(std::size_t begin,
+                                               std::size_t end,
+                                               std::size_t node) {
+  const std::vector<Obstacle> &obstacles =
+      simulator_->obstacleWorld_->obstacles_;
+  DynamicObstacleTreeNode &treeNode = dynamicObstacleTree_[node];
+
+  treeNode.begin = begin;
+  treeNode.end = end;
+
+  const Vector2 &firstPoint = obstacles[dynamicObstacles_[begin]].point_;
+  treeNode.minX = treeNode.maxX = firstPoint.x();
+  treeNode.minY = treeNode.maxY = firstPoint.y();
+
+  for (std::size_t i = begin; i < end; ++i) {
+    std::size_t obstacleNo = dynamicObstacles_[i];
+
+    do {
+      const Vector2 &point = obstacles[obstacleNo].point_;
+      treeNode.maxX = std::max(treeNode.maxX, point.x());
+      treeNode.minX = std::min(treeNode.minX, point.x());
+      treeNode.maxY = std::max(treeNode.maxY, point.y());
+      treeNode.minY = std::min(treeNode.minY, point.y());
+      obstacleNo = obstacles[obstacleNo].next_;
+    } while (obstacleNo != dynamicObstacles_[i]);
+  }
+
+  if (end - begin > RVO_MAX_DYNAMIC_OBSTACLE_LEAF_SIZE) {
+    /* No leaf node. Partition by the first vertex of each obstacle. */
+    const bool isVertical =
+        treeNode.maxX - treeNode.minX > treeNode.maxY - treeNode.minY;
+    const float splitValue =
+        0.5F * (isVertical ? treeNode.maxX + treeNode.minX
+                           : treeNode.maxY + treeNode.minY);
+
+    std::size_t left = begin;
+    std::size_t right = end;
+
+    while (left < right) {
+      while (left < right &&
+             (isVertical ? obstacles[dynamicObstacles_[left]].point_.x()
+                         : obstacles[dynamicObstacles_[left]].point_.y()) <
+                 splitValue) {
+        ++left;
+      }
+
+      while (right > left &&
+             (isVertical ? obstacles[dynamicObstacles_[right - 1U]].point_.x()
+                         : obstacles[dynamicObstacles_[right - 1U]]
+                               .point_.y()) >= splitValue) {
+        --right;
+      }
+
+      if (left < right) {
+        std::swap(dynamicObstacles_[left], dynamicObstacles_[right - 1U]);
+        ++left;
+        --right;
+      }
+    }
+
+    /* The first vertices need not span the bounds, so either side may be
+     * empty. */
+    if (left == begin) {
+      ++left;
+    } else if (left == end) {
+      --left;
+    }
+
+    treeNode.left = node + 1U;
+    treeNode.right = node + 2U * (left - begin);
+
+    buildDynamicObstacleTreeRecursive(begin, left, treeNode.left);
+    buildDynamicObstacleTreeRecursive(left, end, treeNode.right);
   }
 }
 
 void KdTree::buildObstacleTree() {
-  deleteObstacleTree(obstacleTree_);
+  simulator_->obstacleWorld_->obstacleTree_.clear();
+
+  std::vector<std::size_t> obstacles(
+      simulator_->obstacleWorld_->obstacles_.size());
 
-  const std::vector<Obstacle *> obstacles(simulator_->obstacles_);
-  obstacleTree_ = buildObstacleTreeRecursive(obstacles);
+  for (std::size_t i = 0U; i < obstacles.size(); ++i) {
+    obstacles[i] = i;
+  }
+
+  buildObstacleTreeRecursive(obstacles);
 }
 
-KdTree::ObstacleTreeNode *KdTree::buildObstacleTreeRecursive(
-    const std::vector<Obstacle *> &obstacles) {
+std::size_t KdTree::buildObstacleTreeRecursive(
+    const std::vector<std::size_t> &obstacles) {
   if (!obstacles.empty()) {
-    ObstacleTreeNode *const node = new ObstacleTreeNode();
+    /* Obstacles are referred to by number, since splitting them appends to
+     * the array of obstacles. */
+    std::vector<Obstacle> &allObstacles =
+        simulator_->obstacleWorld_->obstacles_;
+
+    const std::size_t numObstacles = obstacles.size();
+    const std::size_t numCandidates =
+        obstacleTreeSplitCandidates_ == 0U ||
+                obstacleTreeSplitCandidates_ > numObstacles
+            ? numObstacles
+            : obstacleTreeSplitCandidates_;
 
     std::size_t optimalSplit = 0U;
-    std::size_t minLeft = obstacles.size();
-    std::size_t minRight = obstacles.size();
-
-    for (std::size_t i = 0U; i < obstacles.size(); ++i) {
-      std::size_t leftSize = 0U;
-      std::size_t rightSize = 0U;
-
-      const Obstacle *const obstacleI1 = obstacles[i];
-      const Obstacle *const obstacleI2 = obstacleI1->next_;
-
-      /* Compute optimal split node. */
-      for (std::size_t j = 0U; j < obstacles.size(); ++j) {
-        if (i != j) {
-          const Obstacle *const obstacleJ1 = obstacles[j];
-          const Obstacle *const obstacleJ2 = obstacleJ1->next_;
-
-          const float j1LeftOfI = leftOf(obstacleI1->point_, obstacleI2->point_,
-                                         obstacleJ1->point_);
-          const float j2LeftOfI = leftOf(obstacleI1->point_, obstacleI2->point_,
-                                         obstacleJ2->point_);
-
-          if (j1LeftOfI >= -RVO_EPSILON && j2LeftOfI >= -RVO_EPSILON) {
-            ++leftSize;
-          } else if (j1LeftOfI <= RVO_EPSILON && j2LeftOfI <= RVO_EPSILON) {
-            ++rightSize;
-          } else {
-            ++leftSize;
-            ++rightSize;
+    std::size_t minLeft = numObstacles;
+    std::size_t minRight = numObstacles;
+
+    /* Compute optimal split node among evenly spaced candidates. */
+#if defined(_OPENMP) && _OPENMP >= 201107
+    if (numCandidates * numObstacles >= RVO_PARALLEL_SPLIT_SIZE &&
+        !omp_in_parallel()) {
+#pragma omp parallel
+      {
+        std::size_t threadSplit = 0U;
+        std::size_t threadLeft = numObstacles;
+        std::size_t threadRight = numObstacles;
+
+#pragma omp for schedule(dynamic, 16) nowait
+        for (long c = 0L; c < static_cast<long>(numCandidates); ++c) {
+          const std::size_t i =
+              static_cast<std::size_t>(c) * numObstacles / numCandidates;
+
+          if (countObstacleSplit(obstacles, i, threadLeft, threadRight)) {
+            threadSplit = i;
           }
+        }
 
-          if (std::make_pair(std::max(leftSize, rightSize),
-                             std::min(leftSize, rightSize)) >=
-              std::make_pair(std::max(minLeft, minRight),
-                             std::min(minLeft, minRight))) {
-            break;
+#pragma omp critical
+        {
+          /* Keep the first of equally good candidates, as when serial. */
+          const std::pair<std::size_t, std::size_t> threadCost =
+              std::make_pair(std::max(threadLeft, threadRight),
+                             std::min(threadLeft, threadRight));
+          const std::pair<std::size_t, std::size_t> minCost = std::make_pair(
+              std::max(minLeft, minRight), std::min(minLeft, minRight));
+
+          if (threadCost < minCost ||
+              (threadCost == minCost && threadSplit < optimalSplit)) {
+            minLeft = threadLeft;
+            minRight = threadRight;
+            optimalSplit = threadSplit;
           }
         }
       }
-
-      if (std::make_pair(std::max(leftSize, rightSize),
-                         std::min(leftSize, rightSize)) <
-          std::make_pair(std::max(minLeft, minRight),
-                         std::min(minLeft, minRight))) {
-        minLeft = leftSize;
-        minRight = rightSize;
-        optimalSplit = i;
+    } else
+#endif /* _OPENMP && _OPENMP >= 201107 */
+    {
+      for (std::size_t c = 0U; c < numCandidates; ++c) {
+        const std::size_t i = c * numObstacles / numCandidates;
+
+        if (countObstacleSplit(obstacles, i, minLeft, minRight)) {
+          optimalSplit = i;
+        }
       }
     }
 
     /* Build split node. */
-    std::vector<Obstacle *> leftObstacles(minLeft);
-    std::vector<Obstacle *> rightObstacles(minRight);
+    std::vector<std::size_t> leftObstacles(minLeft);
+    std::vector<std::size_t> rightObstacles(minRight);
 
     std::size_t leftCounter = 0U;
     std::size_t rightCounter = 0U;
     const std::size_t i = optimalSplit;
 
-    const Obstacle *const obstacleI1 = obstacles[i];
-    const Obstacle *const obstacleI2 = obstacleI1->next_;
+    const std::size_t obstacleNoI1 = obstacles[i];
+    const Vector2 pointI1 = allObstacles[obstacleNoI1].point_;
+    const Vector2 pointI2 =
+        allObstacles[allObstacles[obstacleNoI1].next_].point_;
 
     for (std::size_t j = 0U; j < obstacles.size(); ++j) {
       if (i != j) {
-        Obstacle *const obstacleJ1 = obstacles[j];
-        Obstacle *const obstacleJ2 = obstacleJ1->next_;
+        const std::size_t obstacleNoJ1 = obstacles[j];
+        const std::size_t obstacleNoJ2 = allObstacles[obstacleNoJ1].next_;
+        const Vector2 pointJ1 = allObstacles[obstacleNoJ1].point_;
+        const Vector2 pointJ2 = allObstacles[obstacleNoJ2].point_;
 
-        const float j1LeftOfI =
-            leftOf(obstacleI1->point_, obstacleI2->point_, obstacleJ1->point_);
-        const float j2LeftOfI =
-            leftOf(obstacleI1->point_, obstacleI2->point_, obstacleJ2->point_);
+        const float j1LeftOfI = leftOf(pointI1, pointI2, pointJ1);
+        const float j2LeftOfI = leftOf(pointI1, pointI2, pointJ2);
 
         if (j1LeftOfI >= -RVO_EPSILON && j2LeftOfI >= -RVO_EPSILON) {
-          leftObstacles[leftCounter++] = obstacles[j];
+          leftObstacles[leftCounter++] = obstacleNoJ1;
         } else if (j1LeftOfI <= RVO_EPSILON && j2LeftOfI <= RVO_EPSILON) {
-          rightObstacles[rightCounter++] = obstacles[j];
+          rightObstacles[rightCounter++] = obstacleNoJ1;
         } else {
           /* Split obstacle j. */
-          const float t = det(obstacleI2->point_ - obstacleI1->point_,
-                              obstacleJ1->point_ - obstacleI1->point_) /
-                          det(obstacleI2->point_ - obstacleI1->point_,
-                              obstacleJ1->point_ - obstacleJ2->point_);
-
-          const Vector2 splitPoint =
-              obstacleJ1->point_ +
-              t * (obstacleJ2->point_ - obstacleJ1->point_);
-
-          Obstacle *const newObstacle = new Obstacle();
-          newObstacle->direction_ = obstacleJ1->direction_;
-          newObstacle->point_ = splitPoint;
-          newObstacle->next_ = obstacleJ2;
-          newObstacle->previous_ = obstacleJ1;
-          newObstacle->id_ = simulator_->obstacles_.size();
-          newObstacle->isConvex_ = true;
-          simulator_->obstacles_.push_back(newObstacle);
-
-          obstacleJ1->next_ = newObstacle;
-          obstacleJ2->previous_ = newObstacle;
+          const float t = det(pointI2 - pointI1, pointJ1 - pointI1) /
+                          det(pointI2 - pointI1, pointJ1 - pointJ2);
+
+          const Vector2 splitPoint = pointJ1 + t * (pointJ2 - pointJ1);
+
+          Obstacle newObstacle;
+          newObstacle.direction_ = allObstacles[obstacleNoJ1].direction_;
+          newObstacle.point_ = splitPoint;
+          newObstacle.next_ = obstacleNoJ2;
+          newObstacle.previous_ = obstacleNoJ1;
+          newObstacle.isConvex_ = true;
+
+          const std::size_t newObstacleNo = allObstacles.size();
+          allObstacles.push_back(newObstacle);
+
+          allObstacles[obstacleNoJ1].next_ = newObstacleNo;
+          allObstacles[obstacleNoJ2].previous_ = newObstacleNo;
 
           if (j1LeftOfI > 0.0F) {
-            leftObstacles[leftCounter++] = obstacleJ1;
-            rightObstacles[rightCounter++] = newObstacle;
+            leftObstacles[leftCounter++] = obstacleNoJ1;
+            rightObstacles[rightCounter++] = newObstacleNo;
           } else {
-            rightObstacles[rightCounter++] = obstacleJ1;
-            leftObstacles[leftCounter++] = newObstacle;
+            rightObstacles[rightCounter++] = obstacleNoJ1;
+            leftObstacles[leftCounter++] = newObstacleNo;
           }
         }
       }
     }
 
-    node->obstacle = obstacleI1;
-    node->left = buildObstacleTreeRecursive(leftObstacles);
-    node->right = buildObstacleTreeRecursive(rightObstacles);
+    std::vector<ObstacleTreeNode> &obstacleTree =
+        simulator_->obstacleWorld_->obstacleTree_;
+    const std::size_t node = obstacleTree.size();
+    obstacleTree.push_back(ObstacleTreeNode());
+    obstacleTree[node].point1 = pointI1;
+    obstacleTree[node].point2 = pointI2;
+    obstacleTree[node].obstacle = obstacleNoI1;
+
+    const std::size_t leftNode = buildObstacleTreeRecursive(leftObstacles);
+    const std::size_t rightNode = buildObstacleTreeRecursive(rightObstacles);
+    obstacleTree[node].left = leftNode;
+    obstacleTree[node].right = rightNode;
 
     return node;
   }
 
-  return NULL;
+  return RVO_NULL_OBSTACLE_TREE_NODE;
 }
 
 void KdTree::computeAgentNeighbors(Agent *agent, float &rangeSq) const {
@@ -376,46 +883,190 @@ void KdTree::computeAgentNeighbors(Agent *agent, float &rangeSq) const {
 }
 
 void KdTree::computeObstacleNeighbors(Agent *agent, float rangeSq) const {
-  queryObstacleTreeRecursive(agent, rangeSq, obstacleTree_);
+  if (!simulator_->obstacleWorld_->obstacleTree_.empty()) {
+    queryObstacleTreeRecursive(agent, rangeSq, 0U);
+  }
+
+  if (!dynamicObstacleTree_.empty()) {
+    queryDynamicObstacleTreeRecursive(agent, rangeSq, 0U);
+  }
 }
 
-void KdTree::deleteObstacleTree(ObstacleTreeNode *node) {
-  if (node != NULL) {
-    deleteObstacleTree(node->left);
-    deleteObstacleTree(node->right);
-    delete node;
+bool KdTree::countObstacleSplit(
+    const std::vector<std::size_t> &obstacles, std::size_t i,
+    std::size_t &minLeft, /* NOLINT(runtime/references) */
+    std::size_t &minRight) const { /* NOLINT(runtime/references) */
+  const std::vector<Obstacle> &allObstacles =
+      simulator_->obstacleWorld_->obstacles_;
+
+  std::size_t leftSize = 0U;
+  std::size_t rightSize = 0U;
+
+  const Obstacle &obstacleI1 = allObstacles[obstacles[i]];
+  const Obstacle &obstacleI2 = allObstacles[obstacleI1.next_];
+
+  for (std::size_t j = 0U; j < obstacles.size(); ++j) {
+    if (i != j) {
+      const Obstacle &obstacleJ1 = allObstacles[obstacles[j]];
+      const Obstacle &obstacleJ2 = allObstacles[obstacleJ1.next_];
+
+      const float j1LeftOfI =
+          leftOf(obstacleI1.point_, obstacleI2.point_, obstacleJ1.point_);
+      const float j2LeftOfI =
+          leftOf(obstacleI1.point_, obstacleI2.point_, obstacleJ2.point_);
+
+      if (j1LeftOfI >= -RVO_EPSILON && j2LeftOfI >= -RVO_EPSILON) {
+        ++leftSize;
+      } else if (j1LeftOfI <= RVO_EPSILON && j2LeftOfI <= RVO_EPSILON) {
+        ++rightSize;
+      } else {
+        ++leftSize;
+        ++rightSize;
+      }
+
+      if (std::make_pair(std::max(leftSize, rightSize),
+                         std::min(leftSize, rightSize)) >=
+          std::make_pair(std::max(minLeft, minRight),
+                         std::min(minLeft, minRight))) {
+        return false;
+      }
+    }
+  }
+
+  if (std::make_pair(std::max(leftSize, rightSize),
+                     std::min(leftSize, rightSize)) <
+      std::make_pair(std::max(minLeft, minRight),
+                     std::min(minLeft, minRight))) {
+    minLeft = leftSize;
+    minRight = rightSize;
+
+    return true;
+  }
+
+  return false;
+}
+
+bool KdTree::loadObstacles(const void *data, std::size_t size) {
+  const unsigned char *in = static_cast<const unsigned char *>(data);
+
+  if (in == NULL || size < RVO_OBSTACLE_DATA_HEADER_SIZE ||
+      std::memcmp(in, RVO_OBSTACLE_DATA_MAGIC,
+                  sizeof(RVO_OBSTACLE_DATA_MAGIC)) != 0) {
+    return false;
+  }
+
+  bool valid = true;
+  const std::size_t version = readObstacleData(in + 8U, 4U, valid);
+  const std::size_t numObstacles = readObstacleData(in + 16U, 8U, valid);
+  const std::size_t numNodes = readObstacleData(in + 24U, 8U, valid);
+  const std::size_t dataSize = size - RVO_OBSTACLE_DATA_HEADER_SIZE;
+
+  if (!valid || version != RVO_OBSTACLE_DATA_VERSION ||
+      numObstacles > dataSize / RVO_OBSTACLE_DATA_VERTEX_SIZE ||
+      numNodes > (dataSize - numObstacles * RVO_OBSTACLE_DATA_VERTEX_SIZE) /
+                     RVO_OBSTACLE_DATA_NODE_SIZE) {
+    return false;
+  }
+
+  std::vector<Obstacle> obstacles(numObstacles);
+  std::vector<ObstacleTreeNode> obstacleTree(numNodes);
+  in += RVO_OBSTACLE_DATA_HEADER_SIZE;
+
+  for (std::size_t i = 0U; i < numObstacles; ++i) {
+    Obstacle &obstacle = obstacles[i];
+    obstacle.point_ =
+        Vector2(readObstacleData(in), readObstacleData(in + 4U));
+    obstacle.direction_ =
+        Vector2(readObstacleData(in + 8U), readObstacleData(in + 12U));
+    obstacle.next_ = readObstacleData(in + 16U, 8U, valid);
+    obstacle.previous_ = readObstacleData(in + 24U, 8U, valid);
+    obstacle.isConvex_ = readObstacleData(in + 32U, 4U, valid) != 0U;
+
+    valid = valid && obstacle.next_ < numObstacles &&
+            obstacle.previous_ < numObstacles;
+    in += RVO_OBSTACLE_DATA_VERTEX_SIZE;
+  }
+
+  for (std::size_t i = 0U; i < numNodes; ++i) {
+    ObstacleTreeNode &node = obstacleTree[i];
+    node.point1 = Vector2(readObstacleData(in), readObstacleData(in + 4U));
+    node.point2 =
+        Vector2(readObstacleData(in + 8U), readObstacleData(in + 12U));
+    node.obstacle = readObstacleData(in + 16U, 8U, valid);
+    node.left = readObstacleData(in + 24U, 8U, valid);
+    node.right = readObstacleData(in + 32U, 8U, valid);
+
+    /* Children follow their parent in depth-first order, which also rules
+     * out cycles. */
+    valid = valid && node.obstacle < numObstacles &&
+            (node.left == 0U || (node.left > i && node.left < numNodes)) &&
+            (node.right == 0U || (node.right > i && node.right < numNodes));
+
+    if (node.left == 0U) {
+      node.left = RVO_NULL_OBSTACLE_TREE_NODE;
+    }
+
+    if (node.right == 0U) {
+      node.right = RVO_NULL_OBSTACLE_TREE_NODE;
+    }
+
+    in += RVO_OBSTACLE_DATA_NODE_SIZE;
   }
+
+  if (!valid) {
+    return false;
+  }
+
+  simulator_->obstacleWorld_->obstacles_.swap(obstacles);
+  simulator_->obstacleWorld_->obstacleTree_.swap(obstacleTree);
+
+  return true;
 }
 
 void KdTree::queryAgentTreeRecursive(Agent *agent, float &rangeSq,
                                      std::size_t node) const {
+#ifdef RVO_ENABLE_PROFILING
+  ++agent->agentTreeNodesVisited_;
+#endif /* RVO_ENABLE_PROFILING */
+
   if (agentTree_[node].end - agentTree_[node].begin <= RVO_MAX_LEAF_SIZE) {
-    for (std::size_t i = agentTree_[node].begin; i < agentTree_[node].end;
-         ++i) {
-      agent->insertAgentNeighbor(agents_[i], rangeSq);
+    const std::size_t begin = agentTree_[node].begin;
+    const std::size_t numAgents = agentTree_[node].end - begin;
+    float distSq[RVO_MAX_LEAF_SIZE];
+
+    computeDistancesSq(&agentPositionsX_[begin], &agentPositionsY_[begin],
+                       numAgents, simulator_->agentPositions_[agent->id_],
+                       distSq);
+
+    for (std::size_t i = 0U; i < numAgents; ++i) {
+      if (distSq[i] < rangeSq) {
+        agent->insertAgentNeighbor(agents_[begin + i], distSq[i], rangeSq);
+      }
     }
   } else {
+    const Vector2 &position = simulator_->agentPositions_[agent->id_];
+
     const float distLeftMinX = std::max(
-        0.0F, agentTree_[agentTree_[node].left].minX - agent->position_.x());
+        0.0F, agentTree_[agentTree_[node].left].minX - position.x());
     const float distLeftMaxX = std::max(
-        0.0F, agent->position_.x() - agentTree_[agentTree_[node].left].maxX);
+        0.0F, position.x() - agentTree_[agentTree_[node].left].maxX);
     const float distLeftMinY = std::max(
-        0.0F, agentTree_[agentTree_[node].left].minY - agent->position_.y());
+        0.0F, agentTree_[agentTree_[node].left].minY - position.y());
     const float distLeftMaxY = std::max(
-        0.0F, agent->position_.y() - agentTree_[agentTree_[node].left].maxY);
+        0.0F, position.y() - agentTree_[agentTree_[node].left].maxY);
 
     const float distSqLeft =
         distLeftMinX * distLeftMinX + distLeftMaxX * distLeftMaxX +
         distLeftMinY * distLeftMinY + distLeftMaxY * distLeftMaxY;
 
     const float distRightMinX = std::max(
-        0.0F, agentTree_[agentTree_[node].right].minX - agent->position_.x());
+        0.0F, agentTree_[agentTree_[node].right].minX - position.x());
     const float distRightMaxX = std::max(
-        0.0F, agent->position_.x() - agentTree_[agentTree_[node].right].maxX);
+        0.0F, position.x() - agentTree_[agentTree_[node].right].maxX);
     const float distRightMinY = std::max(
-        0.0F, agentTree_[agentTree_[node].right].minY - agent->position_.y());
+        0.0F, agentTree_[agentTree_[node].right].minY - position.y());
     const float distRightMaxY = std::max(
-        0.0F, agent->position_.y() - agentTree_[agentTree_[node].right].maxY);
+        0.0F, position.y() - agentTree_[agentTree_[node].right].maxY);
 
     const float distSqRight =
         distRightMinX * distRightMinX + distRightMaxX * distRightMaxX +
@@ -439,85 +1090,455 @@ void KdTree::queryAgentTreeRecursive(Agent *agent, float &rangeSq,
   }
 }
 
+void KdTree::queryDynamicObstacleTreeRecursive(Agent *agent, float rangeSq,
+                                               std::size_t node) const {
+#ifdef RVO_ENABLE_PROFILING
+  ++agent->obstacleTreeNodesVisited_;
+#endif /* RVO_ENABLE_PROFILING */
+
+  const std::vector<Obstacle> &obstacles =
+      simulator_->obstacleWorld_->obstacles_;
+  const Vector2 &position = simulator_->agentPositions_[agent->id_];
+  const DynamicObstacleTreeNode &treeNode = dynamicObstacleTree_[node];
+
+  const float distMinX = std::max(0.0F, treeNode.minX - position.x());
+  const float distMaxX = std::max(0.0F, position.x() - treeNode.maxX);
+  const float distMinY = std::max(0.0F, treeNode.minY - position.y());
+  const float distMaxY = std::max(0.0F, position.y() - treeNode.maxY);
+
+  if (distMinX * distMinX + distMaxX * distMaxX + distMinY * distMinY +
+          distMaxY * distMaxY >=
+      rangeSq) {
+    return;
+  }
+
+  if (treeNode.end - treeNode.begin <= RVO_MAX_DYNAMIC_OBSTACLE_LEAF_SIZE) {
+    for (std::size_t i = treeNode.begin; i < treeNode.end; ++i) {
+      std::size_t obstacleNo = dynamicObstacles_[i];
+
+      do {
+        const Obstacle &obstacle1 = obstacles[obstacleNo];
+        const Obstacle &obstacle2 = obstacles[obstacle1.next_];
+
+        /* Try the edge only if the agent is on its right side, as for static
+         * obstacles. */
+        if (leftOf(obstacle1.point_, obstacle2.point_, position) < 0.0F) {
+          agent->insertObstacleNeighbor(obstacleNo, rangeSq);
+        }
+
+        obstacleNo = obstacle1.next_;
+      } while (obstacleNo != dynamicObstacles_[i]);
+    }
+  } else {
+    queryDynamicObstacleTreeRecursive(agent, rangeSq, treeNode.left);
+    queryDynamicObstacleTreeRecursive(agent, rangeSq, treeNode.right);
+  }
+}
+
+bool KdTree::queryDynamicVisibilityRecursive(const Vector2 &vector1,
+                                             const Vector2 &vector2,
+                                             float radius,
+                                             std::size_t node) const {
+  const std::vector<Obstacle> &obstacles =
+      simulator_->obstacleWorld_->obstacles_;
+  const DynamicObstacleTreeNode &treeNode = dynamicObstacleTree_[node];
+
+  if (std::min(vector1.x(), vector2.x()) - radius > treeNode.maxX ||
+      std::max(vector1.x(), vector2.x()) + radius < treeNode.minX ||
+      std::min(vector1.y(), vector2.y()) - radius > treeNode.maxY ||
+      std::max(vector1.y(), vector2.y()) + radius < treeNode.minY) {
+    return true;
+  }
+
+  if (treeNode.end - treeNode.begin > RVO_MAX_DYNAMIC_OBSTACLE_LEAF_SIZE) {
+    return queryDynamicVisibilityRecursive(vector1, vector2, radius,
+                                           treeNode.left) &&
+           queryDynamicVisibilityRecursive(vector1, vector2, radius,
+                                           treeNode.right);
+  }
+
+  for (std::size_t i = treeNode.begin; i < treeNode.end; ++i) {
+    std::size_t obstacleNo = dynamicObstacles_[i];
+
+    do {
+      const Obstacle &obstacle1 = obstacles[obstacleNo];
+      const Vector2 &point1 = obstacle1.point_;
+      const Vector2 &point2 = obstacles[obstacle1.next_].point_;
+
+      /* The same test as for a static obstacle without subtrees. */
+      if (classifyVisibility(point1, point2, vector1, vector2, radius) ==
+          RVO_VISIBILITY_BLOCKED) {
+        return false;
+      }
+
+      obstacleNo = obstacle1.next_;
+    } while (obstacleNo != dynamicObstacles_[i]);
+  }
+
+  return true;
+}
+
 void KdTree::queryObstacleTreeRecursive(Agent *agent, float rangeSq,
-                                        const ObstacleTreeNode *node) const {
-  if (node != NULL) {
-    const Obstacle *const obstacle1 = node->obstacle;
-    const Obstacle *const obstacle2 = obstacle1->next_;
+                                        std::size_t node) const {
+  if (node != RVO_NULL_OBSTACLE_TREE_NODE) {
+#ifdef RVO_ENABLE_PROFILING
+    ++agent->obstacleTreeNodesVisited_;
+#endif /* RVO_ENABLE_PROFILING */
+
+    const ObstacleTreeNode &treeNode =
+        simulator_->obstacleWorld_->obstacleTree_[node];
 
     const float agentLeftOfLine =
-        leftOf(obstacle1->point_, obstacle2->point_, agent->position_);
+        leftOf(treeNode.point1, treeNode.point2,
+               simulator_->agentPositions_[agent->id_]);
 
     queryObstacleTreeRecursive(
-        agent, rangeSq, agentLeftOfLine >= 0.0F ? node->left : node->right);
+        agent, rangeSq,
+        agentLeftOfLine >= 0.0F ? treeNode.left : treeNode.right);
 
     const float distSqLine = agentLeftOfLine * agentLeftOfLine /
-                             absSq(obstacle2->point_ - obstacle1->point_);
+                             absSq(treeNode.point2 - treeNode.point1);
 
     if (distSqLine < rangeSq) {
       if (agentLeftOfLine < 0.0F) {
         /* Try obstacle at this node only if agent is on right side of obstacle
          * and can see obstacle. */
-        agent->insertObstacleNeighbor(node->obstacle, rangeSq);
+        agent->insertObstacleNeighbor(treeNode.obstacle, rangeSq);
       }
 
       /* Try other side of line. */
       queryObstacleTreeRecursive(
-          agent, rangeSq, agentLeftOfLine >= 0.0F ? node->right : node->left);
+          agent, rangeSq,
+          agentLeftOfLine >= 0.0F ? treeNode.right : treeNode.left);
     }
   }
 }
 
 bool KdTree::queryVisibility(const Vector2 &vector1, const Vector2 &vector2,
                              float radius) const {
-  return queryVisibilityRecursive(vector1, vector2, radius, obstacleTree_);
+  return (simulator_->obstacleWorld_->obstacleTree_.empty() ||
+          queryVisibilityRecursive(vector1, vector2, radius, 0U)) &&
+         (dynamicObstacleTree_.empty() ||
+          queryDynamicVisibilityRecursive(vector1, vector2, radius, 0U));
+}
+
+void KdTree::queryVisibility(const std::pair<Vector2, Vector2> *segments,
+                             std::size_t numSegments, float radius,
+                             bool *visible) const {
+  const long numPackets =
+      static_cast<long>((numSegments + RVO_VISIBILITY_PACKET_SIZE - 1U) /
+                        RVO_VISIBILITY_PACKET_SIZE);
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif /* _OPENMP */
+  {
+    std::vector<std::size_t> packet;
+    std::vector<std::size_t> rightSegments;
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif /* _OPENMP */
+    for (long i = 0L; i < numPackets; ++i) {
+      const std::size_t begin =
+          static_cast<std::size_t>(i) * RVO_VISIBILITY_PACKET_SIZE;
+      const std::size_t end =
+          std::min(begin + RVO_VISIBILITY_PACKET_SIZE, numSegments);
+
+      packet.clear();
+
+      for (std::size_t j = begin; j < end; ++j) {
+        visible[j] = true;
+        packet.push_back(j);
+      }
+
+      if (!simulator_->obstacleWorld_->obstacleTree_.empty()) {
+        queryVisibilityRecursive(segments, radius, 0U, packet.size(), packet,
+                                 rightSegments, visible, 0U);
+      }
+
+      if (!dynamicObstacleTree_.empty()) {
+        for (std::size_t j = begin; j < end; ++j) {
+          visible[j] = visible[j] &&
+                       queryDynamicVisibilityRecursive(
+                           segments[j].first, segments[j].second, radius, 0U);
+        }
+      }
+    }
+  }
 }
 
 bool KdTree::queryVisibilityRecursive(const Vector2 &vector1,
                                       const Vector2 &vector2, float radius,
-                                      const ObstacleTreeNode *node) const {
-  if (node != NULL) {
-    const Obstacle *const obstacle1 = node->obstacle;
-    const Obstacle *const obstacle2 = obstacle1->next_;
-
-    const float q1LeftOfI =
-        leftOf(obstacle1->point_, obstacle2->point_, vector1);
-    const float q2LeftOfI =
-        leftOf(obstacle1->point_, obstacle2->point_, vector2);
-    const float invLengthI =
-        1.0F / absSq(obstacle2->point_ - obstacle1->point_);
+                                      std::size_t node) const {
+  if (node != RVO_NULL_OBSTACLE_TREE_NODE) {
+    const ObstacleTreeNode &treeNode =
+        simulator_->obstacleWorld_->obstacleTree_[node];
+    const std::size_t left = treeNode.left;
+    const std::size_t right = treeNode.right;
+
+    const float q1LeftOfI = leftOf(treeNode.point1, treeNode.point2, vector1);
+    const float q2LeftOfI = leftOf(treeNode.point1, treeNode.point2, vector2);
+    const float invLengthI = 1.0F / absSq(treeNode.point2 - treeNode.point1);
 
     if (q1LeftOfI >= 0.0F && q2LeftOfI >= 0.0F) {
-      return queryVisibilityRecursive(vector1, vector2, radius, node->left) &&
+      return queryVisibilityRecursive(vector1, vector2, radius, left) &&
              ((q1LeftOfI * q1LeftOfI * invLengthI >= radius * radius &&
                q2LeftOfI * q2LeftOfI * invLengthI >= radius * radius) ||
-              queryVisibilityRecursive(vector1, vector2, radius, node->right));
+              queryVisibilityRecursive(vector1, vector2, radius, right));
     }
 
     if (q1LeftOfI <= 0.0F && q2LeftOfI <= 0.0F) {
-      return queryVisibilityRecursive(vector1, vector2, radius, node->right) &&
+      return queryVisibilityRecursive(vector1, vector2, radius, right) &&
              ((q1LeftOfI * q1LeftOfI * invLengthI >= radius * radius &&
                q2LeftOfI * q2LeftOfI * invLengthI >= radius * radius) ||
-              queryVisibilityRecursive(vector1, vector2, radius, node->left));
+              queryVisibilityRecursive(vector1, vector2, radius, left));
     }
 
     if (q1LeftOfI >= 0.0F && q2LeftOfI <= 0.0F) {
       /* One can see through obstacle from left to right. */
-      return queryVisibilityRecursive(vector1, vector2, radius, node->left) &&
-             queryVisibilityRecursive(vector1, vector2, radius, node->right);
+      return queryVisibilityRecursive(vector1, vector2, radius, left) &&
+             queryVisibilityRecursive(vector1, vector2, radius, right);
     }
 
-    const float point1LeftOfQ = leftOf(vector1, vector2, obstacle1->point_);
-    const float point2LeftOfQ = leftOf(vector1, vector2, obstacle2->point_);
+    const float point1LeftOfQ = leftOf(vector1, vector2, treeNode.point1);
+    const float point2LeftOfQ = leftOf(vector1, vector2, treeNode.point2);
     const float invLengthQ = 1.0F / absSq(vector2 - vector1);
 
     return point1LeftOfQ * point2LeftOfQ >= 0.0F &&
            point1LeftOfQ * point1LeftOfQ * invLengthQ > radius * radius &&
            point2LeftOfQ * point2LeftOfQ * invLengthQ > radius * radius &&
-           queryVisibilityRecursive(vector1, vector2, radius, node->left) &&
-           queryVisibilityRecursive(vector1, vector2, radius, node->right);
+           queryVisibilityRecursive(vector1, vector2, radius, left) &&
+           queryVisibilityRecursive(vector1, vector2, radius, right);
   }
 
   return true;
 }
+
+void KdTree::queryVisibilityRecursive(
+    const std::pair<Vector2, Vector2> *segments, float radius,
+    std::size_t begin, std::size_t end,
+    std::vector<std::size_t> &packet,        /* NOLINT(runtime/references) */
+    std::vector<std::size_t> &rightSegments, /* NOLINT(runtime/references) */
+    bool *visible, std::size_t node) const {
+  if (node != RVO_NULL_OBSTACLE_TREE_NODE) {
+    const ObstacleTreeNode &treeNode =
+        simulator_->obstacleWorld_->obstacleTree_[node];
+
+    /* Queue the segments that search the left subtree after the present
+     * packet, and set aside those that search the right subtree until the
+     * left subtree has been searched. */
+    const std::size_t leftBegin = packet.size();
+    const std::size_t rightBegin = rightSegments.size();
+
+    for (std::size_t i = begin; i < end; ++i) {
+      const std::size_t segmentNo = packet[i];
+
+      if (visible[segmentNo]) {
+        const unsigned int flags = classifyVisibility(
+            treeNode.point1, treeNode.point2, segments[segmentNo].first,
+            segments[segmentNo].second, radius);
+
+        if ((flags & RVO_VISIBILITY_BLOCKED) != 0U) {
+          visible[segmentNo] = false;
+        } else {
+          if ((flags & RVO_VISIBILITY_LEFT) != 0U) {
+            packet.push_back(segmentNo);
+          }
+
+          if ((flags & RVO_VISIBILITY_RIGHT) != 0U) {
+            rightSegments.push_back(segmentNo);
+          }
+        }
+      }
+    }
+
+    const std::size_t rightEnd = rightSegments.size();
+
+    if (packet.size() > leftBegin) {
+      queryVisibilityRecursive(segments, radius, leftBegin, packet.size(),
+                               packet, rightSegments, visible, treeNode.left);
+    }
+
+    packet.resize(leftBegin);
+
+    if (rightEnd > rightBegin) {
+      packet.insert(packet.end(), rightSegments.begin() + rightBegin,
+                    rightSegments.begin() + rightEnd);
+      rightSegments.resize(rightBegin);
+      queryVisibilityRecursive(segments, radius, leftBegin, packet.size(),
+                               packet, rightSegments, visible, treeNode.right);
+      packet.resize(leftBegin);
+    }
+  }
+}
+
+void KdTree::removeAgent(std::size_t agentNo) {
+  /* The tree holds agents numbered from zero to agentTreePositions_.size() -
+   * 1, less any added since it was last built. */
+  if (agentNo >= agentTreePositions_.size()) {
+    return;
+  }
+
+  const std::size_t lastNo = simulator_->agents_.size() - 1U;
+
+  if (lastNo >= agentTreePositions_.size()) {
+    /* The last agent is not yet in the tree and takes over the entry of the
+     * removed agent when the tree is rebuilt for the added agents. */
+    agentTreeRebuild_ = true;
+    return;
+  }
+
+  /* Leave a hole in the entry of the removed agent, so that the topology of
+   * the tree is kept for refitting. The bounds of its leaf still contain the
+   * rest of the leaf and are tightened when next refitted. */
+  const std::size_t position = agentTreePositions_[agentNo];
+  agents_[position] = RVO_ERROR;
+  agentPositionsX_[position] = agentPositionsY_[position] =
+      std::numeric_limits<float>::infinity();
+
+  if (agentNo != lastNo) {
+    /* Renumber the entry of the last agent, which keeps its position. */
+    agents_[agentTreePositions_[lastNo]] = agentNo;
+    agentTreePositions_[agentNo] = agentTreePositions_[lastNo];
+  }
+
+  agentTreePositions_.pop_back();
+
+  if (agents_.size() > 2U * agentTreePositions_.size()) {
+    /* Mostly holes. */
+    agentTreeRebuild_ = true;
+  }
+}
+
+void KdTree::renumberAgents() {
+  std::size_t agentNo = 0U;
+
+  for (std::size_t i = 0U; i < agents_.size(); ++i) {
+    if (agents_[i] != RVO_ERROR) {
+      agents_[i] = agentNo;
+      agentTreePositions_[agentNo++] = i;
+    }
+  }
+}
+
+void KdTree::reserveAgents(std::size_t numAgents) {
+  if (numAgents > 0U) {
+    agents_.reserve(numAgents);
+    agentTreePositions_.reserve(numAgents);
+    agentPositionsX_.reserve(numAgents);
+    agentPositionsY_.reserve(numAgents);
+    agentTree_.reserve(2U * numAgents - 1U);
+  }
+}
+
+void KdTree::refitAgentTreeRecursive(std::size_t node) {
+  AgentTreeNode &treeNode = agentTree_[node];
+
+  if (treeNode.end - treeNode.begin <= RVO_MAX_LEAF_SIZE) {
+    const std::vector<Vector2> &positions = simulator_->agentPositions_;
+
+    /* Empty when every entry of the leaf is a hole. */
+    treeNode.minX = treeNode.minY = std::numeric_limits<float>::infinity();
+    treeNode.maxX = treeNode.maxY = -std::numeric_limits<float>::infinity();
+
+    for (std::size_t i = treeNode.begin; i < treeNode.end; ++i) {
+      if (agents_[i] != RVO_ERROR) {
+        treeNode.maxX = std::max(treeNode.maxX, positions[agents_[i]].x());
+        treeNode.minX = std::min(treeNode.minX, positions[agents_[i]].x());
+        treeNode.maxY = std::max(treeNode.maxY, positions[agents_[i]].y());
+        treeNode.minY = std::min(treeNode.minY, positions[agents_[i]].y());
+      }
+    }
+
+    return;
+  }
+
+  refitAgentTreeRecursive(treeNode.left);
+  refitAgentTreeRecursive(treeNode.right);
+
+  const AgentTreeNode &leftNode = agentTree_[treeNode.left];
+  const AgentTreeNode &rightNode = agentTree_[treeNode.right];
+
+  treeNode.maxX = std::max(leftNode.maxX, rightNode.maxX);
+  treeNode.minX = std::min(leftNode.minX, rightNode.minX);
+  treeNode.maxY = std::max(leftNode.maxY, rightNode.maxY);
+  treeNode.minY = std::min(leftNode.minY, rightNode.minY);
+
+  if (treeNode.maxX - treeNode.minX + treeNode.maxY - treeNode.minY >
+      agentTreeRefitThreshold_ * treeNode.partitionExtent) {
+    /* Bounds have degraded too far; repartition the subtree without its
+     * holes, which are moved past the end of its range. */
+    const std::size_t begin = treeNode.begin;
+    const std::size_t end = static_cast<std::size_t>(
+        std::remove(agents_.begin() + static_cast<std::ptrdiff_t>(begin),
+                    agents_.begin() + static_cast<std::ptrdiff_t>(treeNode.end),
+                    RVO_ERROR) -
+        agents_.begin());
+
+    std::fill(agents_.begin() + static_cast<std::ptrdiff_t>(end),
+              agents_.begin() + static_cast<std::ptrdiff_t>(treeNode.end),
+              RVO_ERROR);
+
+    /* Not empty, since its bounds are. */
+    buildAgentTreeRecursive(begin, end, node);
+  }
+}
+
+std::size_t KdTree::saveObstacles(void *data, std::size_t size) const {
+  /* Dynamic obstacles, which follow the static ones, are not saved. */
+  const std::vector<Obstacle> &obstacles =
+      simulator_->obstacleWorld_->obstacles_;
+  const std::vector<ObstacleTreeNode> &obstacleTree =
+      simulator_->obstacleWorld_->obstacleTree_;
+  const std::size_t numObstacles = simulator_->numStaticObstacleVertices_;
+  const std::size_t dataSize =
+      RVO_OBSTACLE_DATA_HEADER_SIZE +
+      numObstacles * RVO_OBSTACLE_DATA_VERTEX_SIZE +
+      obstacleTree.size() * RVO_OBSTACLE_DATA_NODE_SIZE;
+
+  if (data == NULL || size < dataSize) {
+    return dataSize;
+  }
+
+  unsigned char *out = static_cast<unsigned char *>(data);
+
+  std::memcpy(out, RVO_OBSTACLE_DATA_MAGIC, sizeof(RVO_OBSTACLE_DATA_MAGIC));
+  writeObstacleData(out + 8U, RVO_OBSTACLE_DATA_VERSION, 4U);
+  writeObstacleData(out + 12U, 0U, 4U);
+  writeObstacleData(out + 16U, numObstacles, 8U);
+  writeObstacleData(out + 24U, obstacleTree.size(), 8U);
+  out += RVO_OBSTACLE_DATA_HEADER_SIZE;
+
+  for (std::size_t i = 0U; i < numObstacles; ++i) {
+    const Obstacle &obstacle = obstacles[i];
+    writeObstacleData(out, obstacle.point_.x());
+    writeObstacleData(out + 4U, obstacle.point_.y());
+    writeObstacleData(out + 8U, obstacle.direction_.x());
+    writeObstacleData(out + 12U, obstacle.direction_.y());
+    writeObstacleData(out + 16U, obstacle.next_, 8U);
+    writeObstacleData(out + 24U, obstacle.previous_, 8U);
+    writeObstacleData(out + 32U, obstacle.isConvex_ ? 1U : 0U, 4U);
+    writeObstacleData(out + 36U, 0U, 4U);
+    out += RVO_OBSTACLE_DATA_VERTEX_SIZE;
+  }
+
+  for (std::size_t i = 0U; i < obstacleTree.size(); ++i) {
+    const ObstacleTreeNode &node = obstacleTree[i];
+    writeObstacleData(out, node.point1.x());
+    writeObstacleData(out + 4U, node.point1.y());
+    writeObstacleData(out + 8U, node.point2.x());
+    writeObstacleData(out + 12U, node.point2.y());
+    writeObstacleData(out + 16U, node.obstacle, 8U);
+    writeObstacleData(
+        out + 24U,
+        node.left == RVO_NULL_OBSTACLE_TREE_NODE ? 0U : node.left, 8U);
+    writeObstacleData(
+        out + 32U,
+        node.right == RVO_NULL_OBSTACLE_TREE_NODE ? 0U : node.right, 8U);
+    out += RVO_OBSTACLE_DATA_NODE_SIZE;
+  }
+
+  return dataSize;
+}
 } /* namespace RVO */
@@ -40,21 +40,22 @@
  */
 
 #include <cstddef>
+#include <utility>
 #include <vector>
 
 namespace RVO {
 class Agent;
-class Obstacle;
 class RVOSimulator;
 class Vector2;
 
 /**
- * @brief Defines k-D trees for agents and static obstacles in the simulation.
+ * @brief Defines k-D trees for agents and static obstacles in the simulation,
+ *        and a bounding volume hierarchy for dynamic obstacles.
  */
 class KdTree {
  private:
   class AgentTreeNode;
-  class ObstacleTreeNode;
+  class DynamicObstacleTreeNode;
 
   /**
    * @brief     Constructs a k-D tree instance.
@@ -73,7 +74,10 @@ class KdTree {
   void buildAgentTree();
 
   /**
-   * @brief     Recursive function to build an agent k-D tree.
+   * @brief     Recursive function to build an agent k-D tree. With OpenMP,
+   *            the bounds of large nodes are reduced in parallel and large
+   *            subtrees are built as separate tasks, unless the simulation
+   *            builds its agent k-D tree serially.
    * @param[in] begin The beginning agent k-D tree node.
    * @param[in] end   The ending agent k-D tree node.
    * @param[in] node  The current agent k-D tree node.
@@ -81,18 +85,39 @@ class KdTree {
   void buildAgentTreeRecursive(std::size_t begin, std::size_t end,
                                std::size_t node);
 
+  /**
+   * @brief     Builds a bounding volume hierarchy of the dynamic obstacles.
+   * @param[in] obstacleNo The number of the first obstacle vertex of the
+   *                       dynamic obstacles, which follow one another up to
+   *                       the last obstacle vertex.
+   */
+  void buildDynamicObstacleTree(std::size_t obstacleNo);
+
+  /**
+   * @brief     Recursive function to build a bounding volume hierarchy of the
+   *            dynamic obstacles.
+   * @param[in] begin The beginning dynamic obstacle.
+   * @param[in] end   The ending dynamic obstacle.
+   * @param[in] node  The current dynamic obstacle tree node.
+   */
+  void buildDynamicObstacleTreeRecursive(std::size_t begin, std::size_t end,
+                                         std::size_t node);
+
   /**
    * @brief Builds an obstacle k-D tree.
    */
   void buildObstacleTree();
 
   /**
-   * @brief     Recursive function to build an obstacle k-D tree.
-   * @param[in] obstacles List of obstacles from which to build the obstacle k-D
-   *                      tree.
+   * @brief     Recursive function to build an obstacle k-D tree. Appends the
+   *            nodes in depth-first order.
+   * @param[in] obstacles List of the numbers of the obstacles from which to
+   *                      build the obstacle k-D tree.
+   * @return    The number of the root node of the obstacle k-D tree, or
+   *            RVO_NULL_OBSTACLE_TREE_NODE when there are no obstacles.
    */
-  ObstacleTreeNode *buildObstacleTreeRecursive(
-      const std::vector<Obstacle *> &obstacles);
+  std::size_t buildObstacleTreeRecursive(
+      const std::vector<std::size_t> &obstacles);
 
   /**
    * @brief     Computes the agent neighbors of the specified agent.
@@ -112,10 +137,34 @@ class KdTree {
   void computeObstacleNeighbors(Agent *agent, float rangeSq) const;
 
   /**
-   * @brief     Deletes the specified obstacle tree node.
-   * @param[in] node A pointer to the obstacle tree node to be deleted.
+   * @brief          Counts the obstacles on either side of the splitting line
+   *                 of a candidate obstacle, stopping early once the candidate
+   *                 cannot improve on the best split so far.
+   * @param[in]      obstacles List of the numbers of the obstacles of the
+   *                           node.
+   * @param[in]      i         The index in the list of the candidate.
+   * @param[in, out] minLeft   The number of obstacles left of the best split
+   *                           so far. Replaced if the candidate is better.
+   * @param[in, out] minRight  The number of obstacles right of the best split
+   *                           so far. Replaced if the candidate is better.
+   * @return         True if the candidate is a better split than the best
+   *                 split so far; false otherwise.
    */
-  void deleteObstacleTree(ObstacleTreeNode *node);
+  bool countObstacleSplit(
+      const std::vector<std::size_t> &obstacles, std::size_t i,
+      std::size_t &minLeft, /* NOLINT(runtime/references) */
+      std::size_t &minRight) const; /* NOLINT(runtime/references) */
+
+  /**
+   * @brief     Replaces the obstacles and the obstacle k-D tree with those
+   *            saved by saveObstacles().
+   * @param[in] data A pointer to the saved data.
+   * @param[in] size The size in bytes of the saved data.
+   * @return    True if the data was restored; false if it is not valid saved
+   *            data of the present version, in which case the obstacles and
+   *            the obstacle k-D tree are unchanged.
+   */
+  bool loadObstacles(const void *data, std::size_t size);
 
   /**
    * @brief         Recursive function to compute the neighbors of the specified
@@ -129,16 +178,44 @@ class KdTree {
                                float &rangeSq, /* NOLINT(runtime/references) */
                                std::size_t node) const;
 
+  /**
+   * @brief     Recursive function to compute the dynamic obstacle neighbors of
+   *            the specified agent.
+   * @param[in] agent   A pointer to the agent for which neighbors are to be
+   *                    computed.
+   * @param[in] rangeSq The squared range around the agent.
+   * @param[in] node    The current dynamic obstacle tree node.
+   */
+  void queryDynamicObstacleTreeRecursive(Agent *agent, float rangeSq,
+                                         std::size_t node) const;
+
+  /**
+   * @brief     Recursive function to query the visibility between two points
+   *            within a specified radius with respect to the dynamic
+   *            obstacles.
+   * @param[in] vector1 The first point between which visibility is to be
+   *                    tested.
+   * @param[in] vector2 The second point between which visibility is to be
+   *                    tested.
+   * @param[in] radius  The radius within which visibility is to be tested.
+   * @param[in] node    The current dynamic obstacle tree node.
+   * @return    True if no edge of a dynamic obstacle is within the radius of
+   *            the segment between the points; false otherwise.
+   */
+  bool queryDynamicVisibilityRecursive(const Vector2 &vector1,
+                                       const Vector2 &vector2, float radius,
+                                       std::size_t node) const;
+
   /**
    * @brief         Recursive function to compute the neighbors of the specified
    *                obstacle.
    * @param[in]     agent   A pointer to the agent for which neighbors are to be
    *                        computed.
    * @param[in,out] rangeSq The squared range around the agent.
-   * @param[in]     node    The current obstacle k-D tree node.
+   * @param[in]     node    The number of the current obstacle k-D tree node.
    */
   void queryObstacleTreeRecursive(Agent *agent, float rangeSq,
-                                  const ObstacleTreeNode *node) const;
+                                  std::size_t node) const;
 
   /**
    * @brief     Queries the visibility between two points within a specified
@@ -154,6 +231,23 @@ class KdTree {
   bool queryVisibility(const Vector2 &vector1, const Vector2 &vector2,
                        float radius) const;
 
+  /**
+   * @brief      Queries the visibility between the endpoints of each of the
+   *             specified segments within a specified radius. With OpenMP,
+   *             packets of segments are queried in parallel.
+   * @param[in]  segments    An array of the pairs of points between which
+   *                         visibility is to be tested.
+   * @param[in]  numSegments The number of segments.
+   * @param[in]  radius      The radius within which visibility is to be
+   *                         tested.
+   * @param[out] visible     An array of at least numSegments elements that
+   *                         receives whether the endpoints of each segment
+   *                         are mutually visible within the radius.
+   */
+  void queryVisibility(const std::pair<Vector2, Vector2> *segments,
+                       std::size_t numSegments, float radius,
+                       bool *visible) const;
+
   /**
    * @brief     Recursive function to query the visibility between two points
    *            within a specified radius.
@@ -162,13 +256,87 @@ class KdTree {
    * @param[in] vector2 The second point between which visibility is to be
    *                    tested.
    * @param[in] radius  The radius within which visibility is to be tested.
-   * @param[in] node    The current obstacle k-D tree node.
+   * @param[in] node    The number of the current obstacle k-D tree node.
    * @return    True if q1 and q2 are mutually visible within the radius; false
    *            otherwise.
    */
   bool queryVisibilityRecursive(const Vector2 &vector1, const Vector2 &vector2,
-                                float radius,
-                                const ObstacleTreeNode *node) const;
+                                float radius, std::size_t node) const;
+
+  /**
+   * @brief          Recursive function to query the visibility between the
+   *                 endpoints of a packet of segments within a specified
+   *                 radius, visiting each node once for all of them.
+   * @param[in]      segments      An array of the pairs of points between
+   *                               which visibility is to be tested.
+   * @param[in]      radius        The radius within which visibility is to
+   *                               be tested.
+   * @param[in]      begin         The beginning of the packet in the list of
+   *                               segment numbers.
+   * @param[in]      end           The ending of the packet in the list of
+   *                               segment numbers.
+   * @param[in, out] packet        The list of segment numbers. Scratch space
+   *                               past the ending of the packet is restored
+   *                               on return.
+   * @param[in, out] rightSegments Scratch space for the numbers of the
+   *                               segments that are to search right
+   *                               subtrees, restored on return.
+   * @param[in, out] visible       The visibility of each segment, set to
+   *                               false when a segment is found to be
+   *                               blocked.
+   * @param[in]      node          The number of the current obstacle k-D
+   *                               tree node.
+   */
+  void queryVisibilityRecursive(
+      const std::pair<Vector2, Vector2> *segments, float radius,
+      std::size_t begin, std::size_t end,
+      std::vector<std::size_t> &packet,        /* NOLINT(runtime/references) */
+      std::vector<std::size_t> &rightSegments, /* NOLINT(runtime/references) */
+      bool *visible, std::size_t node) const;
+
+  /**
+   * @brief     Recursive function to refit an agent k-D tree. Keeps the
+   *            topology of the tree, recomputes the bounds of each node
+   *            bottom-up, and rebuilds any subtree whose bounds have grown past
+   *            the refit threshold since it was last partitioned.
+   * @param[in] node The current agent k-D tree node.
+   */
+  void refitAgentTreeRecursive(std::size_t node);
+
+  /**
+   * @brief     Removes an agent from the agent k-D tree in constant time, to
+   *            be called before the simulator moves the last agent into the
+   *            number of the removed agent. Leaves a hole in the entry of the
+   *            removed agent, so that the agent k-D tree may still be refitted
+   *            when next built.
+   * @param[in] agentNo The number of the agent to be removed.
+   */
+  void removeAgent(std::size_t agentNo);
+
+  /**
+   * @brief Renumbers the agents of the agent k-D tree in tree order, to be
+   *        called once the simulator has renumbered its agents in the same
+   *        order. Keeps the topology and bounds of the tree.
+   */
+  void renumberAgents();
+
+  /**
+   * @brief     Reserves capacity for a total number of agents in the agent
+   *            k-D tree.
+   * @param[in] numAgents The total number of agents.
+   */
+  void reserveAgents(std::size_t numAgents);
+
+  /**
+   * @brief     Saves the obstacles, including those split when building the
+   *            obstacle k-D tree, and the obstacle k-D tree.
+   * @param[in] data A pointer to a buffer that receives the saved data, or
+   *                 NULL.
+   * @param[in] size The size in bytes of the buffer.
+   * @return    The size in bytes of the saved data. Nothing is written unless
+   *            the buffer is at least that large.
+   */
+  std::size_t saveObstacles(void *data, std::size_t size) const;
 
   /* Not implemented. */
   KdTree(const KdTree &other);
@@ -176,10 +344,18 @@ class KdTree {
   /* Not implemented. */
   KdTree &operator=(const KdTree &other);
 
-  std::vector<Agent *> agents_;
+  std::vector<std::size_t> agents_;
+  std::vector<std::size_t> agentTreePositions_;
+  std::vector<float> agentPositionsX_;
+  std::vector<float> agentPositionsY_;
   std::vector<AgentTreeNode> agentTree_;
-  ObstacleTreeNode *obstacleTree_;
+  std::vector<std::size_t> dynamicObstacles_;
+  std::vector<DynamicObstacleTreeNode> dynamicObstacleTree_;
   RVOSimulator *simulator_;
+  std::size_t obstacleTreeSplitCandidates_;
+  float agentTreeRefitThreshold_;
+  bool agentTreeRebuild_;
+  bool agentTreeRefit_;
 
   friend class Agent;
   friend class RVOSimulator;
@@ -36,7 +36,7 @@
 
 /**
  * @file  Obstacle.h
- * @brief Declares the Obstacle class.
+ * @brief Declares the Obstacle and ObstacleTreeNode classes.
  */
 
 #include <cstddef>
@@ -45,10 +45,12 @@
 
 namespace RVO {
 /**
- * @brief Defines static obstacles in the simulation.
+ * @brief Defines a static obstacle vertex in the simulation. Stored by value
+ *        in a contiguous array of the simulator, and linked to the next and
+ *        previous vertices of its polygon by their numbers in that array.
  */
 class Obstacle {
- private:
+ public:
   /**
    * @brief Constructs a static obstacle instance.
    */
@@ -59,23 +61,55 @@ class Obstacle {
    */
   ~Obstacle();
 
-  /* Not implemented. */
-  Obstacle(const Obstacle &other);
-
-  /* Not implemented. */
-  Obstacle &operator=(const Obstacle &other);
-
+ private:
   Vector2 direction_;
   Vector2 point_;
-  Obstacle *next_;
-  Obstacle *previous_;
-  std::size_t id_;
+  std::size_t next_;
+  std::size_t previous_;
   bool isConvex_;
 
   friend class Agent;
   friend class KdTree;
+  friend class ObstacleWorld;
   friend class RVOSimulator;
 };
+
+/**
+ * @brief Defines an obstacle k-D tree node. Holds a copy of the endpoints of
+ *        its obstacle so that traversals only touch the array of nodes.
+ */
+class ObstacleTreeNode {
+ public:
+  /**
+   * @brief Constructs an obstacle k-D tree node instance.
+   */
+  ObstacleTreeNode();
+
+  /**
+   * @brief The first endpoint of the obstacle.
+   */
+  Vector2 point1;
+
+  /**
+   * @brief The second endpoint of the obstacle.
+   */
+  Vector2 point2;
+
+  /**
+   * @brief The obstacle number.
+   */
+  std::size_t obstacle;
+
+  /**
+   * @brief The left node number, or RVO_NULL_OBSTACLE_TREE_NODE.
+   */
+  std::size_t left;
+
+  /**
+   * @brief The right node number, or RVO_NULL_OBSTACLE_TREE_NODE.
+   */
+  std::size_t right;
+};
 } /* namespace RVO */
 
 #endif /* RVO_OBSTACLE_H_ */
@@ -0,0 +1,93 @@
+/*
+ * ObstacleWorld.cc
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+/**
+ * @file  ObstacleWorld.cc
+ * @brief Defines the ObstacleWorld class.
+ */
+
+#include "ObstacleWorld.h"
+
+#include <mutex> /* NOLINT(build/c++11) */
+
+#include "Obstacle.h"
+
+namespace RVO {
+namespace {
+/**
+ * @relates ObstacleWorld
+ * @brief   Guards the reference counts of all obstacle worlds, which change
+ *          only when simulations are created, destroyed, or switch worlds.
+ */
+std::mutex &getReferenceMutex() {
+  static std::mutex referenceMutex;
+  return referenceMutex;
+}
+} /* namespace */
+
+ObstacleWorld::ObstacleWorld() : numReferences_(1U) {}
+
+ObstacleWorld::ObstacleWorld(const ObstacleWorld &other)
+    : obstacles_(other.obstacles_),
+      obstacleTree_(other.obstacleTree_),
+      numReferences_(1U) {}
+
+ObstacleWorld::~ObstacleWorld() {}
+
+void ObstacleWorld::addReference() {
+  const std::lock_guard<std::mutex> lock(getReferenceMutex());
+  ++numReferences_;
+}
+
+std::size_t ObstacleWorld::getNumObstacleVertices() const {
+  return obstacles_.size();
+}
+
+bool ObstacleWorld::isShared() const {
+  const std::lock_guard<std::mutex> lock(getReferenceMutex());
+  return numReferences_ > 1U;
+}
+
+void ObstacleWorld::release() {
+  bool released = false;
+
+  {
+    const std::lock_guard<std::mutex> lock(getReferenceMutex());
+    released = --numReferences_ == 0U;
+  }
+
+  if (released) {
+    delete this;
+  }
+}
+} /* namespace RVO */
@@ -0,0 +1,115 @@
+/*
+ * ObstacleWorld.h
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+#ifndef RVO_OBSTACLE_WORLD_H_
+#define RVO_OBSTACLE_WORLD_H_
+
+/**
+ * @file  ObstacleWorld.h
+ * @brief Declares the ObstacleWorld class.
+ */
+
+#include <cstddef>
+#include <vector>
+
+#include "Export.h"
+
+namespace RVO {
+class Obstacle;
+class ObstacleTreeNode;
+
+/**
+ * @brief Defines a set of static obstacles, the obstacle vertices and the
+ *        obstacle k-D tree, shared by one or more simulations. A shared set
+ *        is never modified: a simulation copies it before changing its own
+ *        obstacles. Released by the last of its references.
+ */
+class RVO_EXPORT ObstacleWorld {
+ public:
+  /**
+   * @brief Adds a reference to this obstacle world, to be released by
+   *        release().
+   */
+  void addReference();
+
+  /**
+   * @brief  Returns the count of obstacle vertices in this obstacle world.
+   * @return The count of obstacle vertices.
+   */
+  std::size_t getNumObstacleVertices() const;
+
+  /**
+   * @brief Releases a reference to this obstacle world, destroying it if no
+   *        reference remains.
+   */
+  void release();
+
+ private:
+  /**
+   * @brief Constructs an obstacle world instance without obstacles, with a
+   *        single reference.
+   */
+  ObstacleWorld();
+
+  /**
+   * @brief     Constructs an obstacle world instance with a copy of the
+   *            obstacles of another, with a single reference.
+   * @param[in] other The obstacle world to be copied.
+   */
+  ObstacleWorld(const ObstacleWorld &other);
+
+  /**
+   * @brief Destroys this obstacle world instance.
+   */
+  ~ObstacleWorld();
+
+  /**
+   * @brief  Returns whether this obstacle world has more than one reference.
+   * @return True if this obstacle world is shared.
+   */
+  bool isShared() const;
+
+  /* Not implemented. */
+  ObstacleWorld &operator=(const ObstacleWorld &other);
+
+  std::vector<Obstacle> obstacles_;
+  std::vector<ObstacleTreeNode> obstacleTree_;
+  std::size_t numReferences_;
+
+  friend class Agent;
+  friend class KdTree;
+  friend class RVOSimulator;
+};
+} /* namespace RVO */
+
+#endif /* RVO_OBSTACLE_WORLD_H_ */
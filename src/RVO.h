@@ -46,9 +46,16 @@
  */
 
 /* IWYU pragma: begin_exports */
+#include "Executor.h"
 #include "Export.h"
 #include "Line.h"
+#include "ObstacleWorld.h"
 #include "RVOSimulator.h"
+#include "RegionSimulator.h"
+#include "StepProfile.h"
+#include "TrajectoryReader.h"
+#include "TrajectoryRecorder.h"
+#include "Transport.h"
 #include "Vector2.h"
 /* IWYU pragma: end_exports */
 
@@ -38,13 +38,26 @@
 
 #include "RVOSimulator.h"
 
+#include <algorithm>
+#include <cstring>
+#include <iterator>
 #include <limits>
+#include <new>
 #include <utility>
 
+#ifdef RVO_ENABLE_PROFILING
+#include <chrono> /* NOLINT(build/c++11) */
+#endif /* RVO_ENABLE_PROFILING */
+
 #include "Agent.h"
+#include "AgentGrid.h"
+#include "AgentProfile.h"
 #include "KdTree.h"
 #include "Line.h"
 #include "Obstacle.h"
+#include "StepThread.h"
+#include "ThreadPool.h"
+#include "TrajectoryRecorder.h"
 #include "Vector2.h"
 
 #ifdef _OPENMP
@@ -54,77 +67,416 @@
 namespace RVO {
 const std::size_t RVO_ERROR = std::numeric_limits<std::size_t>::max();
 
+namespace {
+/**
+ * @relates RVOSimulator
+ * @brief   The minimum number of agents for which storage is allocated at once
+ *          when agents are added individually.
+ */
+const std::size_t RVO_MIN_AGENT_STORAGE_SIZE = 16U;
+
+/**
+ * @relates RVOSimulator
+ * @brief   The number of agents in each range of a parallel loop of the
+ *          simulation handed out by an executor.
+ */
+const std::size_t RVO_PARALLEL_CHUNK_SIZE = 64U;
+
+/**
+ * @relates RVOSimulator
+ * @brief   The magic number at the start of a snapshot of the agent state.
+ */
+const char RVO_SNAPSHOT_MAGIC[8] = {'R', 'V', 'O', '2', 'S', 'N', 'A', 'P'};
+
+/**
+ * @relates RVOSimulator
+ * @brief   The version of the snapshot format.
+ */
+const std::size_t RVO_SNAPSHOT_VERSION = 1U;
+
+/**
+ * @relates RVOSimulator
+ * @brief   The flag of an agent in a snapshot if it is asleep.
+ */
+const unsigned char RVO_SNAPSHOT_SLEEPING = 1U;
+
+/**
+ * @relates RVOSimulator
+ * @brief   The flag of an agent in a snapshot if it was stationary in the most
+ *          recent simulation step.
+ */
+const unsigned char RVO_SNAPSHOT_STATIONARY = 2U;
+
+/**
+ * @relates RVOSimulator
+ * @brief   The header of a snapshot of the agent state. A full snapshot
+ *          follows it with the handles, positions, velocities, preferred
+ *          velocities, and flags of the agents, one array each in agent
+ *          order. A delta snapshot follows it with the handles of the agents
+ *          if they were renumbered since its base, and then its records.
+ */
+struct SnapshotHeader {
+  /**
+   * @brief The magic number.
+   */
+  char magic[8];
+
+  /**
+   * @brief The version of the snapshot format.
+   */
+  std::size_t version;
+
+  /**
+   * @brief The number of agents in the simulation.
+   */
+  std::size_t numAgents;
+
+  /**
+   * @brief The number of handles of a delta snapshot, either zero or the
+   *        number of agents.
+   */
+  std::size_t numHandles;
+
+  /**
+   * @brief The number of records of a delta snapshot, or RVO_ERROR for a full
+   *        snapshot.
+   */
+  std::size_t numRecords;
+
+  /**
+   * @brief The number of simulation steps since the agents were last sorted.
+   */
+  std::size_t agentSortSteps;
+
+  /**
+   * @brief The global time of the simulation.
+   */
+  float globalTime;
+};
+
+/**
+ * @relates RVOSimulator
+ * @brief   The record of an agent that changed since the base of a delta
+ *          snapshot.
+ */
+struct SnapshotRecord {
+  /**
+   * @brief The handle of the agent.
+   */
+  std::size_t handle;
+
+  /**
+   * @brief The position of the agent.
+   */
+  Vector2 position;
+
+  /**
+   * @brief The velocity of the agent.
+   */
+  Vector2 velocity;
+
+  /**
+   * @brief The preferred velocity of the agent.
+   */
+  Vector2 prefVelocity;
+
+  /**
+   * @brief The flags of the agent.
+   */
+  unsigned char flags;
+};
+
+/**
+ * @relates RVOSimulator
+ * @brief   The size in bytes of each agent in a full snapshot.
+ */
+const std::size_t RVO_SNAPSHOT_AGENT_SIZE =
+    sizeof(std::size_t) + 3U * sizeof(Vector2) + 1U;
+
+/**
+ * @relates   RVOSimulator
+ * @brief     Returns the flags of an agent in a snapshot.
+ * @param[in] sleeping   True if the agent is asleep.
+ * @param[in] stationary True if the agent was stationary in the most recent
+ *                       simulation step.
+ * @return    The flags of the agent.
+ */
+unsigned char getSnapshotFlags(bool sleeping, bool stationary) {
+  return static_cast<unsigned char>(
+      (sleeping ? RVO_SNAPSHOT_SLEEPING : 0U) |
+      (stationary ? RVO_SNAPSHOT_STATIONARY : 0U));
+}
+
+/**
+ * @relates   RVOSimulator
+ * @brief     Tests whether an agent profile has the specified parameters.
+ * @param[in] profile         The agent profile.
+ * @param[in] neighborDist    The maximum neighbor distance.
+ * @param[in] maxNeighbors    The maximum number of agent neighbors.
+ * @param[in] timeHorizon     The time horizon.
+ * @param[in] timeHorizonObst The time horizon with respect to obstacles.
+ * @param[in] radius          The radius.
+ * @param[in] maxSpeed        The maximum speed.
+ * @return    True if every parameter of the agent profile is equal.
+ */
+bool hasAgentParameters(const AgentProfile &profile, float neighborDist,
+                        std::size_t maxNeighbors, float timeHorizon,
+                        float timeHorizonObst, float radius, float maxSpeed) {
+  return profile.neighborDist == neighborDist &&
+         profile.maxNeighbors == maxNeighbors &&
+         profile.timeHorizon == timeHorizon &&
+         profile.timeHorizonObst == timeHorizonObst &&
+         profile.radius == radius && profile.maxSpeed == maxSpeed;
+}
+
+/**
+ * @relates    RVOSimulator
+ * @brief      Reads and checks the header of a snapshot.
+ * @param[in]  data   A pointer to the snapshot.
+ * @param[in]  size   The size in bytes of the snapshot.
+ * @param[out] header The header of the snapshot.
+ * @return     True if the snapshot is of the present version and large
+ *             enough to hold the agents and records listed in its header.
+ */
+bool readSnapshotHeader(
+    const void *data, std::size_t size,
+    SnapshotHeader &header) { /* NOLINT(runtime/references) */
+  if (data == NULL || size < sizeof(SnapshotHeader)) {
+    return false;
+  }
+
+  std::memcpy(&header, data, sizeof(SnapshotHeader));
+
+  if (std::memcmp(header.magic, RVO_SNAPSHOT_MAGIC,
+                  sizeof(RVO_SNAPSHOT_MAGIC)) != 0 ||
+      header.version != RVO_SNAPSHOT_VERSION) {
+    return false;
+  }
+
+  const std::size_t dataSize = size - sizeof(SnapshotHeader);
+
+  if (header.numRecords == RVO_ERROR) {
+    return header.numAgents <= dataSize / RVO_SNAPSHOT_AGENT_SIZE;
+  }
+
+  return (header.numHandles == 0U || header.numHandles == header.numAgents) &&
+         header.numHandles <= dataSize / sizeof(std::size_t) &&
+         header.numRecords <=
+             (dataSize - header.numHandles * sizeof(std::size_t)) /
+                 sizeof(SnapshotRecord);
+}
+
+/**
+ * @relates RVOSimulator
+ * @brief   The simulations of stepAll() and the task of its present parallel
+ *          loop.
+ */
+struct StepAllData {
+  /**
+   * @brief The simulations.
+   */
+  RVOSimulator *const *simulators;
+
+  /**
+   * @brief The number of the first agent of each simulation, and the total
+   *        number of agents, when agents are numbered in order of the
+   *        simulations.
+   */
+  std::vector<std::size_t> agentOffsets;
+
+  /**
+   * @brief The task to be called on the agents of each simulation.
+   */
+  Executor::Task task;
+};
+
+/**
+ * @relates RVOSimulator
+ * @brief   Returns the number of threads that may run a parallel loop on an
+ *          executor, or with OpenMP or serially when there is none.
+ * @param[in] executor The executor, or NULL.
+ * @return  The number of threads.
+ */
+std::size_t getExecutorNumThreads(const Executor *executor) {
+  if (executor != NULL) {
+    return executor->getNumThreads();
+  }
+
+#ifdef _OPENMP
+  return static_cast<std::size_t>(omp_get_max_threads());
+#else
+  return 1U;
+#endif /* _OPENMP */
+}
+
+/**
+ * @relates RVOSimulator
+ * @brief   Reorders an array of agent values.
+ * @param[in, out] values The values, listed by the present numbers of the
+ *                        agents.
+ * @param[in]      order  The present numbers of the agents, listed by their
+ *                        new numbers.
+ */
+template <typename T>
+void reorderAgentValues(
+    std::vector<T> &values, /* NOLINT(runtime/references) */
+    const std::vector<std::size_t> &order) {
+  std::vector<T> reorderedValues(order.size());
+
+  for (std::size_t i = 0U; i < order.size(); ++i) {
+    reorderedValues[i] = values[order[i]];
+  }
+
+  values.swap(reorderedValues);
+}
+
+#ifdef RVO_ENABLE_PROFILING
+/**
+ * @relates RVOSimulator
+ * @brief   Returns the present wall time for profiling simulation steps.
+ * @return  The present wall time in seconds since an arbitrary epoch.
+ */
+double getWallTime() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+#endif /* RVO_ENABLE_PROFILING */
+} /* namespace */
+
 RVOSimulator::RVOSimulator()
-    : defaultAgent_(NULL),
+    : stepProfileCallback_(NULL),
+      stepProfileUserData_(NULL),
+      numStaticObstacleVertices_(0U),
+      agentSortInterval_(0U),
+      agentSortSteps_(0U),
+      defaultAgentProfileNo_(RVO_ERROR),
+      lastAgentProfileNo_(RVO_ERROR),
+      executor_(NULL),
+      stepThread_(NULL),
+      threadPool_(NULL),
+      trajectoryRecorder_(NULL),
+      agentGrid_(new AgentGrid(this)),
       kdTree_(new KdTree(this)),
+      obstacleWorld_(new ObstacleWorld()),
+      agentNeighborSkin_(0.0F),
+      agentSleepThreshold_(0.0F),
+      frontGlobalTime_(0.0F),
       globalTime_(0.0F),
-      timeStep_(0.0F) {}
+      timeStep_(0.0F),
+      agentNeighborSearch_(RVO_AGENT_KD_TREE),
+      agentCandidatesStale_(false),
+      agentNeighborHeap_(false),
+      agentProfilesChanged_(false),
+      agentTreeSerial_(false),
+      deterministic_(false),
+      dynamicObstaclesChanged_(false),
+      stepPending_(false),
+      subStepping_(false) {}
 
 RVOSimulator::RVOSimulator(float timeStep, float neighborDist,
                            std::size_t maxNeighbors, float timeHorizon,
                            float timeHorizonObst, float radius, float maxSpeed)
-    : defaultAgent_(new Agent()),
+    : stepProfileCallback_(NULL),
+      stepProfileUserData_(NULL),
+      numStaticObstacleVertices_(0U),
+      agentSortInterval_(0U),
+      agentSortSteps_(0U),
+      defaultAgentProfileNo_(RVO_ERROR),
+      lastAgentProfileNo_(RVO_ERROR),
+      executor_(NULL),
+      stepThread_(NULL),
+      threadPool_(NULL),
+      trajectoryRecorder_(NULL),
+      agentGrid_(new AgentGrid(this)),
       kdTree_(new KdTree(this)),
+      obstacleWorld_(new ObstacleWorld()),
+      agentNeighborSkin_(0.0F),
+      agentSleepThreshold_(0.0F),
+      frontGlobalTime_(0.0F),
       globalTime_(0.0F),
-      timeStep_(timeStep) {
-  defaultAgent_->maxNeighbors_ = maxNeighbors;
-  defaultAgent_->maxSpeed_ = maxSpeed;
-  defaultAgent_->neighborDist_ = neighborDist;
-  defaultAgent_->radius_ = radius;
-  defaultAgent_->timeHorizon_ = timeHorizon;
-  defaultAgent_->timeHorizonObst_ = timeHorizonObst;
+      timeStep_(timeStep),
+      agentNeighborSearch_(RVO_AGENT_KD_TREE),
+      agentCandidatesStale_(false),
+      agentNeighborHeap_(false),
+      agentProfilesChanged_(false),
+      agentTreeSerial_(false),
+      deterministic_(false),
+      dynamicObstaclesChanged_(false),
+      stepPending_(false),
+      subStepping_(false) {
+  setAgentDefaults(neighborDist, maxNeighbors, timeHorizon, timeHorizonObst,
+                   radius, maxSpeed);
 }
 
 RVOSimulator::RVOSimulator(float timeStep, float neighborDist,
                            std::size_t maxNeighbors, float timeHorizon,
                            float timeHorizonObst, float radius, float maxSpeed,
                            const Vector2 &velocity)
-    : defaultAgent_(new Agent()),
+    : stepProfileCallback_(NULL),
+      stepProfileUserData_(NULL),
+      numStaticObstacleVertices_(0U),
+      agentSortInterval_(0U),
+      agentSortSteps_(0U),
+      defaultAgentProfileNo_(RVO_ERROR),
+      lastAgentProfileNo_(RVO_ERROR),
+      executor_(NULL),
+      stepThread_(NULL),
+      threadPool_(NULL),
+      trajectoryRecorder_(NULL),
+      agentGrid_(new AgentGrid(this)),
       kdTree_(new KdTree(this)),
+      obstacleWorld_(new ObstacleWorld()),
+      defaultVelocity_(velocity),
+      agentNeighborSkin_(0.0F),
+      agentSleepThreshold_(0.0F),
+      frontGlobalTime_(0.0F),
       globalTime_(0.0F),
-      timeStep_(timeStep) {
-  defaultAgent_->velocity_ = velocity;
-  defaultAgent_->maxNeighbors_ = maxNeighbors;
-  defaultAgent_->maxSpeed_ = maxSpeed;
-  defaultAgent_->neighborDist_ = neighborDist;
-  defaultAgent_->radius_ = radius;
-  defaultAgent_->timeHorizon_ = timeHorizon;
-  defaultAgent_->timeHorizonObst_ = timeHorizonObst;
+      timeStep_(timeStep),
+      agentNeighborSearch_(RVO_AGENT_KD_TREE),
+      agentCandidatesStale_(false),
+      agentNeighborHeap_(false),
+      agentProfilesChanged_(false),
+      agentTreeSerial_(false),
+      deterministic_(false),
+      dynamicObstaclesChanged_(false),
+      stepPending_(false),
+      subStepping_(false) {
+  setAgentDefaults(neighborDist, maxNeighbors, timeHorizon, timeHorizonObst,
+                   radius, maxSpeed, velocity);
 }
 
 RVOSimulator::~RVOSimulator() {
-  delete defaultAgent_;
+  /* Joins the step thread only once any pending step has completed. */
+  delete stepThread_;
+  delete agentGrid_;
   delete kdTree_;
+  delete threadPool_;
+  obstacleWorld_->release();
 
   for (std::size_t i = 0U; i < agents_.size(); ++i) {
-    delete agents_[i];
+    agents_[i]->~Agent();
   }
 
-  for (std::size_t i = 0U; i < obstacles_.size(); ++i) {
-    delete obstacles_[i];
+  for (std::size_t i = 0U; i < agentStorage_.size(); ++i) {
+    ::operator delete(agentStorage_[i]);
   }
 }
 
 std::size_t RVOSimulator::addAgent(const Vector2 &position) {
-  if (defaultAgent_ != NULL) {
-    Agent *const agent = new Agent();
-    agent->position_ = position;
-    agent->velocity_ = defaultAgent_->velocity_;
-    agent->id_ = agents_.size();
-    agent->maxNeighbors_ = defaultAgent_->maxNeighbors_;
-    agent->maxSpeed_ = defaultAgent_->maxSpeed_;
-    agent->neighborDist_ = defaultAgent_->neighborDist_;
-    agent->radius_ = defaultAgent_->radius_;
-    agent->timeHorizon_ = defaultAgent_->timeHorizon_;
-    agent->timeHorizonObst_ = defaultAgent_->timeHorizonObst_;
-    agents_.push_back(agent);
-
-    return agents_.size() - 1U;
+  if (defaultAgentProfileNo_ != RVO_ERROR) {
+    return addProfileAgents(&position, 1U, defaultAgentProfileNo_,
+                            defaultVelocity_);
   }
 
   return RVO_ERROR;
 }
 
+std::size_t RVOSimulator::addAgent(const Vector2 &position,
+                                   std::size_t profileNo) {
+  return addAgents(&position, 1U, profileNo);
+}
+
 std::size_t RVOSimulator::addAgent(const Vector2 &position, float neighborDist,
                                    std::size_t maxNeighbors, float timeHorizon,
                                    float timeHorizonObst, float radius,
@@ -137,98 +489,481 @@ std::size_t RVOSimulator::addAgent(const Vector2 &position, float neighborDist,
                                    std::size_t maxNeighbors, float timeHorizon,
                                    float timeHorizonObst, float radius,
                                    float maxSpeed, const Vector2 &velocity) {
-  Agent *const agent = new Agent();
-  agent->position_ = position;
-  agent->velocity_ = velocity;
-  agent->id_ = agents_.size();
-  agent->maxNeighbors_ = maxNeighbors;
-  agent->maxSpeed_ = maxSpeed;
-  agent->neighborDist_ = neighborDist;
-  agent->radius_ = radius;
-  agent->timeHorizon_ = timeHorizon;
-  agent->timeHorizonObst_ = timeHorizonObst;
-  agents_.push_back(agent);
+  return addAgents(&position, 1U, neighborDist, maxNeighbors, timeHorizon,
+                   timeHorizonObst, radius, maxSpeed, velocity);
+}
 
-  return agents_.size() - 1U;
+std::size_t RVOSimulator::addAgents(const Vector2 *positions,
+                                    std::size_t numAgents) {
+  if (defaultAgentProfileNo_ != RVO_ERROR) {
+    return addProfileAgents(positions, numAgents, defaultAgentProfileNo_,
+                            defaultVelocity_);
+  }
+
+  return RVO_ERROR;
+}
+
+std::size_t RVOSimulator::addAgents(const Vector2 *positions,
+                                    std::size_t numAgents,
+                                    std::size_t profileNo) {
+  if (profileNo < agentProfiles_.size() &&
+      agentProfiles_[profileNo].numReferences > 0U) {
+    return addProfileAgents(positions, numAgents, profileNo, Vector2());
+  }
+
+  return RVO_ERROR;
+}
+
+std::size_t RVOSimulator::addAgents(const Vector2 *positions,
+                                    std::size_t numAgents, float neighborDist,
+                                    std::size_t maxNeighbors, float timeHorizon,
+                                    float timeHorizonObst, float radius,
+                                    float maxSpeed) {
+  return addAgents(positions, numAgents, neighborDist, maxNeighbors,
+                   timeHorizon, timeHorizonObst, radius, maxSpeed, Vector2());
+}
+
+std::size_t RVOSimulator::addAgents(const Vector2 *positions,
+                                    std::size_t numAgents, float neighborDist,
+                                    std::size_t maxNeighbors, float timeHorizon,
+                                    float timeHorizonObst, float radius,
+                                    float maxSpeed, const Vector2 &velocity) {
+  /* Shared by the agents, and by those added next with the same properties,
+   * until a property of one of them is set. */
+  if (lastAgentProfileNo_ == RVO_ERROR ||
+      !hasAgentParameters(agentProfiles_[lastAgentProfileNo_], neighborDist,
+                          maxNeighbors, timeHorizon, timeHorizonObst, radius,
+                          maxSpeed)) {
+    lastAgentProfileNo_ =
+        newAgentProfile(AgentProfile(neighborDist, maxNeighbors, timeHorizon,
+                                     timeHorizonObst, radius, maxSpeed));
+  }
+
+  return addProfileAgents(positions, numAgents, lastAgentProfileNo_, velocity);
+}
+
+void RVOSimulator::addAgentHandle(std::size_t agentNo) {
+  if (freeAgentHandles_.empty()) {
+    agentHandles_.push_back(agentNos_.size());
+    agentNos_.push_back(agentNo);
+  } else {
+    agentHandles_.push_back(freeAgentHandles_.back());
+    agentNos_[freeAgentHandles_.back()] = agentNo;
+    freeAgentHandles_.pop_back();
+  }
+}
+
+std::size_t RVOSimulator::addAgentProfile(float neighborDist,
+                                          std::size_t maxNeighbors,
+                                          float timeHorizon,
+                                          float timeHorizonObst, float radius,
+                                          float maxSpeed) {
+  const std::size_t profileNo =
+      newAgentProfile(AgentProfile(neighborDist, maxNeighbors, timeHorizon,
+                                   timeHorizonObst, radius, maxSpeed));
+
+  /* Never released, so that the number remains valid. */
+  agentProfiles_[profileNo].numReferences = 1U;
+
+  return profileNo;
+}
+
+std::size_t RVOSimulator::addProfileAgents(const Vector2 *positions,
+                                           std::size_t numAgents,
+                                           std::size_t profileNo,
+                                           const Vector2 &velocity) {
+  const AgentProfile &profile = agentProfiles_[profileNo];
+  const std::size_t agentNo = agents_.size();
+  reserveAgents(agentNo + numAgents);
+
+  agentProfiles_[profileNo].numReferences += numAgents;
+
+  for (std::size_t i = 0U; i < numAgents; ++i) {
+    Agent *const agent = newAgent();
+    agent->profileNo_ = profileNo;
+    agents_.push_back(agent);
+    addAgentHandle(agent->id_);
+  }
+
+  agentPositions_.insert(agentPositions_.end(), positions,
+                         positions + numAgents);
+  agentPrefVelocities_.resize(agentNo + numAgents);
+  agentVelocities_.resize(agentNo + numAgents, velocity);
+  agentMaxSpeeds_.resize(agentNo + numAgents, profile.maxSpeed);
+  agentRadii_.resize(agentNo + numAgents, profile.radius);
+
+  return agentNo;
+}
+
+void RVOSimulator::allocateAgents(std::size_t numAgents) {
+  char *const storage =
+      static_cast<char *>(::operator new(numAgents * sizeof(Agent)));
+  agentStorage_.push_back(storage);
+  freeAgentStorage_.reserve(freeAgentStorage_.size() + numAgents);
+
+  /* Pushed in reverse so that agents are constructed in address order. */
+  for (std::size_t i = numAgents; i-- != 0U;) {
+    freeAgentStorage_.push_back(storage + i * sizeof(Agent));
+  }
+}
+
+std::size_t RVOSimulator::addDynamicObstacle(
+    const std::vector<Vector2> &vertices) {
+  if (vertices.size() > 1U) {
+    std::size_t dynamicObstacleNo = dynamicObstacles_.size();
+
+    if (freeDynamicObstacles_.empty()) {
+      dynamicObstacles_.push_back(vertices);
+    } else {
+      dynamicObstacleNo = freeDynamicObstacles_.back();
+      freeDynamicObstacles_.pop_back();
+      dynamicObstacles_[dynamicObstacleNo] = vertices;
+    }
+
+    dynamicObstaclesChanged_ = true;
+
+    return dynamicObstacleNo;
+  }
+
+  return RVO_ERROR;
 }
 
 std::size_t RVOSimulator::addObstacle(const std::vector<Vector2> &vertices) {
   if (vertices.size() > 1U) {
-    const std::size_t obstacleNo = obstacles_.size();
+    clearDynamicObstacles();
+    detachObstacleWorld();
 
-    for (std::size_t i = 0U; i < vertices.size(); ++i) {
-      Obstacle *const obstacle = new Obstacle();
-      obstacle->point_ = vertices[i];
+    const std::size_t obstacleNo = obstacleWorld_->obstacles_.size();
+    addObstacleVertices(vertices);
+    numStaticObstacleVertices_ = obstacleWorld_->obstacles_.size();
 
-      if (i != 0U) {
-        obstacle->previous_ = obstacles_.back();
-        obstacle->previous_->next_ = obstacle;
-      }
+    return obstacleNo;
+  }
+
+  return RVO_ERROR;
+}
 
-      if (i == vertices.size() - 1U) {
-        obstacle->next_ = obstacles_[obstacleNo];
-        obstacle->next_->previous_ = obstacle;
+void RVOSimulator::addObstacleVertices(const std::vector<Vector2> &vertices) {
+  std::vector<Obstacle> &obstacles = obstacleWorld_->obstacles_;
+  const std::size_t obstacleNo = obstacles.size();
+
+  obstacles.resize(obstacleNo + vertices.size());
+
+  for (std::size_t i = 0U; i < vertices.size(); ++i) {
+    Obstacle &obstacle = obstacles[obstacleNo + i];
+    obstacle.point_ = vertices[i];
+    obstacle.previous_ =
+        obstacleNo + (i == 0U ? vertices.size() - 1U : i - 1U);
+    obstacle.next_ = obstacleNo + (i == vertices.size() - 1U ? 0U : i + 1U);
+
+    obstacle.direction_ = normalize(
+        vertices[(i == vertices.size() - 1U ? 0U : i + 1U)] - vertices[i]);
+
+    if (vertices.size() == 2U) {
+      obstacle.isConvex_ = true;
+    } else {
+      obstacle.isConvex_ =
+          leftOf(vertices[i == 0U ? vertices.size() - 1U : i - 1U],
+                 vertices[i],
+                 vertices[i == vertices.size() - 1U ? 0U : i + 1U]) >= 0.0F;
+    }
+  }
+}
+
+void RVOSimulator::beginStepAsync() {
+  waitStep();
+
+  if (stepThread_ == NULL) {
+    stepThread_ = new StepThread();
+  }
+
+  frontAgentPositions_ = agentPositions_;
+  frontAgentPrefVelocities_ = agentPrefVelocities_;
+  frontAgentVelocities_ = agentVelocities_;
+  frontAgentHandles_ = agentHandles_;
+  frontGlobalTime_ = globalTime_;
+  stepPending_ = true;
+  stepThread_->start(&RVOSimulator::doStepAsync, this);
+}
+
+void RVOSimulator::buildAgentTree() {
+#ifdef RVO_ENABLE_PROFILING
+  stepProfile_ = StepProfile();
+  const double startTime = getWallTime();
+#endif /* RVO_ENABLE_PROFILING */
+
+  if (dynamicObstaclesChanged_) {
+    buildDynamicObstacles();
+  }
+
+  if (agentProfilesChanged_) {
+    for (std::size_t i = 0U; i < agents_.size(); ++i) {
+      const AgentProfile &profile = agentProfiles_[agents_[i]->profileNo_];
+      agentMaxSpeeds_[i] = profile.maxSpeed;
+
+      /* Ghost agents share a profile but keep their own radii. */
+      if (!agents_[i]->ghost_) {
+        agentRadii_[i] = profile.radius;
       }
+    }
+
+    agentProfilesChanged_ = false;
+  }
+
+  if (agentSortInterval_ > 0U && ++agentSortSteps_ >= agentSortInterval_) {
+    sortAgents();
+  } else if (agentNeighborSearch_ == RVO_AGENT_GRID) {
+    agentGrid_->buildAgentGrid();
+  } else {
+    kdTree_->buildAgentTree();
+  }
+
+#ifdef RVO_ENABLE_PROFILING
+  stepProfile_.buildAgentTreeTime = getWallTime() - startTime;
+#endif /* RVO_ENABLE_PROFILING */
+}
+
+void RVOSimulator::buildDynamicObstacles() {
+  bool hasDynamicObstacles =
+      obstacleWorld_->obstacles_.size() > numStaticObstacleVertices_;
+
+  for (std::size_t i = 0U;
+       i < dynamicObstacles_.size() && !hasDynamicObstacles; ++i) {
+    hasDynamicObstacles = !dynamicObstacles_[i].empty();
+  }
 
-      obstacle->direction_ = normalize(
-          vertices[(i == vertices.size() - 1U ? 0U : i + 1U)] - vertices[i]);
+  /* Leaves a shared obstacle world shared unless there are dynamic obstacle
+   * vertices to append to it. */
+  if (hasDynamicObstacles) {
+    detachObstacleWorld();
+    obstacleWorld_->obstacles_.resize(numStaticObstacleVertices_);
 
-      if (vertices.size() == 2U) {
-        obstacle->isConvex_ = true;
-      } else {
-        obstacle->isConvex_ =
-            leftOf(vertices[i == 0U ? vertices.size() - 1U : i - 1U],
-                   vertices[i],
-                   vertices[i == vertices.size() - 1U ? 0U : i + 1U]) >= 0.0F;
+    for (std::size_t i = 0U; i < dynamicObstacles_.size(); ++i) {
+      if (!dynamicObstacles_[i].empty()) {
+        addObstacleVertices(dynamicObstacles_[i]);
       }
+    }
+  }
+
+  kdTree_->buildDynamicObstacleTree(numStaticObstacleVertices_);
+  dynamicObstaclesChanged_ = false;
+}
+
+void RVOSimulator::clearDynamicObstacles() {
+  if (obstacleWorld_->obstacles_.size() > numStaticObstacleVertices_) {
+    /* A world with dynamic obstacle vertices is never shared. */
+    obstacleWorld_->obstacles_.resize(numStaticObstacleVertices_);
+    kdTree_->buildDynamicObstacleTree(numStaticObstacleVertices_);
+    dynamicObstaclesChanged_ = true;
+  }
+}
+
+void RVOSimulator::computeAgentNeighbors() {
+#ifdef RVO_ENABLE_PROFILING
+  const double startTime = getWallTime();
+#endif /* RVO_ENABLE_PROFILING */
 
-      obstacle->id_ = obstacles_.size();
+  parallelFor(executor_, agents_.size(),
+              &RVOSimulator::computeAgentNeighborsTask, this);
 
-      obstacles_.push_back(obstacle);
+#ifdef RVO_ENABLE_PROFILING
+  stepProfile_.computeAgentNeighborsTime += getWallTime() - startTime;
+  gatherAgentNeighborCounts();
+#endif /* RVO_ENABLE_PROFILING */
+}
+
+void RVOSimulator::computeAgentNeighborsTask(std::size_t begin,
+                                             std::size_t end,
+                                             std::size_t threadNo,
+                                             void *simulator) {
+  RVOSimulator *const sim = static_cast<RVOSimulator *>(simulator);
+  const AgentGrid *const agentGrid =
+      sim->agentNeighborSearch_ == RVO_AGENT_GRID ? sim->agentGrid_ : NULL;
+  static_cast<void>(threadNo);
+
+  for (std::size_t i = begin; i < end; ++i) {
+    if (!sim->agents_[i]->sleeping_) {
+      sim->agents_[i]->computeNeighbors(sim->kdTree_, agentGrid);
     }
+  }
+}
 
-    return obstacleNo;
+void RVOSimulator::computeAgentNewVelocities() {
+#ifdef RVO_ENABLE_PROFILING
+  const double startTime = getWallTime();
+#endif /* RVO_ENABLE_PROFILING */
+
+  /* Scratch storage for the linear programs of each thread. Kept across
+   * steps so that a steady-state step does not allocate memory. */
+  if (projLines_.size() < getNumThreads()) {
+    projLines_.resize(getNumThreads());
   }
 
-  return RVO_ERROR;
+  parallelFor(executor_, agents_.size(),
+              &RVOSimulator::computeAgentNewVelocitiesTask, this);
+
+#ifdef RVO_ENABLE_PROFILING
+  stepProfile_.computeAgentNewVelocitiesTime += getWallTime() - startTime;
+  gatherAgentNewVelocityCounts();
+#endif /* RVO_ENABLE_PROFILING */
+}
+
+void RVOSimulator::computeAgentNewVelocitiesTask(std::size_t begin,
+                                                 std::size_t end,
+                                                 std::size_t threadNo,
+                                                 void *simulator) {
+  RVOSimulator *const sim = static_cast<RVOSimulator *>(simulator);
+  std::vector<Line> &projLines = sim->projLines_[threadNo];
+  const float invTimeStep = 1.0F / sim->timeStep_;
+
+  for (std::size_t i = begin; i < end; ++i) {
+    if (!sim->agents_[i]->sleeping_) {
+      sim->agents_[i]->computeNewVelocity(invTimeStep, projLines);
+    }
+  }
+}
+
+AgentProfile &RVOSimulator::detachAgentProfile(std::size_t agentNo) {
+  Agent *const agent = agents_[agentNo];
+
+  if (agentProfiles_[agent->profileNo_].numReferences > 1U) {
+    const std::size_t profileNo =
+        newAgentProfile(agentProfiles_[agent->profileNo_]);
+    agentProfiles_[profileNo].numReferences = 1U;
+    releaseAgentProfile(agent->profileNo_);
+    agent->profileNo_ = profileNo;
+  }
+
+  return agentProfiles_[agent->profileNo_];
+}
+
+void RVOSimulator::detachObstacleWorld() {
+  if (obstacleWorld_->isShared()) {
+    ObstacleWorld *const obstacleWorld = new ObstacleWorld(*obstacleWorld_);
+    obstacleWorld_->release();
+    obstacleWorld_ = obstacleWorld;
+  }
 }
 
 void RVOSimulator::doStep() {
-  kdTree_->buildAgentTree();
+  buildAgentTree();
+  stepAgents();
+}
 
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif /* _OPENMP */
-  for (int i = 0; i < static_cast<int>(agents_.size()); ++i) {
-    agents_[i]->computeNeighbors(kdTree_);
-    agents_[i]->computeNewVelocity(timeStep_);
+void RVOSimulator::doStep(std::size_t numSubSteps) {
+  if (!(agentNeighborSkin_ > 0.0F)) {
+    for (std::size_t i = 0U; i < numSubSteps; ++i) {
+      doStep();
+    }
+
+    return;
   }
 
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif /* _OPENMP */
-  for (int i = 0; i < static_cast<int>(agents_.size()); ++i) {
-    agents_[i]->update(timeStep_);
+  /* Two agents that have each moved at most half the skin are still within
+   * the other's candidates if within its neighbor distance. */
+  const float maxDisplacementSq =
+      0.25F * agentNeighborSkin_ * agentNeighborSkin_;
+
+  subStepping_ = true;
+  agentCandidatesStale_ = true;
+
+  for (std::size_t i = 0U; i < numSubSteps; ++i) {
+    if (agentCandidatesStale_) {
+      buildAgentTree();
+      agentCandidatePositions_ = agentPositions_;
+
+      /* Sleeping agents compute no candidates, so must not wake unnoticed. */
+      for (std::size_t j = 0U; j < agents_.size(); ++j) {
+        if (agents_[j]->sleeping_) {
+          agentCandidatePositions_[j] =
+              Vector2(std::numeric_limits<float>::infinity(),
+                      std::numeric_limits<float>::infinity());
+        }
+      }
+    } else {
+#ifdef RVO_ENABLE_PROFILING
+      stepProfile_ = StepProfile();
+#endif /* RVO_ENABLE_PROFILING */
+    }
+
+    stepAgents();
+    agentCandidatesStale_ = false;
+
+    for (std::size_t j = 0U; j < agents_.size() && !agentCandidatesStale_;
+         ++j) {
+      agentCandidatesStale_ =
+          !agents_[j]->sleeping_ &&
+          absSq(agentPositions_[j] - agentCandidatePositions_[j]) >
+              maxDisplacementSq;
+    }
   }
 
-  globalTime_ += timeStep_;
+  subStepping_ = false;
+}
+
+void RVOSimulator::doStepAsync(void *simulator) {
+  static_cast<RVOSimulator *>(simulator)->doStep();
 }
 
+void RVOSimulator::doStepTask(std::size_t begin, std::size_t end,
+                              std::size_t threadNo, void *simulator) {
+  RVOSimulator *const sim = static_cast<RVOSimulator *>(simulator);
+  const AgentGrid *const agentGrid =
+      sim->agentNeighborSearch_ == RVO_AGENT_GRID ? sim->agentGrid_ : NULL;
+  std::vector<Line> &projLines = sim->projLines_[threadNo];
+  const float invTimeStep = 1.0F / sim->timeStep_;
+
+  for (std::size_t i = begin; i < end; ++i) {
+    if (!sim->agents_[i]->sleeping_) {
+      sim->agents_[i]->computeNeighbors(sim->kdTree_, agentGrid);
+      sim->agents_[i]->computeNewVelocity(invTimeStep, projLines);
+    }
+  }
+}
+
+#ifdef RVO_ENABLE_PROFILING
+void RVOSimulator::gatherAgentNeighborCounts() {
+  /* Gathered from the agents so that the parallel loop does not share
+   * counters. */
+  for (std::size_t i = 0U; i < agents_.size(); ++i) {
+    if (agents_[i]->sleeping_) {
+      continue;
+    }
+
+    stepProfile_.agentNeighborsInserted += agents_[i]->agentNeighborsInserted_;
+    stepProfile_.agentTreeNodesVisited += agents_[i]->agentTreeNodesVisited_;
+    stepProfile_.obstacleTreeNodesVisited +=
+        agents_[i]->obstacleTreeNodesVisited_;
+  }
+}
+
+void RVOSimulator::gatherAgentNewVelocityCounts() {
+  for (std::size_t i = 0U; i < agents_.size(); ++i) {
+    if (agents_[i]->sleeping_) {
+      continue;
+    }
+
+    stepProfile_.linearProgram3Calls += agents_[i]->linearProgram3Calls_;
+    stepProfile_.obstacleLinesSkipped += agents_[i]->obstacleLinesSkipped_;
+  }
+}
+#endif /* RVO_ENABLE_PROFILING */
+
 std::size_t RVOSimulator::getAgentAgentNeighbor(std::size_t agentNo,
                                                 std::size_t neighborNo) const {
-  return agents_[agentNo]->agentNeighbors_[neighborNo].second->id_;
+  return agents_[agentNo]->agentNeighbors_[neighborNo].second;
 }
 
 std::size_t RVOSimulator::getAgentMaxNeighbors(std::size_t agentNo) const {
-  return agents_[agentNo]->maxNeighbors_;
+  return agentProfiles_[agents_[agentNo]->profileNo_].maxNeighbors;
 }
 
 float RVOSimulator::getAgentMaxSpeed(std::size_t agentNo) const {
-  return agents_[agentNo]->maxSpeed_;
+  return agentProfiles_[agents_[agentNo]->profileNo_].maxSpeed;
 }
 
 float RVOSimulator::getAgentNeighborDist(std::size_t agentNo) const {
-  return agents_[agentNo]->neighborDist_;
+  return agentProfiles_[agents_[agentNo]->profileNo_].neighborDist;
 }
 
 std::size_t RVOSimulator::getAgentNumAgentNeighbors(std::size_t agentNo) const {
@@ -246,7 +981,7 @@ std::size_t RVOSimulator::getAgentNumORCALines(std::size_t agentNo) const {
 
 std::size_t RVOSimulator::getAgentObstacleNeighbor(
     std::size_t agentNo, std::size_t neighborNo) const {
-  return agents_[agentNo]->obstacleNeighbors_[neighborNo].second->id_;
+  return agents_[agentNo]->obstacleNeighbors_[neighborNo].second;
 }
 
 const Line &RVOSimulator::getAgentORCALine(std::size_t agentNo,
@@ -255,42 +990,192 @@ const Line &RVOSimulator::getAgentORCALine(std::size_t agentNo,
 }
 
 const Vector2 &RVOSimulator::getAgentPosition(std::size_t agentNo) const {
-  return agents_[agentNo]->position_;
+  return stepPending_ ? frontAgentPositions_[agentNo]
+                      : agentPositions_[agentNo];
+}
+
+void RVOSimulator::getAgentPositions(Vector2 *positions) const {
+  const std::vector<Vector2> &agentPositions =
+      stepPending_ ? frontAgentPositions_ : agentPositions_;
+  std::copy(agentPositions.begin(), agentPositions.end(), positions);
 }
 
 const Vector2 &RVOSimulator::getAgentPrefVelocity(std::size_t agentNo) const {
-  return agents_[agentNo]->prefVelocity_;
+  return stepPending_ ? frontAgentPrefVelocities_[agentNo]
+                      : agentPrefVelocities_[agentNo];
 }
 
 float RVOSimulator::getAgentRadius(std::size_t agentNo) const {
-  return agents_[agentNo]->radius_;
+  return agentProfiles_[agents_[agentNo]->profileNo_].radius;
+}
+
+bool RVOSimulator::getAgentSleeping(std::size_t agentNo) const {
+  return agents_[agentNo]->sleeping_;
 }
 
 float RVOSimulator::getAgentTimeHorizon(std::size_t agentNo) const {
-  return agents_[agentNo]->timeHorizon_;
+  return agentProfiles_[agents_[agentNo]->profileNo_].timeHorizon;
 }
 
 float RVOSimulator::getAgentTimeHorizonObst(std::size_t agentNo) const {
-  return agents_[agentNo]->timeHorizonObst_;
+  return agentProfiles_[agents_[agentNo]->profileNo_].timeHorizonObst;
+}
+
+bool RVOSimulator::getAgentTreeRefit() const {
+  return kdTree_->agentTreeRefit_;
+}
+
+float RVOSimulator::getAgentTreeRefitThreshold() const {
+  return kdTree_->agentTreeRefitThreshold_;
 }
 
 const Vector2 &RVOSimulator::getAgentVelocity(std::size_t agentNo) const {
-  return agents_[agentNo]->velocity_;
+  return stepPending_ ? frontAgentVelocities_[agentNo]
+                      : agentVelocities_[agentNo];
+}
+
+void RVOSimulator::getAgentVelocities(Vector2 *velocities) const {
+  const std::vector<Vector2> &agentVelocities =
+      stepPending_ ? frontAgentVelocities_ : agentVelocities_;
+  std::copy(agentVelocities.begin(), agentVelocities.end(), velocities);
+}
+
+std::size_t RVOSimulator::getNumObstacleVertices() const {
+  return obstacleWorld_->obstacles_.size();
+}
+
+std::size_t RVOSimulator::getNumThreads() const {
+  return getExecutorNumThreads(executor_);
+}
+
+std::size_t RVOSimulator::getObstacleTreeSplitCandidates() const {
+  return kdTree_->obstacleTreeSplitCandidates_;
+}
+
+ObstacleWorld *RVOSimulator::getObstacleWorld() {
+  clearDynamicObstacles();
+  obstacleWorld_->addReference();
+
+  return obstacleWorld_;
 }
 
 const Vector2 &RVOSimulator::getObstacleVertex(std::size_t vertexNo) const {
-  return obstacles_[vertexNo]->point_;
+  return obstacleWorld_->obstacles_[vertexNo].point_;
 }
 
 std::size_t RVOSimulator::getNextObstacleVertexNo(std::size_t vertexNo) const {
-  return obstacles_[vertexNo]->next_->id_;
+  return obstacleWorld_->obstacles_[vertexNo].next_;
 }
 
 std::size_t RVOSimulator::getPrevObstacleVertexNo(std::size_t vertexNo) const {
-  return obstacles_[vertexNo]->previous_->id_;
+  return obstacleWorld_->obstacles_[vertexNo].previous_;
+}
+
+bool RVOSimulator::getSnapshotOrder(
+    const unsigned char *handles,
+    std::vector<std::size_t> &order) const { /* NOLINT(runtime/references) */
+  const std::size_t numAgents = agents_.size();
+  order.clear();
+
+  if (numAgents == 0U ||
+      std::memcmp(handles, &agentHandles_[0],
+                  numAgents * sizeof(std::size_t)) == 0) {
+    return true;
+  }
+
+  order.resize(numAgents);
+  std::vector<bool> ordered(numAgents, false);
+
+  for (std::size_t i = 0U; i < numAgents; ++i) {
+    std::size_t handle = 0U;
+    std::memcpy(&handle, handles + i * sizeof(std::size_t),
+                sizeof(std::size_t));
+
+    if (handle >= agentNos_.size() || agentNos_[handle] == RVO_ERROR ||
+        ordered[agentNos_[handle]]) {
+      order.clear();
+
+      return false;
+    }
+
+    order[i] = agentNos_[handle];
+    ordered[order[i]] = true;
+  }
+
+  return true;
+}
+
+Agent *RVOSimulator::newAgent() {
+  if (freeAgentStorage_.empty()) {
+    /* Grows geometrically, as for the agent arrays. */
+    allocateAgents(std::max(agents_.size(), RVO_MIN_AGENT_STORAGE_SIZE));
+  }
+
+  Agent *const agent = new (freeAgentStorage_.back()) Agent(this);
+  freeAgentStorage_.pop_back();
+  agent->id_ = agents_.size();
+
+  return agent;
+}
+
+std::size_t RVOSimulator::newAgentProfile(const AgentProfile &profile) {
+  std::size_t profileNo = agentProfiles_.size();
+
+  if (freeAgentProfiles_.empty()) {
+    agentProfiles_.push_back(profile);
+  } else {
+    profileNo = freeAgentProfiles_.back();
+    freeAgentProfiles_.pop_back();
+    agentProfiles_[profileNo] = profile;
+  }
+
+  agentProfiles_[profileNo].numReferences = 0U;
+
+  return profileNo;
 }
 
-void RVOSimulator::processObstacles() { kdTree_->buildObstacleTree(); }
+bool RVOSimulator::loadObstacles(const void *data, std::size_t size) {
+  clearDynamicObstacles();
+  detachObstacleWorld();
+
+  if (kdTree_->loadObstacles(data, size)) {
+    numStaticObstacleVertices_ = obstacleWorld_->obstacles_.size();
+
+    return true;
+  }
+
+  return false;
+}
+
+void RVOSimulator::parallelFor(Executor *executor, std::size_t numItems,
+                               Executor::Task task, void *userData) {
+  if (executor != NULL) {
+    executor->parallelFor(numItems, RVO_PARALLEL_CHUNK_SIZE, task, userData);
+    return;
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel
+  {
+    /* Contiguous ranges of equal size, as a static schedule would assign. */
+    const std::size_t numThreads =
+        static_cast<std::size_t>(omp_get_num_threads());
+    const std::size_t threadNo = static_cast<std::size_t>(omp_get_thread_num());
+
+    task(numItems * threadNo / numThreads,
+         numItems * (threadNo + 1U) / numThreads, threadNo, userData);
+  }
+#else
+  task(0U, numItems, 0U, userData);
+#endif /* _OPENMP */
+}
+
+void RVOSimulator::processObstacles() {
+  clearDynamicObstacles();
+  detachObstacleWorld();
+  kdTree_->buildObstacleTree();
+  numStaticObstacleVertices_ = obstacleWorld_->obstacles_.size();
+}
 
 bool RVOSimulator::queryVisibility(const Vector2 &point1,
                                    const Vector2 &point2) const {
@@ -302,6 +1187,194 @@ bool RVOSimulator::queryVisibility(const Vector2 &point1, const Vector2 &point2,
   return kdTree_->queryVisibility(point1, point2, radius);
 }
 
+void RVOSimulator::queryVisibility(const std::pair<Vector2, Vector2> *segments,
+                                   std::size_t numSegments, float radius,
+                                   bool *visible) const {
+  kdTree_->queryVisibility(segments, numSegments, radius, visible);
+}
+
+void RVOSimulator::releaseAgentProfile(std::size_t profileNo) {
+  if (--agentProfiles_[profileNo].numReferences == 0U) {
+    freeAgentProfiles_.push_back(profileNo);
+
+    if (profileNo == lastAgentProfileNo_) {
+      lastAgentProfileNo_ = RVO_ERROR;
+    }
+  }
+}
+
+void RVOSimulator::removeAgent(std::size_t agentNo) {
+  const std::size_t lastNo = agents_.size() - 1U;
+
+  kdTree_->removeAgent(agentNo);
+
+  agentNos_[agentHandles_[agentNo]] = RVO_ERROR;
+  freeAgentHandles_.push_back(agentHandles_[agentNo]);
+  releaseAgentProfile(agents_[agentNo]->profileNo_);
+  agents_[agentNo]->~Agent();
+  freeAgentStorage_.push_back(agents_[agentNo]);
+
+  if (agentNo != lastNo) {
+    /* Move the last agent into the slot of the removed agent. */
+    agents_[agentNo] = agents_[lastNo];
+    agents_[agentNo]->id_ = agentNo;
+    agentPositions_[agentNo] = agentPositions_[lastNo];
+    agentPrefVelocities_[agentNo] = agentPrefVelocities_[lastNo];
+    agentVelocities_[agentNo] = agentVelocities_[lastNo];
+    agentMaxSpeeds_[agentNo] = agentMaxSpeeds_[lastNo];
+    agentRadii_[agentNo] = agentRadii_[lastNo];
+    agentHandles_[agentNo] = agentHandles_[lastNo];
+    agentNos_[agentHandles_[agentNo]] = agentNo;
+  }
+
+  agents_.pop_back();
+  agentPositions_.pop_back();
+  agentPrefVelocities_.pop_back();
+  agentVelocities_.pop_back();
+  agentMaxSpeeds_.pop_back();
+  agentRadii_.pop_back();
+  agentHandles_.pop_back();
+}
+
+void RVOSimulator::removeDynamicObstacle(std::size_t dynamicObstacleNo) {
+  dynamicObstacles_[dynamicObstacleNo].clear();
+  freeDynamicObstacles_.push_back(dynamicObstacleNo);
+  dynamicObstaclesChanged_ = true;
+}
+
+void RVOSimulator::reorderAgents(const std::vector<std::size_t> &order) {
+  std::vector<std::size_t> agentNos(order.size());
+
+  for (std::size_t i = 0U; i < order.size(); ++i) {
+    agentNos[order[i]] = i;
+  }
+
+  reorderAgentValues(agents_, order);
+  reorderAgentValues(agentPositions_, order);
+  reorderAgentValues(agentPrefVelocities_, order);
+  reorderAgentValues(agentVelocities_, order);
+  reorderAgentValues(agentMaxSpeeds_, order);
+  reorderAgentValues(agentRadii_, order);
+  reorderAgentValues(agentHandles_, order);
+
+  for (std::size_t i = 0U; i < agents_.size(); ++i) {
+    Agent *const agent = agents_[i];
+    agent->id_ = i;
+    agentNos_[agentHandles_[i]] = i;
+
+    for (std::size_t j = 0U; j < agent->agentNeighbors_.size(); ++j) {
+      std::size_t &neighborNo = agent->agentNeighbors_[j].second;
+
+      /* Agents removed since the most recent simulation step may leave
+       * neighbors numbered past the last agent. */
+      if (neighborNo < agentNos.size()) {
+        neighborNo = agentNos[neighborNo];
+      }
+    }
+  }
+}
+
+void RVOSimulator::reserveAgents(std::size_t numAgents) {
+  agents_.reserve(numAgents);
+  agentPositions_.reserve(numAgents);
+  agentPrefVelocities_.reserve(numAgents);
+  agentVelocities_.reserve(numAgents);
+  agentMaxSpeeds_.reserve(numAgents);
+  agentRadii_.reserve(numAgents);
+  agentHandles_.reserve(numAgents);
+  agentNos_.reserve(numAgents);
+  kdTree_->reserveAgents(numAgents);
+
+  if (agents_.size() + freeAgentStorage_.size() < numAgents) {
+    allocateAgents(numAgents - agents_.size() - freeAgentStorage_.size());
+  }
+}
+
+bool RVOSimulator::restore(const void *data, std::size_t size) {
+  waitStep();
+
+  SnapshotHeader header;
+
+  if (!readSnapshotHeader(data, size, header) ||
+      header.numAgents != agents_.size()) {
+    return false;
+  }
+
+  const std::size_t numAgents = agents_.size();
+  const unsigned char *in =
+      static_cast<const unsigned char *>(data) + sizeof(SnapshotHeader);
+  std::vector<std::size_t> order;
+
+  if (header.numRecords == RVO_ERROR || header.numHandles > 0U) {
+    if (!getSnapshotOrder(in, order)) {
+      return false;
+    }
+
+    in += numAgents * sizeof(std::size_t);
+  }
+
+  if (header.numRecords != RVO_ERROR) {
+    /* Checks every record of a delta snapshot before applying any. */
+    for (std::size_t i = 0U; i < header.numRecords; ++i) {
+      SnapshotRecord record;
+      std::memcpy(&record, in + i * sizeof(SnapshotRecord),
+                  sizeof(SnapshotRecord));
+
+      if (record.handle >= agentNos_.size() ||
+          agentNos_[record.handle] == RVO_ERROR) {
+        return false;
+      }
+    }
+  }
+
+  if (!order.empty()) {
+    reorderAgents(order);
+  }
+
+  if (header.numRecords != RVO_ERROR) {
+    for (std::size_t i = 0U; i < header.numRecords; ++i) {
+      SnapshotRecord record;
+      std::memcpy(&record, in + i * sizeof(SnapshotRecord),
+                  sizeof(SnapshotRecord));
+
+      const std::size_t agentNo = agentNos_[record.handle];
+      agentPositions_[agentNo] = record.position;
+      agentVelocities_[agentNo] = record.velocity;
+      agentPrefVelocities_[agentNo] = record.prefVelocity;
+      agents_[agentNo]->sleeping_ =
+          (record.flags & RVO_SNAPSHOT_SLEEPING) != 0U;
+      agents_[agentNo]->stationary_ =
+          (record.flags & RVO_SNAPSHOT_STATIONARY) != 0U;
+    }
+  } else if (numAgents > 0U) {
+    std::memcpy(&agentPositions_[0], in, numAgents * sizeof(Vector2));
+    in += numAgents * sizeof(Vector2);
+    std::memcpy(&agentVelocities_[0], in, numAgents * sizeof(Vector2));
+    in += numAgents * sizeof(Vector2);
+    std::memcpy(&agentPrefVelocities_[0], in, numAgents * sizeof(Vector2));
+    in += numAgents * sizeof(Vector2);
+
+    for (std::size_t i = 0U; i < numAgents; ++i) {
+      agents_[i]->sleeping_ = (in[i] & RVO_SNAPSHOT_SLEEPING) != 0U;
+      agents_[i]->stationary_ = (in[i] & RVO_SNAPSHOT_STATIONARY) != 0U;
+    }
+  }
+
+  agentSortSteps_ = header.agentSortSteps;
+  globalTime_ = header.globalTime;
+
+  /* Rebuilt from the agent numbers alone, so that the steps after restoring
+   * the snapshot do not depend on the steps before. */
+  kdTree_->renumberAgents();
+  kdTree_->agentTreeRebuild_ = true;
+
+  return true;
+}
+
+std::size_t RVOSimulator::saveObstacles(void *data, std::size_t size) const {
+  return kdTree_->saveObstacles(data, size);
+}
+
 void RVOSimulator::setAgentDefaults(float neighborDist,
                                     std::size_t maxNeighbors, float timeHorizon,
                                     float timeHorizonObst, float radius,
@@ -314,58 +1387,601 @@ void RVOSimulator::setAgentDefaults(float neighborDist,
                                     std::size_t maxNeighbors, float timeHorizon,
                                     float timeHorizonObst, float radius,
                                     float maxSpeed, const Vector2 &velocity) {
-  if (defaultAgent_ == NULL) {
-    defaultAgent_ = new Agent();
+  if (defaultAgentProfileNo_ != RVO_ERROR) {
+    releaseAgentProfile(defaultAgentProfileNo_);
   }
 
-  defaultAgent_->maxNeighbors_ = maxNeighbors;
-  defaultAgent_->maxSpeed_ = maxSpeed;
-  defaultAgent_->neighborDist_ = neighborDist;
-  defaultAgent_->radius_ = radius;
-  defaultAgent_->timeHorizon_ = timeHorizon;
-  defaultAgent_->timeHorizonObst_ = timeHorizonObst;
-  defaultAgent_->velocity_ = velocity;
+  /* The simulator holds a reference to the default profile. */
+  defaultAgentProfileNo_ =
+      newAgentProfile(AgentProfile(neighborDist, maxNeighbors, timeHorizon,
+                                   timeHorizonObst, radius, maxSpeed));
+  agentProfiles_[defaultAgentProfileNo_].numReferences = 1U;
+  defaultVelocity_ = velocity;
 }
 
 void RVOSimulator::setAgentMaxNeighbors(std::size_t agentNo,
                                         std::size_t maxNeighbors) {
-  agents_[agentNo]->maxNeighbors_ = maxNeighbors;
+  detachAgentProfile(agentNo).maxNeighbors = maxNeighbors;
 }
 
 void RVOSimulator::setAgentMaxSpeed(std::size_t agentNo, float maxSpeed) {
-  agents_[agentNo]->maxSpeed_ = maxSpeed;
+  AgentProfile &profile = detachAgentProfile(agentNo);
+  profile.maxSpeed = maxSpeed;
+  profile.update();
+  agentMaxSpeeds_[agentNo] = maxSpeed;
 }
 
 void RVOSimulator::setAgentNeighborDist(std::size_t agentNo,
                                         float neighborDist) {
-  agents_[agentNo]->neighborDist_ = neighborDist;
+  AgentProfile &profile = detachAgentProfile(agentNo);
+  profile.neighborDist = neighborDist;
+  profile.update();
 }
 
 void RVOSimulator::setAgentPosition(std::size_t agentNo,
                                     const Vector2 &position) {
-  agents_[agentNo]->position_ = position;
+  if (agentPositions_[agentNo] != position) {
+    wakeAgent(agentNo);
+  }
+
+  agentPositions_[agentNo] = position;
 }
 
 void RVOSimulator::setAgentPrefVelocity(std::size_t agentNo,
                                         const Vector2 &prefVelocity) {
-  agents_[agentNo]->prefVelocity_ = prefVelocity;
+  if (stepPending_) {
+    frontAgentPrefVelocities_[agentNo] = prefVelocity;
+    return;
+  }
+
+  if (agentPrefVelocities_[agentNo] != prefVelocity) {
+    wakeAgent(agentNo);
+  }
+
+  agentPrefVelocities_[agentNo] = prefVelocity;
+}
+
+void RVOSimulator::setAgentPrefVelocities(const Vector2 *prefVelocities,
+                                          std::size_t numAgents) {
+  if (stepPending_) {
+    std::copy(prefVelocities, prefVelocities + numAgents,
+              frontAgentPrefVelocities_.begin());
+    return;
+  }
+
+  for (std::size_t i = 0U; i < numAgents; ++i) {
+    if (agentPrefVelocities_[i] != prefVelocities[i]) {
+      wakeAgent(i);
+    }
+  }
+
+  std::copy(prefVelocities, prefVelocities + numAgents,
+            agentPrefVelocities_.begin());
+}
+
+void RVOSimulator::setAgentProfile(std::size_t agentNo, std::size_t profileNo) {
+  if (profileNo >= agentProfiles_.size() ||
+      agentProfiles_[profileNo].numReferences == 0U) {
+    return;
+  }
+
+  const AgentProfile &profile = agentProfiles_[profileNo];
+  ++agentProfiles_[profileNo].numReferences;
+  releaseAgentProfile(agents_[agentNo]->profileNo_);
+  agents_[agentNo]->profileNo_ = profileNo;
+  agentMaxSpeeds_[agentNo] = profile.maxSpeed;
+  agentRadii_[agentNo] = profile.radius;
+}
+
+void RVOSimulator::setAgentProfileParameters(
+    std::size_t profileNo, float neighborDist, std::size_t maxNeighbors,
+    float timeHorizon, float timeHorizonObst, float radius, float maxSpeed) {
+  AgentProfile &profile = agentProfiles_[profileNo];
+  profile.maxNeighbors = maxNeighbors;
+  profile.maxSpeed = maxSpeed;
+  profile.neighborDist = neighborDist;
+  profile.radius = radius;
+  profile.timeHorizon = timeHorizon;
+  profile.timeHorizonObst = timeHorizonObst;
+  profile.update();
+
+  /* Radii and maximum speeds are refreshed when the next step begins. */
+  agentProfilesChanged_ = true;
 }
 
 void RVOSimulator::setAgentRadius(std::size_t agentNo, float radius) {
-  agents_[agentNo]->radius_ = radius;
+  AgentProfile &profile = detachAgentProfile(agentNo);
+  profile.radius = radius;
+  profile.update();
+  agentRadii_[agentNo] = radius;
 }
 
 void RVOSimulator::setAgentTimeHorizon(std::size_t agentNo, float timeHorizon) {
-  agents_[agentNo]->timeHorizon_ = timeHorizon;
+  AgentProfile &profile = detachAgentProfile(agentNo);
+  profile.timeHorizon = timeHorizon;
+  profile.update();
 }
 
 void RVOSimulator::setAgentTimeHorizonObst(std::size_t agentNo,
                                            float timeHorizonObst) {
-  agents_[agentNo]->timeHorizonObst_ = timeHorizonObst;
+  AgentProfile &profile = detachAgentProfile(agentNo);
+  profile.timeHorizonObst = timeHorizonObst;
+  profile.update();
+}
+
+void RVOSimulator::setAgentTreeRefit(bool refit) {
+  kdTree_->agentTreeRefit_ = refit;
+}
+
+void RVOSimulator::setAgentTreeRefitThreshold(float threshold) {
+  kdTree_->agentTreeRefitThreshold_ = threshold;
+}
+
+void RVOSimulator::setAgentSleepThreshold(float threshold) {
+  agentSleepThreshold_ = threshold;
+
+  if (threshold <= 0.0F) {
+    for (std::size_t i = 0U; i < agents_.size(); ++i) {
+      wakeAgent(i);
+    }
+  }
 }
 
 void RVOSimulator::setAgentVelocity(std::size_t agentNo,
                                     const Vector2 &velocity) {
-  agents_[agentNo]->velocity_ = velocity;
+  if (agentVelocities_[agentNo] != velocity) {
+    wakeAgent(agentNo);
+  }
+
+  agentVelocities_[agentNo] = velocity;
+}
+
+void RVOSimulator::setDynamicObstacleVertices(
+    std::size_t dynamicObstacleNo, const std::vector<Vector2> &vertices) {
+  dynamicObstacles_[dynamicObstacleNo] = vertices;
+  dynamicObstaclesChanged_ = true;
+}
+
+void RVOSimulator::setExecutor(Executor *executor) {
+  delete threadPool_;
+  threadPool_ = NULL;
+  executor_ = executor;
+}
+
+void RVOSimulator::setNumThreads(std::size_t numThreads) {
+  delete threadPool_;
+  threadPool_ = numThreads > 0U ? new ThreadPool(numThreads) : NULL;
+  executor_ = threadPool_;
+}
+
+void RVOSimulator::setObstacleWorld(ObstacleWorld *obstacleWorld) {
+  clearDynamicObstacles();
+  obstacleWorld->addReference();
+  obstacleWorld_->release();
+  obstacleWorld_ = obstacleWorld;
+  numStaticObstacleVertices_ = obstacleWorld_->obstacles_.size();
+  kdTree_->buildDynamicObstacleTree(numStaticObstacleVertices_);
+  dynamicObstaclesChanged_ = true;
+}
+
+void RVOSimulator::setObstacleTreeSplitCandidates(std::size_t numCandidates) {
+  kdTree_->obstacleTreeSplitCandidates_ = numCandidates;
+}
+
+std::size_t RVOSimulator::snapshot(void *data, std::size_t size) const {
+  const std::size_t numAgents = agents_.size();
+  const std::size_t dataSize =
+      sizeof(SnapshotHeader) + numAgents * RVO_SNAPSHOT_AGENT_SIZE;
+
+  if (data == NULL || size < dataSize) {
+    return dataSize;
+  }
+
+  SnapshotHeader header;
+  std::memset(&header, 0, sizeof(SnapshotHeader));
+  std::memcpy(header.magic, RVO_SNAPSHOT_MAGIC, sizeof(RVO_SNAPSHOT_MAGIC));
+  header.version = RVO_SNAPSHOT_VERSION;
+  header.numAgents = numAgents;
+  header.numHandles = numAgents;
+  header.numRecords = RVO_ERROR;
+  header.agentSortSteps = agentSortSteps_;
+  header.globalTime = globalTime_;
+
+  unsigned char *out = static_cast<unsigned char *>(data);
+  std::memcpy(out, &header, sizeof(SnapshotHeader));
+  out += sizeof(SnapshotHeader);
+
+  if (numAgents > 0U) {
+    std::memcpy(out, &agentHandles_[0], numAgents * sizeof(std::size_t));
+    out += numAgents * sizeof(std::size_t);
+    std::memcpy(out, &agentPositions_[0], numAgents * sizeof(Vector2));
+    out += numAgents * sizeof(Vector2);
+    std::memcpy(out, &agentVelocities_[0], numAgents * sizeof(Vector2));
+    out += numAgents * sizeof(Vector2);
+    std::memcpy(out, &agentPrefVelocities_[0], numAgents * sizeof(Vector2));
+    out += numAgents * sizeof(Vector2);
+
+    for (std::size_t i = 0U; i < numAgents; ++i) {
+      out[i] =
+          getSnapshotFlags(agents_[i]->sleeping_, agents_[i]->stationary_);
+    }
+  }
+
+  return dataSize;
+}
+
+std::size_t RVOSimulator::snapshotDelta(const void *base, std::size_t baseSize,
+                                        void *data, std::size_t size) const {
+  SnapshotHeader header;
+
+  if (!readSnapshotHeader(base, baseSize, header) ||
+      header.numRecords != RVO_ERROR || header.numAgents != agents_.size()) {
+    return 0U;
+  }
+
+  const std::size_t numAgents = agents_.size();
+  const unsigned char *const baseHandles =
+      static_cast<const unsigned char *>(base) + sizeof(SnapshotHeader);
+  const unsigned char *const basePositions =
+      baseHandles + numAgents * sizeof(std::size_t);
+  const unsigned char *const baseVelocities =
+      basePositions + numAgents * sizeof(Vector2);
+  const unsigned char *const basePrefVelocities =
+      baseVelocities + numAgents * sizeof(Vector2);
+  const unsigned char *const baseFlags =
+      basePrefVelocities + numAgents * sizeof(Vector2);
+  std::vector<std::size_t> order;
+
+  /* The numbers of the agents in the base, listed by their present numbers,
+   * are the inverse of the order in which to renumber them. */
+  if (!getSnapshotOrder(baseHandles, order)) {
+    return 0U;
+  }
+
+  std::vector<std::size_t> baseNos(order.size());
+
+  for (std::size_t i = 0U; i < order.size(); ++i) {
+    baseNos[order[i]] = i;
+  }
+
+  std::vector<std::size_t> changedAgentNos;
+
+  for (std::size_t i = 0U; i < numAgents; ++i) {
+    const std::size_t baseNo = baseNos.empty() ? i : baseNos[i];
+
+    if (std::memcmp(basePositions + baseNo * sizeof(Vector2),
+                    &agentPositions_[i], sizeof(Vector2)) != 0 ||
+        std::memcmp(baseVelocities + baseNo * sizeof(Vector2),
+                    &agentVelocities_[i], sizeof(Vector2)) != 0 ||
+        std::memcmp(basePrefVelocities + baseNo * sizeof(Vector2),
+                    &agentPrefVelocities_[i], sizeof(Vector2)) != 0 ||
+        baseFlags[baseNo] != getSnapshotFlags(agents_[i]->sleeping_,
+                                              agents_[i]->stationary_)) {
+      changedAgentNos.push_back(i);
+    }
+  }
+
+  /* The handles are only needed if the agents were renumbered. */
+  const std::size_t numHandles = baseNos.empty() ? 0U : numAgents;
+  const std::size_t dataSize = sizeof(SnapshotHeader) +
+                               numHandles * sizeof(std::size_t) +
+                               changedAgentNos.size() * sizeof(SnapshotRecord);
+
+  if (data == NULL || size < dataSize) {
+    return dataSize;
+  }
+
+  header.numHandles = numHandles;
+  header.numRecords = changedAgentNos.size();
+  header.agentSortSteps = agentSortSteps_;
+  header.globalTime = globalTime_;
+
+  unsigned char *out = static_cast<unsigned char *>(data);
+  std::memcpy(out, &header, sizeof(SnapshotHeader));
+  out += sizeof(SnapshotHeader);
+
+  if (numHandles > 0U) {
+    std::memcpy(out, &agentHandles_[0], numHandles * sizeof(std::size_t));
+    out += numHandles * sizeof(std::size_t);
+  }
+
+  for (std::size_t i = 0U; i < changedAgentNos.size(); ++i) {
+    const std::size_t agentNo = changedAgentNos[i];
+    SnapshotRecord record = SnapshotRecord();
+    record.handle = agentHandles_[agentNo];
+    record.position = agentPositions_[agentNo];
+    record.velocity = agentVelocities_[agentNo];
+    record.prefVelocity = agentPrefVelocities_[agentNo];
+    record.flags = getSnapshotFlags(agents_[agentNo]->sleeping_,
+                                    agents_[agentNo]->stationary_);
+    std::memcpy(out + i * sizeof(SnapshotRecord), &record,
+                sizeof(SnapshotRecord));
+  }
+
+  return dataSize;
+}
+
+void RVOSimulator::sortAgents() {
+  agentSortSteps_ = 0U;
+
+  if (agentNeighborSearch_ == RVO_AGENT_GRID) {
+    agentGrid_->buildAgentGrid();
+    reorderAgents(agentGrid_->agents_);
+
+    /* Cheaper to rebuild than to renumber. */
+    agentGrid_->buildAgentGrid();
+  } else {
+    kdTree_->buildAgentTree();
+
+    if (kdTree_->agents_.size() > agents_.size()) {
+      /* Skip the holes left by agents removed since the tree was rebuilt. */
+      std::vector<std::size_t> order;
+      order.reserve(agents_.size());
+      std::remove_copy(kdTree_->agents_.begin(), kdTree_->agents_.end(),
+                       std::back_inserter(order), RVO_ERROR);
+      reorderAgents(order);
+    } else {
+      reorderAgents(kdTree_->agents_);
+    }
+
+    kdTree_->renumberAgents();
+  }
+}
+
+void RVOSimulator::stepAgents() {
+#ifdef RVO_ENABLE_PROFILING
+  /* Unfused so that each phase is timed separately. */
+  computeAgentNeighbors();
+  computeAgentNewVelocities();
+  updateAgents();
+#else
+  if (projLines_.size() < getNumThreads()) {
+    projLines_.resize(getNumThreads());
+  }
+
+  /* Same as computeAgentNeighbors() followed by computeAgentNewVelocities(),
+   * fused so that each agent computes its new velocity while its neighbors
+   * are still in cache. */
+  parallelFor(executor_, agents_.size(), &RVOSimulator::doStepTask, this);
+
+  updateAgents();
+#endif /* RVO_ENABLE_PROFILING */
+}
+
+void RVOSimulator::stepAll(RVOSimulator *const *simulators,
+                           std::size_t numSimulators, Executor *executor) {
+  StepAllData steps;
+  steps.simulators = simulators;
+  steps.task = NULL;
+  steps.agentOffsets.resize(numSimulators + 1U, 0U);
+
+  const std::size_t numThreads = getExecutorNumThreads(executor);
+
+  for (std::size_t i = 0U; i < numSimulators; ++i) {
+    simulators[i]->waitStep();
+  }
+
+  /* One simulation per range, since the cost of building an agent tree
+   * varies with the number of agents. On an executor, each tree is built
+   * serially, so that no thread of the executor starts an OpenMP team of its
+   * own. */
+  if (executor != NULL) {
+    for (std::size_t i = 0U; i < numSimulators; ++i) {
+      simulators[i]->agentTreeSerial_ = true;
+    }
+
+    executor->parallelFor(numSimulators, 1U, &RVOSimulator::stepAllTask,
+                          &steps);
+
+    for (std::size_t i = 0U; i < numSimulators; ++i) {
+      simulators[i]->agentTreeSerial_ = false;
+    }
+  } else {
+    parallelFor(NULL, numSimulators, &RVOSimulator::stepAllTask, &steps);
+  }
+
+  for (std::size_t i = 0U; i < numSimulators; ++i) {
+    if (simulators[i]->projLines_.size() < numThreads) {
+      simulators[i]->projLines_.resize(numThreads);
+    }
+
+    steps.agentOffsets[i + 1U] =
+        steps.agentOffsets[i] + simulators[i]->agents_.size();
+  }
+
+#ifdef RVO_ENABLE_PROFILING
+  /* Unfused so that each phase is timed separately. The phases are shared, so
+   * every simulation records their times. */
+  double startTime = getWallTime();
+
+  steps.task = &RVOSimulator::computeAgentNeighborsTask;
+  parallelFor(executor, steps.agentOffsets.back(), &RVOSimulator::stepAllTask,
+              &steps);
+
+  const double computeAgentNeighborsTime = getWallTime() - startTime;
+  startTime = getWallTime();
+
+  steps.task = &RVOSimulator::computeAgentNewVelocitiesTask;
+  parallelFor(executor, steps.agentOffsets.back(), &RVOSimulator::stepAllTask,
+              &steps);
+
+  const double computeAgentNewVelocitiesTime = getWallTime() - startTime;
+  startTime = getWallTime();
+#else
+  steps.task = &RVOSimulator::doStepTask;
+  parallelFor(executor, steps.agentOffsets.back(), &RVOSimulator::stepAllTask,
+              &steps);
+#endif /* RVO_ENABLE_PROFILING */
+
+  steps.task = &RVOSimulator::updateAgentsTask;
+  parallelFor(executor, steps.agentOffsets.back(), &RVOSimulator::stepAllTask,
+              &steps);
+
+#ifdef RVO_ENABLE_PROFILING
+  const double updateAgentsTime = getWallTime() - startTime;
+#endif /* RVO_ENABLE_PROFILING */
+
+  for (std::size_t i = 0U; i < numSimulators; ++i) {
+    RVOSimulator *const simulator = simulators[i];
+
+    if (simulator->agentSleepThreshold_ > 0.0F) {
+      simulator->updateAgentSleep();
+    }
+
+    simulator->globalTime_ += simulator->timeStep_;
+
+#ifdef RVO_ENABLE_PROFILING
+    simulator->stepProfile_.computeAgentNeighborsTime =
+        computeAgentNeighborsTime;
+    simulator->stepProfile_.computeAgentNewVelocitiesTime =
+        computeAgentNewVelocitiesTime;
+    simulator->stepProfile_.updateAgentsTime = updateAgentsTime;
+    simulator->gatherAgentNeighborCounts();
+    simulator->gatherAgentNewVelocityCounts();
+
+    if (simulator->stepProfileCallback_ != NULL) {
+      simulator->stepProfileCallback_(simulator->stepProfile_,
+                                      simulator->stepProfileUserData_);
+    }
+#endif /* RVO_ENABLE_PROFILING */
+
+    if (simulator->trajectoryRecorder_ != NULL) {
+      simulator->trajectoryRecorder_->recordFrame(*simulator);
+    }
+  }
+}
+
+void RVOSimulator::stepAllTask(std::size_t begin, std::size_t end,
+                               std::size_t threadNo, void *steps) {
+  const StepAllData *const data = static_cast<StepAllData *>(steps);
+
+  if (data->task == NULL) {
+    /* Ranges of simulations rather than of agents. */
+    for (std::size_t i = begin; i < end; ++i) {
+      data->simulators[i]->buildAgentTree();
+    }
+
+    return;
+  }
+
+  const std::vector<std::size_t> &offsets = data->agentOffsets;
+  std::size_t simulatorNo =
+      static_cast<std::size_t>(
+          std::upper_bound(offsets.begin(), offsets.end(), begin) -
+          offsets.begin()) -
+      1U;
+
+  while (begin < end) {
+    const std::size_t simulatorEnd = std::min(end, offsets[simulatorNo + 1U]);
+
+    if (begin < simulatorEnd) {
+      data->task(begin - offsets[simulatorNo],
+                 simulatorEnd - offsets[simulatorNo], threadNo,
+                 data->simulators[simulatorNo]);
+    }
+
+    begin = simulatorEnd;
+    ++simulatorNo;
+  }
+}
+
+void RVOSimulator::updateAgents() {
+#ifdef RVO_ENABLE_PROFILING
+  const double startTime = getWallTime();
+#endif /* RVO_ENABLE_PROFILING */
+
+  parallelFor(executor_, agents_.size(), &RVOSimulator::updateAgentsTask, this);
+
+  if (agentSleepThreshold_ > 0.0F) {
+    updateAgentSleep();
+  }
+
+  globalTime_ += timeStep_;
+
+#ifdef RVO_ENABLE_PROFILING
+  stepProfile_.updateAgentsTime += getWallTime() - startTime;
+
+  if (stepProfileCallback_ != NULL) {
+    stepProfileCallback_(stepProfile_, stepProfileUserData_);
+  }
+#endif /* RVO_ENABLE_PROFILING */
+
+  if (trajectoryRecorder_ != NULL) {
+    trajectoryRecorder_->recordFrame(*this);
+  }
+}
+
+void RVOSimulator::updateAgentSleep() {
+  for (std::size_t i = 0U; i < agents_.size(); ++i) {
+    Agent *const agent = agents_[i];
+
+    if (agent->stationary_ && !agent->sleeping_) {
+      bool sleeping = true;
+
+      for (std::size_t j = 0U; j < agent->agentNeighbors_.size() && sleeping;
+           ++j) {
+        const std::size_t neighborNo = agent->agentNeighbors_[j].second;
+        sleeping = neighborNo >= agents_.size() ||
+                   agents_[neighborNo]->stationary_;
+      }
+
+      if (sleeping) {
+        agent->sleeping_ = true;
+        agentVelocities_[i] = Vector2();
+      }
+    }
+  }
+
+  /* Separate pass so that agents put to sleep above are woken again if a
+   * moving agent has them as neighbors. */
+  for (std::size_t i = 0U; i < agents_.size(); ++i) {
+    const Agent *const agent = agents_[i];
+
+    if (!agent->stationary_) {
+      for (std::size_t j = 0U; j < agent->agentNeighbors_.size(); ++j) {
+        const std::size_t neighborNo = agent->agentNeighbors_[j].second;
+
+        if (neighborNo < agents_.size()) {
+          wakeAgent(neighborNo);
+        }
+      }
+    }
+  }
+}
+
+void RVOSimulator::updateAgentsTask(std::size_t begin, std::size_t end,
+                                    std::size_t threadNo, void *simulator) {
+  RVOSimulator *const sim = static_cast<RVOSimulator *>(simulator);
+  const float sleepThresholdSq =
+      sim->agentSleepThreshold_ * sim->agentSleepThreshold_;
+  static_cast<void>(threadNo);
+
+  for (std::size_t i = begin; i < end; ++i) {
+    Agent *const agent = sim->agents_[i];
+
+    if (!agent->sleeping_) {
+      agent->update(sim->timeStep_);
+      agent->stationary_ =
+          absSq(sim->agentVelocities_[i]) < sleepThresholdSq &&
+          absSq(sim->agentPrefVelocities_[i]) < sleepThresholdSq;
+    }
+  }
+}
+
+void RVOSimulator::waitStep() {
+  if (stepPending_) {
+    stepThread_->wait();
+    stepPending_ = false;
+
+    for (std::size_t i = 0U; i < frontAgentHandles_.size(); ++i) {
+      setAgentPrefVelocity(agentNos_[frontAgentHandles_[i]],
+                           frontAgentPrefVelocities_[i]);
+    }
+  }
+}
+
+void RVOSimulator::wakeAgent(std::size_t agentNo) {
+  /* The ghost agents of a region are never stepped. */
+  agents_[agentNo]->sleeping_ = agents_[agentNo]->ghost_;
 }
 } /* namespace RVO */
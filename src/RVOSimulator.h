@@ -40,16 +40,26 @@
  */
 
 #include <cstddef>
+#include <utility>
 #include <vector>
 
+#include "Executor.h"
 #include "Export.h"
+#include "Line.h"
+#include "ObstacleWorld.h"
+#include "StepProfile.h"
+#include "Vector2.h"
 
 namespace RVO {
 class Agent;
+class AgentGrid;
+class AgentProfile;
 class KdTree;
-class Line;
 class Obstacle;
-class Vector2;
+class RegionSimulator;
+class StepThread;
+class ThreadPool;
+class TrajectoryRecorder;
 
 /**
  * @relates RVOSimulator
@@ -58,6 +68,36 @@ class Vector2;
  */
 RVO_EXPORT extern const std::size_t RVO_ERROR;
 
+/**
+ * @relates RVOSimulator
+ * @brief   Defines the spatial data structures that may be searched for the
+ *          agent neighbors of each agent.
+ */
+enum AgentNeighborSearch {
+  /**
+   * @brief An agent k-D tree. Suitable for any distribution of agents and
+   *        neighbor distances.
+   */
+  RVO_AGENT_KD_TREE,
+
+  /**
+   * @brief A uniform grid of agents with cells as large as the largest
+   *        neighbor distance. Faster to build and query than the agent k-D
+   *        tree when agents are dense and have similar neighbor distances.
+   */
+  RVO_AGENT_GRID
+};
+
+/**
+ * @relates RVOSimulator
+ * @brief   A function called with the profile of each simulation step once
+ *          the step has completed.
+ * @param[in] profile  The profile of the simulation step.
+ * @param[in] userData The user data passed with the function to the simulator.
+ */
+typedef void (*StepProfileCallback)(const StepProfile &profile,
+                                    void *userData);
+
 /**
  * @brief Defines the simulation. The main class of the library that contains
  *        all simulation functionality.
@@ -164,6 +204,16 @@ class RVO_EXPORT RVOSimulator {
    */
   std::size_t addAgent(const Vector2 &position);
 
+  /**
+   * @brief     Adds a new agent with the properties of an agent profile to the
+   *            simulation.
+   * @param[in] position  The two-dimensional starting position of this agent.
+   * @param[in] profileNo The number of the agent profile.
+   * @return    The number of the agent, or RVO::RVO_ERROR when there is no
+   *            agent profile with the number.
+   */
+  std::size_t addAgent(const Vector2 &position, std::size_t profileNo);
+
   /**
    * @brief     Adds a new agent to the simulation.
    * @param[in] position        The two-dimensional starting position of this
@@ -198,6 +248,8 @@ class RVO_EXPORT RVOSimulator {
    * @param[in] maxSpeed        The maximum speed of this agent. Must be
    *                            non-negative.
    * @return    The number of the agent.
+   * @note      Shares an agent profile with the agents last added with the
+   *            same properties, if any. See also addAgentProfile().
    */
   std::size_t addAgent(const Vector2 &position, float neighborDist,
                        std::size_t maxNeighbors, float timeHorizon,
@@ -239,12 +291,184 @@ class RVO_EXPORT RVOSimulator {
    * @param[in] velocity        The initial two-dimensional linear velocity of
    *                            this agent.
    * @return    The number of the agent.
+   * @note      Shares an agent profile with the agents last added with the
+   *            same properties, if any. See also addAgentProfile().
    */
   std::size_t addAgent(const Vector2 &position, float neighborDist,
                        std::size_t maxNeighbors, float timeHorizon,
                        float timeHorizonObst, float radius, float maxSpeed,
                        const Vector2 &velocity);
 
+  /**
+   * @brief     Adds new agents with default properties to the simulation,
+   *            allocating storage for all of them at once.
+   * @param[in] positions An array of the two-dimensional starting positions of
+   *                      the agents.
+   * @param[in] numAgents The number of agents.
+   * @return    The number of the first agent, followed consecutively by the
+   *            others, or RVO::RVO_ERROR when the agent defaults have not been
+   *            set.
+   */
+  std::size_t addAgents(const Vector2 *positions, std::size_t numAgents);
+
+  /**
+   * @brief     Adds new agents with the properties of an agent profile to the
+   *            simulation, allocating storage for all of them at once.
+   * @param[in] positions An array of the two-dimensional starting positions of
+   *                      the agents.
+   * @param[in] numAgents The number of agents.
+   * @param[in] profileNo The number of the agent profile.
+   * @return    The number of the first agent, followed consecutively by the
+   *            others, or RVO::RVO_ERROR when there is no agent profile with
+   *            the number.
+   */
+  std::size_t addAgents(const Vector2 *positions, std::size_t numAgents,
+                        std::size_t profileNo);
+
+  /**
+   * @brief     Adds new agents to the simulation, allocating storage for all
+   *            of them at once.
+   * @param[in] positions       An array of the two-dimensional starting
+   *                            positions of the agents.
+   * @param[in] numAgents       The number of agents.
+   * @param[in] neighborDist    The maximum distance center-point to
+   *                            center-point to other agents these agents take
+   *                            into account in the navigation. The larger this
+   *                            number, the longer the running time of the
+   *                            simulation. If the number is too low, the
+   *                            simulation will not be safe. Must be
+   *                            non-negative.
+   * @param[in] maxNeighbors    The maximum number of other agents these agents
+   *                            take into account in the navigation. The larger
+   *                            this number, the longer the running time of the
+   *                            simulation. If the number is too low, the
+   *                            simulation will not be safe.
+   * @param[in] timeHorizon     The minimal amount of time for which these
+   *                            agents' velocities that are computed by the
+   *                            simulation are safe with respect to other
+   *                            agents. The larger this number, the sooner these
+   *                            agents will respond to the presence of other
+   *                            agents, but the less freedom these agents have
+   *                            in choosing their velocities. Must be positive.
+   * @param[in] timeHorizonObst The minimal amount of time for which these
+   *                            agents' velocities that are computed by the
+   *                            simulation are safe with respect to obstacles.
+   *                            The larger this number, the sooner these agents
+   *                            will respond to the presence of obstacles, but
+   *                            the less freedom these agents have in choosing
+   *                            their velocities. Must be positive.
+   * @param[in] radius          The radius of these agents. Must be
+   *                            non-negative.
+   * @param[in] maxSpeed        The maximum speed of these agents. Must be
+   *                            non-negative.
+   * @return    The number of the first agent, followed consecutively by the
+   *            others.
+   * @note      Shares an agent profile with the agents last added with the
+   *            same properties, if any. See also addAgentProfile().
+   */
+  std::size_t addAgents(const Vector2 *positions, std::size_t numAgents,
+                        float neighborDist, std::size_t maxNeighbors,
+                        float timeHorizon, float timeHorizonObst, float radius,
+                        float maxSpeed);
+
+  /**
+   * @brief     Adds new agents to the simulation, allocating storage for all
+   *            of them at once.
+   * @param[in] positions       An array of the two-dimensional starting
+   *                            positions of the agents.
+   * @param[in] numAgents       The number of agents.
+   * @param[in] neighborDist    The maximum distance center-point to
+   *                            center-point to other agents these agents take
+   *                            into account in the navigation. The larger this
+   *                            number, the longer the running time of the
+   *                            simulation. If the number is too low, the
+   *                            simulation will not be safe. Must be
+   *                            non-negative.
+   * @param[in] maxNeighbors    The maximum number of other agents these agents
+   *                            take into account in the navigation. The larger
+   *                            this number, the longer the running time of the
+   *                            simulation. If the number is too low, the
+   *                            simulation will not be safe.
+   * @param[in] timeHorizon     The minimal amount of time for which these
+   *                            agents' velocities that are computed by the
+   *                            simulation are safe with respect to other
+   *                            agents. The larger this number, the sooner these
+   *                            agents will respond to the presence of other
+   *                            agents, but the less freedom these agents have
+   *                            in choosing their velocities. Must be positive.
+   * @param[in] timeHorizonObst The minimal amount of time for which these
+   *                            agents' velocities that are computed by the
+   *                            simulation are safe with respect to obstacles.
+   *                            The larger this number, the sooner these agents
+   *                            will respond to the presence of obstacles, but
+   *                            the less freedom these agents have in choosing
+   *                            their velocities. Must be positive.
+   * @param[in] radius          The radius of these agents. Must be
+   *                            non-negative.
+   * @param[in] maxSpeed        The maximum speed of these agents. Must be
+   *                            non-negative.
+   * @param[in] velocity        The initial two-dimensional linear velocity of
+   *                            these agents.
+   * @return    The number of the first agent, followed consecutively by the
+   *            others.
+   * @note      Shares an agent profile with the agents last added with the
+   *            same properties, if any. See also addAgentProfile().
+   */
+  std::size_t addAgents(const Vector2 *positions, std::size_t numAgents,
+                        float neighborDist, std::size_t maxNeighbors,
+                        float timeHorizon, float timeHorizonObst, float radius,
+                        float maxSpeed, const Vector2 &velocity);
+
+  /**
+   * @brief     Adds a new agent profile to the simulation, a set of properties
+   *            shared by the agents that are assigned it, so that changing it
+   *            changes all of them at once.
+   * @param[in] neighborDist    The maximum distance center-point to
+   *                            center-point to other agents an agent takes
+   *                            into account in the navigation. Must be
+   *                            non-negative.
+   * @param[in] maxNeighbors    The maximum number of other agents an agent
+   *                            takes into account in the navigation.
+   * @param[in] timeHorizon     The minimal amount of time for which the
+   *                            velocities of an agent that are computed by the
+   *                            simulation are safe with respect to other
+   *                            agents. Must be positive.
+   * @param[in] timeHorizonObst The minimal amount of time for which the
+   *                            velocities of an agent that are computed by the
+   *                            simulation are safe with respect to obstacles.
+   *                            Must be positive.
+   * @param[in] radius          The radius of an agent. Must be non-negative.
+   * @param[in] maxSpeed        The maximum speed of an agent. Must be
+   *                            non-negative.
+   * @return    The number of the agent profile.
+   * @note      Setting a property of an agent with a setter such as
+   *            setAgentRadius() gives the agent a copy of its profile, which is
+   *            no longer shared.
+   */
+  std::size_t addAgentProfile(float neighborDist, std::size_t maxNeighbors,
+                              float timeHorizon, float timeHorizonObst,
+                              float radius, float maxSpeed);
+
+  /**
+   * @brief     Adds a new dynamic obstacle to the simulation. Unlike other
+   *            obstacles, dynamic obstacles need not be processed and may be
+   *            changed or removed at any time.
+   * @param[in] vertices List of the vertices of the polygonal obstacle in
+   *                     counterclockwise order.
+   * @return    The number of the dynamic obstacle, or RVO::RVO_ERROR when the
+   *            number of vertices is less than two.
+   * @note      Dynamic obstacles are searched through a bounding volume
+   *            hierarchy of their bounds, which is rebuilt by the next call
+   *            to doStep() or buildAgentTree() after any of them changes.
+   *            Until then, queryVisibility() does not account for the
+   *            change. Dynamic obstacles suit doors, vehicles, and other
+   *            obstacles that are few compared to the static ones or that
+   *            change every few seconds. Their vertices follow the static
+   *            obstacle vertices, and are renumbered whenever a dynamic
+   *            obstacle changes.
+   */
+  std::size_t addDynamicObstacle(const std::vector<Vector2> &vertices);
+
   /**
    * @brief     Adds a new obstacle to the simulation.
    * @param[in] vertices List of the vertices of the polygonal obstacle in
@@ -257,12 +481,74 @@ class RVO_EXPORT RVOSimulator {
    */
   std::size_t addObstacle(const std::vector<Vector2> &vertices);
 
+  /**
+   * @brief Starts a simulation step, as doStep() would, on a background thread
+   *        and returns at once, so that the host may draw the present frame
+   *        and prepare the next one while the step runs.
+   * @note  Until waitStep(), getAgentPosition(), getAgentPositions(),
+   *        getAgentPositionBuffer(), getAgentVelocity(), getAgentVelocities(),
+   *        getAgentVelocityBuffer(), getAgentPrefVelocity(), getGlobalTime(),
+   *        and getNumAgents() return the state as of the start of the step, and
+   *        setAgentPrefVelocity() and setAgentPrefVelocities() set the
+   *        preferred velocities of the next step. Other functions that only
+   *        query agent parameters or obstacles may be called unless agents
+   *        are sorted automatically or dynamic obstacles have changed. No
+   *        other function may be called. Waits for the previous step, if
+   *        any, first.
+   */
+  void beginStepAsync();
+
+  /**
+   * @brief Builds the spatial data structure searched for agent neighbors, the
+   *        agent k-D tree or the agent grid, from the present positions of the
+   *        agents. The first phase of a simulation step.
+   */
+  void buildAgentTree();
+
+  /**
+   * @brief Computes the agent and obstacle neighbors of each agent. The second
+   *        phase of a simulation step.
+   * @note  Requires that buildAgentTree() has been called since the agents
+   *        last moved.
+   */
+  void computeAgentNeighbors();
+
+  /**
+   * @brief Computes the new two-dimensional velocity of each agent from its
+   *        neighbors. The third phase of a simulation step.
+   * @note  Requires that computeAgentNeighbors() has been called since the
+   *        agents last moved.
+   */
+  void computeAgentNewVelocities();
+
   /**
    * @brief Lets the simulator perform a simulation step and updates the
    *        two-dimensional position and two-dimensional velocity of each agent.
+   * @note  Equivalent to calling buildAgentTree(), computeAgentNeighbors(),
+   *        computeAgentNewVelocities(), and updateAgents() in order, which may
+   *        be called separately to time or interleave the phases.
    */
   void doStep();
 
+  /**
+   * @brief     Lets the simulator perform the specified number of simulation
+   *            steps, reusing the agent k-D tree or agent grid and candidate
+   *            agent neighbors across the steps. The candidates of each agent
+   *            are the agents within its neighbor distance plus the agent
+   *            neighbor skin, from which its agent neighbors are selected at
+   *            each step. The candidates are computed again, along with the
+   *            agent k-D tree or agent grid, once any agent has moved more
+   *            than half the skin since they were computed, or a sleeping
+   *            agent wakes.
+   * @param[in] numSubSteps The number of simulation steps, each of the time
+   *                        step of the simulation.
+   * @note      Selects the same agent neighbors as calling doStep()
+   *            numSubSteps times, other than for ties in their distances
+   *            when not deterministic, and is equivalent to doing so when the
+   *            agent neighbor skin is zero.
+   */
+  void doStep(std::size_t numSubSteps);
+
   /**
    * @brief     Returns the specified agent neighbor of the specified agent.
    * @param[in] agentNo    The number of the agent whose agent neighbor is to be
@@ -273,6 +559,18 @@ class RVO_EXPORT RVOSimulator {
   std::size_t getAgentAgentNeighbor(std::size_t agentNo,
                                     std::size_t neighborNo) const;
 
+  /**
+   * @brief     Returns the handle of a specified agent, which unlike its number
+   *            is unchanged when other agents are removed.
+   * @param[in] agentNo The number of the agent whose handle is to be
+   *                    retrieved.
+   * @return    The handle of the agent. Equal to the number of the agent until
+   *            an agent is first removed or the agents are first sorted.
+   */
+  std::size_t getAgentHandle(std::size_t agentNo) const {
+    return agentHandles_[agentNo];
+  }
+
   /**
    * @brief     Returns the maximum neighbor count of a specified agent.
    * @param[in] agentNo The number of the agent whose maximum neighbor count is
@@ -297,6 +595,42 @@ class RVO_EXPORT RVOSimulator {
    */
   float getAgentNeighborDist(std::size_t agentNo) const;
 
+  /**
+   * @brief  Returns whether the agent neighbors of each agent are selected
+   *         with a bounded max-heap rather than by insertion sort.
+   * @return True if agent neighbors are selected with a bounded max-heap.
+   */
+  bool getAgentNeighborHeap() const { return agentNeighborHeap_; }
+
+  /**
+   * @brief  Returns the spatial data structure that is searched for the agent
+   *         neighbors of each agent.
+   * @return The spatial data structure searched for agent neighbors.
+   */
+  AgentNeighborSearch getAgentNeighborSearch() const {
+    return agentNeighborSearch_;
+  }
+
+  /**
+   * @brief  Returns the margin added to the neighbor distance of each agent for
+   *         its candidate agent neighbors when sub-stepping.
+   * @return The present agent neighbor skin.
+   */
+  float getAgentNeighborSkin() const { return agentNeighborSkin_; }
+
+  /**
+   * @brief     Returns the present number of the agent with a specified handle.
+   * @param[in] agentHandle The handle of the agent whose number is to be
+   *                        retrieved.
+   * @return    The number of the agent, or RVO::RVO_ERROR when no agent has the
+   *            handle.
+   * @note      The handle of a removed agent may be reused by an agent added
+   *            later.
+   */
+  std::size_t getAgentNo(std::size_t agentHandle) const {
+    return agentHandle < agentNos_.size() ? agentNos_[agentHandle] : RVO_ERROR;
+  }
+
   /**
    * @brief     Returns the count of agent neighbors taken into account to
    *            compute the current velocity for the specified agent.
@@ -357,6 +691,29 @@ class RVO_EXPORT RVOSimulator {
    */
   const Vector2 &getAgentPosition(std::size_t agentNo) const;
 
+  /**
+   * @brief      Copies the two-dimensional positions of all agents.
+   * @param[out] positions An array of at least getNumAgents() elements that
+   *                       receives the present two-dimensional position of the
+   *                       center of each agent, ordered by agent number.
+   */
+  void getAgentPositions(Vector2 *positions) const;
+
+  /**
+   * @brief  Returns a read-only view of the two-dimensional positions of all
+   *         agents.
+   * @return A pointer to a contiguous array of getNumAgents() positions,
+   *         ordered by agent number, or NULL when there are no agents.
+   * @note   Each element consists of two floats, the x-coordinate followed by
+   *         the y-coordinate, so the array may be uploaded directly to a
+   *         renderer. The pointer is invalidated when agents are added.
+   */
+  const Vector2 *getAgentPositionBuffer() const {
+    const std::vector<Vector2> &positions =
+        stepPending_ ? frontAgentPositions_ : agentPositions_;
+    return positions.empty() ? NULL : &positions.front();
+  }
+
   /**
    * @brief     Returns the two-dimensional preferred velocity of a specified
    *            agent.
@@ -373,6 +730,29 @@ class RVO_EXPORT RVOSimulator {
    */
   float getAgentRadius(std::size_t agentNo) const;
 
+  /**
+   * @brief     Returns whether a specified agent is asleep.
+   * @param[in] agentNo The number of the agent whose sleep state is to be
+   *                    retrieved.
+   * @return    True if the agent is asleep and skipped by simulation steps.
+   */
+  bool getAgentSleeping(std::size_t agentNo) const;
+
+  /**
+   * @brief  Returns the speed below which stationary agents fall asleep.
+   * @return The present sleep threshold of the agents, or zero if agents
+   *         never fall asleep.
+   */
+  float getAgentSleepThreshold() const { return agentSleepThreshold_; }
+
+  /**
+   * @brief  Returns the number of simulation steps between which the agents
+   *         are sorted automatically.
+   * @return The number of simulation steps, or zero if the agents are never
+   *         sorted automatically.
+   */
+  std::size_t getAgentSortInterval() const { return agentSortInterval_; }
+
   /**
    * @brief     Returns the time horizon of a specified agent.
    * @param[in] agentNo The number of the agent whose time horizon is to be
@@ -390,6 +770,20 @@ class RVO_EXPORT RVOSimulator {
    */
   float getAgentTimeHorizonObst(std::size_t agentNo) const;
 
+  /**
+   * @brief  Returns whether the agent k-D tree is refit rather than rebuilt at
+   *         each simulation step.
+   * @return True if the agent k-D tree is refit; false if it is rebuilt.
+   */
+  bool getAgentTreeRefit() const;
+
+  /**
+   * @brief  Returns the growth factor of the bounds of an agent k-D tree node
+   *         past which the node is rebuilt when refitting.
+   * @return The present refit threshold of the agent k-D tree.
+   */
+  float getAgentTreeRefitThreshold() const;
+
   /**
    * @brief     Returns the two-dimensional linear velocity of a specified
    *            agent.
@@ -399,23 +793,80 @@ class RVO_EXPORT RVOSimulator {
    */
   const Vector2 &getAgentVelocity(std::size_t agentNo) const;
 
+  /**
+   * @brief      Copies the two-dimensional linear velocities of all agents.
+   * @param[out] velocities An array of at least getNumAgents() elements that
+   *                        receives the present two-dimensional linear velocity
+   *                        of each agent, ordered by agent number.
+   */
+  void getAgentVelocities(Vector2 *velocities) const;
+
+  /**
+   * @brief  Returns a read-only view of the two-dimensional linear velocities
+   *         of all agents.
+   * @return A pointer to a contiguous array of getNumAgents() velocities,
+   *         ordered by agent number, or NULL when there are no agents.
+   * @note   The pointer is invalidated when agents are added.
+   */
+  const Vector2 *getAgentVelocityBuffer() const {
+    const std::vector<Vector2> &velocities =
+        stepPending_ ? frontAgentVelocities_ : agentVelocities_;
+    return velocities.empty() ? NULL : &velocities.front();
+  }
+
+  /**
+   * @brief  Returns whether agent neighbors at equal distances are selected
+   *         and ordered deterministically by agent number.
+   * @return True if ties between agent neighbors are broken by agent number.
+   */
+  bool getDeterministic() const { return deterministic_; }
+
   /**
    * @brief  Returns the global time of the simulation.
    * @return The present global time of the simulation (zero initially).
    */
-  float getGlobalTime() const { return globalTime_; }
+  float getGlobalTime() const {
+    return stepPending_ ? frontGlobalTime_ : globalTime_;
+  }
 
   /**
    * @brief  Returns the count of agents in the simulation.
    * @return The count of agents in the simulation.
    */
-  std::size_t getNumAgents() const { return agents_.size(); }
+  std::size_t getNumAgents() const {
+    return stepPending_ ? frontAgentHandles_.size() : agents_.size();
+  }
 
   /**
    * @brief  Returns the count of obstacle vertices in the simulation.
    * @return The count of obstacle vertices in the simulation.
    */
-  std::size_t getNumObstacleVertices() const { return obstacles_.size(); }
+  std::size_t getNumObstacleVertices() const;
+
+  /**
+   * @brief  Returns the number of threads that the parallel loops of a
+   *         simulation step may use.
+   * @return The number of threads.
+   */
+  std::size_t getNumThreads() const;
+
+  /**
+   * @brief  Returns the number of split candidates evaluated at each node when
+   *         building the obstacle k-D tree.
+   * @return The number of split candidates, or zero if every obstacle edge of
+   *         a node is evaluated.
+   */
+  std::size_t getObstacleTreeSplitCandidates() const;
+
+  /**
+   * @brief  Returns the static obstacles of the simulation, the obstacle
+   *         vertices and the obstacle k-D tree, to be shared with other
+   *         simulations by setObstacleWorld() rather than processed by each.
+   * @return A pointer to the obstacle world of the simulation, with a
+   *         reference added that the caller must release.
+   * @note   Excludes the dynamic obstacles. Call processObstacles() first.
+   */
+  ObstacleWorld *getObstacleWorld();
 
   /**
    * @brief     Returns the two-dimensional position of a specified obstacle
@@ -445,12 +896,44 @@ class RVO_EXPORT RVOSimulator {
    */
   std::size_t getPrevObstacleVertexNo(std::size_t vertexNo) const;
 
+  /**
+   * @brief  Returns the profile of the most recent simulation step. Started
+   *         by buildAgentTree() and completed by updateAgents().
+   * @return The wall time of each phase of the most recent simulation step and
+   *         counts of the work done by the phases. All zero unless the library
+   *         is built with RVO_ENABLE_PROFILING defined.
+   */
+  const StepProfile &getStepProfile() const { return stepProfile_; }
+
   /**
    * @brief  Returns the time step of the simulation.
    * @return The present time step of the simulation.
    */
   float getTimeStep() const { return timeStep_; }
 
+  /**
+   * @brief  Returns the trajectory recorder that records each step of the
+   *         simulation.
+   * @return The trajectory recorder, or NULL if there is none.
+   */
+  TrajectoryRecorder *getTrajectoryRecorder() const {
+    return trajectoryRecorder_;
+  }
+
+  /**
+   * @brief     Replaces the obstacles in the simulation with obstacles saved
+   *            by saveObstacles(), without processing them again.
+   * @param[in] data A pointer to the saved data, such as a memory-mapped file.
+   * @param[in] size The size in bytes of the saved data.
+   * @return    True if the obstacles were restored; false if the data is not
+   *            valid saved obstacle data of the present version, in which case
+   *            the obstacles in the simulation are unchanged.
+   * @note      The data is copied, so it need not outlive this call. Restored
+   *            obstacles are accounted for in the simulation if they had been
+   *            processed when they were saved.
+   */
+  bool loadObstacles(const void *data, std::size_t size);
+
   /**
    * @brief Processes the obstacles that have been added so that they are
    *        accounted for in the simulation.
@@ -485,6 +968,95 @@ class RVO_EXPORT RVOSimulator {
   bool queryVisibility(const Vector2 &point1, const Vector2 &point2,
                        float radius) const;
 
+  /**
+   * @brief      Performs visibility queries between the endpoints of each of
+   *             the specified segments with respect to the obstacles, in
+   *             parallel when the library is built with OpenMP.
+   * @param[in]  segments    An array of the pairs of points between which
+   *                         visibility is to be queried.
+   * @param[in]  numSegments The number of segments.
+   * @param[in]  radius      The minimal distance between the line connecting
+   *                         the two points of a segment and the obstacles in
+   *                         order for the points to be mutually visible. Must
+   *                         be non-negative.
+   * @param[out] visible     An array of at least numSegments elements that
+   *                         receives whether the two points of each segment
+   *                         are mutually visible.
+   * @note       Gives the same results as queryVisibility() for each segment.
+   *             Consecutive segments traverse the obstacle k-D tree together
+   *             in packets, so the queries are fastest when segments that are
+   *             close to one another are consecutive.
+   */
+  void queryVisibility(const std::pair<Vector2, Vector2> *segments,
+                       std::size_t numSegments, float radius,
+                       bool *visible) const;
+
+  /**
+   * @brief     Removes a specified agent from the simulation in constant time.
+   *            The agent numbered getNumAgents() - 1 takes the number of the
+   *            removed agent. The numbers of all other agents are unchanged,
+   *            as are the handles of all remaining agents.
+   * @param[in] agentNo The number of the agent to be removed.
+   * @note      Agent neighbors and ORCA lines refer to agent numbers as of the
+   *            most recent simulation step until the next one. The agent k-D
+   *            tree is rebuilt in full in the next simulation step.
+   */
+  void removeAgent(std::size_t agentNo);
+
+  /**
+   * @brief     Removes a specified dynamic obstacle from the simulation, from
+   *            the next simulation step.
+   * @param[in] dynamicObstacleNo The number of the dynamic obstacle to be
+   *                              removed.
+   * @note      The number of the removed dynamic obstacle may be reused by a
+   *            dynamic obstacle added later. Until the next call to doStep()
+   *            or buildAgentTree(), queryVisibility() still accounts for the
+   *            removed dynamic obstacle.
+   */
+  void removeDynamicObstacle(std::size_t dynamicObstacleNo);
+
+  /**
+   * @brief     Restores the state of the agents in the simulation from a
+   *            snapshot taken by snapshot() or snapshotDelta(). Waits for any
+   *            pending asynchronous simulation step first.
+   * @param[in] data A pointer to the snapshot.
+   * @param[in] size The size in bytes of the snapshot.
+   * @return    True if the state was restored; false if the data is not a
+   *            valid snapshot of the present version for the agents in the
+   *            simulation, in which case their state is unchanged.
+   * @note      Restores the positions, velocities, preferred velocities, and
+   *            sleeping state of the agents, their numbers, and the global
+   *            time. The agents must be those in the simulation when the
+   *            snapshot was taken, and a snapshot from snapshotDelta() must be
+   *            restored on top of the state of its base snapshot, as after
+   *            restoring the base. The obstacles and the properties of the
+   *            agents are left untouched. Agent neighbors and ORCA lines are
+   *            stale until the next simulation step, which rebuilds the agent
+   *            k-D tree in full. Steps after restoring a snapshot give the
+   *            same results each time it is restored; they also match the
+   *            steps that followed the snapshot, except that agent neighbors
+   *            at equal distances may be ordered differently unless ties are
+   *            broken by setDeterministic() and the agent k-D tree is not
+   *            refitted.
+   */
+  bool restore(const void *data, std::size_t size);
+
+  /**
+   * @brief     Saves the obstacles in the simulation, in a versioned binary
+   *            format, for loadObstacles() to restore without processing them
+   *            again.
+   * @param[in] data A pointer to a buffer that receives the saved data, or NULL
+   *                 to only query its size.
+   * @param[in] size The size in bytes of the buffer.
+   * @return    The size in bytes of the saved data. Nothing is written unless
+   *            the buffer is at least that large.
+   * @note      Once the obstacles have been processed, the saved data includes
+   *            the obstacle vertices added by splitting and the obstacle k-D
+   *            tree. The format is little-endian and its fields are aligned to
+   *            their size, so that it can be memory-mapped on any platform.
+   */
+  std::size_t saveObstacles(void *data, std::size_t size) const;
+
   /**
    * @brief     Sets the default properties for any new agent that is added.
    * @param[in] neighborDist    The default maximum distance center-point to
@@ -586,6 +1158,44 @@ class RVO_EXPORT RVOSimulator {
    */
   void setAgentNeighborDist(std::size_t agentNo, float neighborDist);
 
+  /**
+   * @brief     Sets whether the agent neighbors of each agent are selected with
+   *            a bounded max-heap rather than by insertion sort. Defaults to
+   *            false.
+   * @param[in] heap True to keep the nearest agent neighbors found so far in a
+   *                 max-heap and sort them once all are found, which bounds
+   *                 the cost per accepted candidate by O(log k) rather than
+   *                 O(k) for a maximum neighbor count k. False to keep them
+   *                 sorted by insertion.
+   * @note      Both agent neighbor searches tend to find the nearest candidates
+   *            first, for which insertion is cheap, so the max-heap is usually
+   *            slower and mainly helps when candidates arrive in an adversarial
+   *            order. Agent neighbors at equal distances may be ordered
+   *            differently in the two modes.
+   */
+  void setAgentNeighborHeap(bool heap) { agentNeighborHeap_ = heap; }
+
+  /**
+   * @brief     Sets the spatial data structure that is searched for the agent
+   *            neighbors of each agent. Defaults to RVO_AGENT_KD_TREE.
+   * @param[in] neighborSearch The replacement spatial data structure searched
+   *                           for agent neighbors.
+   */
+  void setAgentNeighborSearch(AgentNeighborSearch neighborSearch) {
+    agentNeighborSearch_ = neighborSearch;
+  }
+
+  /**
+   * @brief     Sets the margin added to the neighbor distance of each agent for
+   *            its candidate agent neighbors by doStep(std::size_t). Defaults
+   *            to zero, so that every sub-step searches for agent neighbors.
+   * @param[in] skin The agent neighbor skin. Must be nonnegative. A larger skin
+   *                 lets the candidates be reused for more sub-steps, as long
+   *                 as the agents move at most half of it, at the cost of
+   *                 more candidates to select from at each sub-step.
+   */
+  void setAgentNeighborSkin(float skin) { agentNeighborSkin_ = skin; }
+
   /**
    * @brief     Sets the two-dimensional position of a specified agent.
    * @param[in] agentNo  The number of the agent whose two-dimensional position
@@ -604,6 +1214,56 @@ class RVO_EXPORT RVOSimulator {
    */
   void setAgentPrefVelocity(std::size_t agentNo, const Vector2 &prefVelocity);
 
+  /**
+   * @brief     Sets the two-dimensional preferred velocities of the first
+   *            agents in the simulation.
+   * @param[in] prefVelocities An array of replacement two-dimensional preferred
+   *                           velocities, ordered by agent number.
+   * @param[in] numAgents      The number of elements in the array. Must not
+   *                           exceed getNumAgents().
+   */
+  void setAgentPrefVelocities(const Vector2 *prefVelocities,
+                              std::size_t numAgents);
+
+  /**
+   * @brief     Assigns an agent profile to a specified agent, replacing its
+   *            present properties with those of the profile.
+   * @param[in] agentNo   The number of the agent whose agent profile is to be
+   *                      assigned.
+   * @param[in] profileNo The number of the agent profile. Nothing is done when
+   *                      there is no agent profile with the number.
+   */
+  void setAgentProfile(std::size_t agentNo, std::size_t profileNo);
+
+  /**
+   * @brief     Changes the properties of an agent profile, and so of every
+   *            agent that is assigned it.
+   * @param[in] profileNo       The number of the agent profile.
+   * @param[in] neighborDist    The maximum distance center-point to
+   *                            center-point to other agents an agent takes
+   *                            into account in the navigation. Must be
+   *                            non-negative.
+   * @param[in] maxNeighbors    The maximum number of other agents an agent
+   *                            takes into account in the navigation.
+   * @param[in] timeHorizon     The minimal amount of time for which the
+   *                            velocities of an agent that are computed by the
+   *                            simulation are safe with respect to other
+   *                            agents. Must be positive.
+   * @param[in] timeHorizonObst The minimal amount of time for which the
+   *                            velocities of an agent that are computed by the
+   *                            simulation are safe with respect to obstacles.
+   *                            Must be positive.
+   * @param[in] radius          The radius of an agent. Must be non-negative.
+   * @param[in] maxSpeed        The maximum speed of an agent. Must be
+   *                            non-negative.
+   * @note      Takes constant time. The radii and maximum speeds of the agents
+   *            are brought up to date in one pass at the next simulation step.
+   */
+  void setAgentProfileParameters(std::size_t profileNo, float neighborDist,
+                                 std::size_t maxNeighbors, float timeHorizon,
+                                 float timeHorizonObst, float radius,
+                                 float maxSpeed);
+
   /**
    * @brief     Sets the radius of a specified agent.
    * @param[in] agentNo The number of the agent whose radius is to be modified.
@@ -611,6 +1271,35 @@ class RVO_EXPORT RVOSimulator {
    */
   void setAgentRadius(std::size_t agentNo, float radius);
 
+  /**
+   * @brief     Sets the speed below which stationary agents fall asleep.
+   *            Simulation steps skip sleeping agents, which keep their
+   *            positions, but other agents still avoid them.
+   * @param[in] threshold The sleep threshold of the agents, or zero so that
+   *                      agents never fall asleep. Defaults to zero.
+   * @note      An agent falls asleep in updateAgents() when its speed and
+   *            preferred speed are below the threshold, and so are those of
+   *            each of its agent neighbors. Its velocity is set to zero. It
+   *            wakes when it becomes the agent neighbor of an agent that is
+   *            not stationary, or when its position, velocity, or preferred
+   *            velocity is set to a different value. Setting a threshold of
+   *            zero wakes every agent.
+   */
+  void setAgentSleepThreshold(float threshold);
+
+  /**
+   * @brief     Sets the number of simulation steps between which the agents
+   *            are sorted automatically by sortAgents(), from buildAgentTree().
+   * @param[in] numSteps The number of simulation steps, or zero to never sort
+   *                     the agents automatically. Defaults to zero.
+   * @note      Agents change places slowly, so every few tens of simulation
+   *            steps is usually often enough to keep their neighbors close by
+   *            in memory.
+   */
+  void setAgentSortInterval(std::size_t numSteps) {
+    agentSortInterval_ = numSteps;
+  }
+
   /**
    * @brief     Sets the time horizon of a specified agent with respect to other
    *            agents.
@@ -631,6 +1320,32 @@ class RVO_EXPORT RVOSimulator {
    */
   void setAgentTimeHorizonObst(std::size_t agentNo, float timeHorizonObst);
 
+  /**
+   * @brief     Sets whether the agent k-D tree is refit rather than rebuilt at
+   *            each simulation step.
+   * @param[in] refit True to keep the topology of the previous agent k-D tree
+   *                  and only update the bounds of its nodes, rebuilding the
+   *                  subtrees whose bounds have degraded past the refit
+   *                  threshold; false to rebuild the whole tree at each
+   *                  simulation step.
+   * @note      The agent k-D tree is always rebuilt in full after agents have
+   *            been added or removed. Refitting is cheaper than rebuilding
+   *            when agents move only a fraction of their radius per simulation
+   *            step.
+   */
+  void setAgentTreeRefit(bool refit);
+
+  /**
+   * @brief     Sets the growth factor of the bounds of an agent k-D tree node
+   *            past which the node is rebuilt when refitting.
+   * @param[in] threshold The ratio between the present half-perimeter of the
+   *                      bounds of a node and its half-perimeter when it was
+   *                      last partitioned above which the subtree of the node
+   *                      is rebuilt. Must be at least one. Lower values keep
+   *                      the tree tighter at the cost of more rebuilds.
+   */
+  void setAgentTreeRefitThreshold(float threshold);
+
   /**
    * @brief     Sets the two-dimensional linear velocity of a specified agent.
    * @param[in] agentNo  The number of the agent whose two-dimensional linear
@@ -639,12 +1354,197 @@ class RVO_EXPORT RVOSimulator {
    */
   void setAgentVelocity(std::size_t agentNo, const Vector2 &velocity);
 
+  /**
+   * @brief     Sets whether agent neighbors at equal distances are selected and
+   *            ordered deterministically by agent number. Defaults to false.
+   * @param[in] deterministic True to prefer the agent neighbor with the lower
+   *                          number among those at equal distances, both when
+   *                          choosing the nearest maximum neighbors and when
+   *                          ordering them. False to keep them in the order in
+   *                          which the agent neighbor search finds them.
+   * @note      Simulation steps give the same results for any number of
+   *            threads either way. With ties broken by agent number, they also
+   *            do not depend on the agent neighbor search nor on whether agent
+   *            neighbors are selected with a max-heap, so that simulations
+   *            replayed from the same inputs stay in lockstep. Reproducing
+   *            results across compilers and processors also requires the
+   *            library to be built with floating-point contraction disabled,
+   *            as the ENABLE_STRICT_FLOATING_POINT build option does by
+   *            default.
+   */
+  void setDeterministic(bool deterministic) { deterministic_ = deterministic; }
+
+  /**
+   * @brief     Replaces the vertices of a specified dynamic obstacle, from the
+   *            next simulation step, for instance to move it.
+   * @param[in] dynamicObstacleNo The number of the dynamic obstacle whose
+   *                              vertices are to be replaced.
+   * @param[in] vertices          List of the replacement vertices of the
+   *                              polygonal obstacle in counterclockwise
+   *                              order. At least two.
+   * @note      Until the next call to doStep() or buildAgentTree(),
+   *            queryVisibility() accounts for the previous vertices.
+   */
+  void setDynamicObstacleVertices(std::size_t dynamicObstacleNo,
+                                  const std::vector<Vector2> &vertices);
+
+  /**
+   * @brief     Sets the executor on which the parallel loops of a simulation
+   *            step run, replacing the thread pool, if any.
+   * @param[in] executor The executor, which must outlive its use by the
+   *                     simulation, or NULL to run the loops with OpenMP when
+   *                     the library is built with it, or serially otherwise.
+   */
+  void setExecutor(Executor *executor);
+
+  /**
+   * @brief     Sets the number of threads of a thread pool, owned by the
+   *            simulation, on which the parallel loops of a simulation step
+   *            run, replacing the executor, if any.
+   * @param[in] numThreads The number of threads, including the thread that
+   *                       calls doStep(), or zero to run the loops with OpenMP
+   *                       when the library is built with it, or serially
+   *                       otherwise. Defaults to zero.
+   * @note      The threads of the pool hand out ranges of agents dynamically,
+   *            so that agents with many neighbors do not leave threads idle.
+   */
+  void setNumThreads(std::size_t numThreads);
+
+  /**
+   * @brief     Replaces the static obstacles of the simulation with an
+   *            obstacle world shared with other simulations, adding a
+   *            reference to it. The dynamic obstacles are kept.
+   * @param[in] obstacleWorld The obstacle world.
+   * @note      The obstacle world is only read by simulation steps and
+   *            queries. Adding, processing, or loading obstacles, or adding
+   *            dynamic obstacles, gives the simulation a copy of its own.
+   */
+  void setObstacleWorld(ObstacleWorld *obstacleWorld);
+
+  /**
+   * @brief     Sets the number of split candidates evaluated at each node when
+   *            building the obstacle k-D tree.
+   * @param[in] numCandidates The number of obstacle edges of a node, evenly
+   *                          spaced, evaluated as its splitting line, or zero
+   *                          to evaluate every edge. Smaller values build the
+   *                          tree in time proportional to the number of
+   *                          candidates rather than to the number of edges,
+   *                          at the cost of a less balanced tree with more
+   *                          split edges.
+   * @note      Takes effect at the next call to processObstacles(). Defaults to
+   *            zero, which builds the same tree as before the option existed.
+   */
+  void setObstacleTreeSplitCandidates(std::size_t numCandidates);
+
+  /**
+   * @brief     Sets a function to be called with the profile of each
+   *            simulation step once it completes, from updateAgents().
+   * @param[in] callback The function to be called, or NULL to call none.
+   * @param[in] userData User data passed to the function.
+   * @note      Never called unless the library is built with
+   *            RVO_ENABLE_PROFILING defined.
+   */
+  void setStepProfileCallback(StepProfileCallback callback, void *userData) {
+    stepProfileCallback_ = callback;
+    stepProfileUserData_ = userData;
+  }
+
   /**
    * @brief     Sets the time step of the simulation.
    * @param[in] timeStep The time step of the simulation. Must be positive.
    */
   void setTimeStep(float timeStep) { timeStep_ = timeStep; }
 
+  /**
+   * @brief     Sets a trajectory recorder to record the agents of the
+   *            simulation as a frame once each simulation step completes,
+   *            from updateAgents(), including asynchronous steps.
+   * @param[in] recorder The trajectory recorder, which must outlive its use by
+   *                     the simulation, or NULL to record none.
+   * @note      Not to be called while an asynchronous step is pending.
+   */
+  void setTrajectoryRecorder(TrajectoryRecorder *recorder) {
+    trajectoryRecorder_ = recorder;
+  }
+
+  /**
+   * @brief     Takes a snapshot of the state of the agents in the simulation
+   *            for restore() to roll the simulation back to.
+   * @param[in] data A pointer to a buffer that receives the snapshot, or NULL
+   *                 to only query its size.
+   * @param[in] size The size in bytes of the buffer.
+   * @return    The size in bytes of the snapshot. Nothing is written unless
+   *            the buffer is at least that large.
+   * @note      The snapshot holds the positions, velocities, preferred
+   *            velocities, and sleeping state of the agents, copied as they are
+   *            laid out in memory, so it may only be restored by the same build
+   *            of the library. Must not be called while an asynchronous
+   *            simulation step is pending.
+   */
+  std::size_t snapshot(void *data, std::size_t size) const;
+
+  /**
+   * @brief     Takes a snapshot of the state of only the agents that changed
+   *            since a base snapshot taken by snapshot().
+   * @param[in] base     A pointer to the base snapshot.
+   * @param[in] baseSize The size in bytes of the base snapshot.
+   * @param[in] data     A pointer to a buffer that receives the snapshot, or
+   *                     NULL to only query its size.
+   * @param[in] size     The size in bytes of the buffer.
+   * @return    The size in bytes of the snapshot, or zero if the base is not a
+   *            valid snapshot of the agents in the simulation. Nothing is
+   *            written unless the buffer is at least that large.
+   * @note      Agents are compared bit for bit with the base, so agents that
+   *            are asleep or have not moved are left out. Must not be called
+   *            while an asynchronous simulation step is pending.
+   */
+  std::size_t snapshotDelta(const void *base, std::size_t baseSize,
+                            void *data, std::size_t size) const;
+
+  /**
+   * @brief Renumbers the agents in the order of the leaves of the agent k-D
+   *        tree, or of the cells of the agent grid, so that agents close by in
+   *        space are close by in memory and simulation steps process them
+   *        together. The handles of the agents are unchanged, and the agent
+   *        neighbors are renumbered to match.
+   * @note  Builds the spatial data structure searched for agent neighbors, as
+   *        buildAgentTree() would.
+   */
+  void sortAgents();
+
+  /**
+   * @brief     Performs a simulation step of each of a number of simulations,
+   *            as doStep() would, running the agents of all of them in the
+   *            same parallel loops so that many small simulations keep every
+   *            thread busy.
+   * @param[in] simulators    An array of pointers to distinct simulations.
+   * @param[in] numSimulators The number of simulations.
+   * @param[in] executor      The executor on which the parallel loops run,
+   *                          rather than those of the simulations, or NULL
+   *                          to run them with OpenMP when the library is
+   *                          built with it, or serially otherwise.
+   * @note      The step profile of each simulation records the time to build
+   *            its own agent k-D tree, but the times of the other phases of
+   *            all of the simulations together.
+   */
+  static void stepAll(RVOSimulator *const *simulators,
+                      std::size_t numSimulators, Executor *executor);
+
+  /**
+   * @brief Updates the two-dimensional position and two-dimensional velocity
+   *        of each agent from its new velocity and advances the global time
+   *        by the time step. The last phase of a simulation step. Calls the
+   *        step profile callback, if any.
+   */
+  void updateAgents();
+
+  /**
+   * @brief Waits for the simulation step started by beginStepAsync(), if any,
+   *        to complete, then applies the preferred velocities set meanwhile
+   *        by the handles of the agents, since the step may have sorted them.
+   */
+  void waitStep();
+
  private:
   /* Not implemented. */
   RVOSimulator(const RVOSimulator &other);
@@ -652,14 +1552,283 @@ class RVO_EXPORT RVOSimulator {
   /* Not implemented. */
   RVOSimulator &operator=(const RVOSimulator &other);
 
+  /**
+   * @brief     Performs a simulation step. The function of the step thread of
+   *            beginStepAsync().
+   * @param[in] simulator The simulation.
+   */
+  static void doStepAsync(void *simulator);
+
+  /**
+   * @brief     Assigns a handle to a new agent, reusing the handle of a removed
+   *            agent when there is one.
+   * @param[in] agentNo The number of the new agent.
+   */
+  void addAgentHandle(std::size_t agentNo);
+
+  /**
+   * @brief     Appends the vertices of a polygonal obstacle to the obstacle
+   *            vertices.
+   * @param[in] vertices List of the vertices of the polygonal obstacle in
+   *                     counterclockwise order. At least two.
+   */
+  void addObstacleVertices(const std::vector<Vector2> &vertices);
+
+  /**
+   * @brief     Adds agents that reference an agent profile.
+   * @param[in] positions The two-dimensional starting positions of the agents.
+   * @param[in] numAgents The number of agents.
+   * @param[in] profileNo The number of the agent profile.
+   * @param[in] velocity  The initial two-dimensional linear velocity of the
+   *                      agents.
+   * @return    The number of the first agent.
+   */
+  std::size_t addProfileAgents(const Vector2 *positions, std::size_t numAgents,
+                               std::size_t profileNo, const Vector2 &velocity);
+
+  /**
+   * @brief     Allocates contiguous storage for a number of agents and adds it
+   *            to the free agent storage.
+   * @param[in] numAgents The number of agents.
+   */
+  void allocateAgents(std::size_t numAgents);
+
+  /**
+   * @brief Replaces the dynamic obstacle vertices, which follow the static
+   *        obstacle vertices, and rebuilds their bounding volume hierarchy if
+   *        any dynamic obstacle changed.
+   */
+  void buildDynamicObstacles();
+
+  /**
+   * @brief Removes the dynamic obstacle vertices, so that static obstacle
+   *        vertices may be appended, until the next simulation step.
+   */
+  void clearDynamicObstacles();
+
+  /**
+   * @brief     Computes the neighbors of a range of agents. The task of the
+   *            parallel loop of computeAgentNeighbors().
+   * @param[in] begin     The number of the first agent of the range.
+   * @param[in] end       One past the number of the last agent of the range.
+   * @param[in] threadNo  The number of the calling thread.
+   * @param[in] simulator The simulation.
+   */
+  static void computeAgentNeighborsTask(std::size_t begin, std::size_t end,
+                                        std::size_t threadNo, void *simulator);
+
+  /**
+   * @brief     Computes the new velocities of a range of agents. The task of
+   *            the parallel loop of computeAgentNewVelocities().
+   * @param[in] begin     The number of the first agent of the range.
+   * @param[in] end       One past the number of the last agent of the range.
+   * @param[in] threadNo  The number of the calling thread.
+   * @param[in] simulator The simulation.
+   */
+  static void computeAgentNewVelocitiesTask(std::size_t begin, std::size_t end,
+                                            std::size_t threadNo,
+                                            void *simulator);
+
+  /**
+   * @brief     Replaces the agent profile of a specified agent with a copy of
+   *            its own if it is shared, so that it may be modified.
+   * @param[in] agentNo The number of the agent.
+   * @return    The agent profile of the agent, no longer shared.
+   */
+  AgentProfile &detachAgentProfile(std::size_t agentNo);
+
+  /**
+   * @brief Replaces the obstacle world with a copy of its own if it is shared
+   *        with other simulations, so that it may be modified.
+   */
+  void detachObstacleWorld();
+
+  /**
+   * @brief     Computes the neighbors and then the new velocities of a range
+   *            of agents. The task of the parallel loop of doStep().
+   * @param[in] begin     The number of the first agent of the range.
+   * @param[in] end       One past the number of the last agent of the range.
+   * @param[in] threadNo  The number of the calling thread.
+   * @param[in] simulator The simulation.
+   */
+  static void doStepTask(std::size_t begin, std::size_t end,
+                         std::size_t threadNo, void *simulator);
+
+#ifdef RVO_ENABLE_PROFILING
+  /**
+   * @brief Adds the counts of the work done by the agents in computing their
+   *        neighbors to the step profile.
+   */
+  void gatherAgentNeighborCounts();
+
+  /**
+   * @brief Adds the counts of the work done by the agents in computing their
+   *        new velocities to the step profile.
+   */
+  void gatherAgentNewVelocityCounts();
+#endif /* RVO_ENABLE_PROFILING */
+
+  /**
+   * @brief      Returns the order in which to renumber the agents so that they
+   *             have the handles listed in a snapshot.
+   * @param[in]  handles A pointer to the handles of the agents in the snapshot,
+   *                     one for each agent in the simulation.
+   * @param[out] order   The present numbers of the agents, listed by their
+   *                     numbers in the snapshot, or empty if they are the same.
+   * @return     True if the handles are those of the agents in the simulation.
+   */
+  bool getSnapshotOrder(
+      const unsigned char *handles,
+      std::vector<std::size_t> &order) const; /* NOLINT(runtime/references) */
+
+  /**
+   * @brief  Constructs an agent numbered after the present agents in free
+   *         agent storage, allocating more if there is none.
+   * @return A pointer to the agent.
+   */
+  Agent *newAgent();
+
+  /**
+   * @brief     Creates an agent profile without references, reusing the slot of
+   *            a released one when possible.
+   * @param[in] profile The agent profile to be copied.
+   * @return    The number of the agent profile.
+   */
+  std::size_t newAgentProfile(const AgentProfile &profile);
+
+  /**
+   * @brief     Runs a parallel loop on an executor, or with OpenMP or serially
+   *            when there is none.
+   * @param[in] executor The executor, or NULL.
+   * @param[in] numItems The number of items.
+   * @param[in] task     The function to be called on each range of items.
+   * @param[in] userData User data passed to the function.
+   */
+  static void parallelFor(Executor *executor, std::size_t numItems,
+                          Executor::Task task, void *userData);
+
+  /**
+   * @brief     Renumbers the agents in a specified order.
+   * @param[in] order The present numbers of the agents, listed by their new
+   *                  numbers.
+   */
+  void reorderAgents(const std::vector<std::size_t> &order);
+
+  /**
+   * @brief     Releases a reference to an agent profile, freeing its slot if
+   *            no reference remains.
+   * @param[in] profileNo The number of the agent profile.
+   */
+  void releaseAgentProfile(std::size_t profileNo);
+
+  /**
+   * @brief     Reserves capacity for a total number of agents in the agent
+   *            arrays of the simulator and the agent k-D tree, and allocates
+   *            storage for the agents.
+   * @param[in] numAgents The total number of agents.
+   */
+  void reserveAgents(std::size_t numAgents);
+
+  /**
+   * @brief Computes the agent and obstacle neighbors and the new velocity of
+   *        each agent, then updates the agents. The phases of a simulation
+   *        step after buildAgentTree().
+   */
+  void stepAgents();
+
+  /**
+   * @brief     Runs a task of a parallel loop of a simulation step on a range
+   *            of the agents of the simulations of stepAll(), numbered in
+   *            order of the simulations. The task of its parallel loops.
+   * @param[in] begin    The number of the first agent of the range.
+   * @param[in] end      One past the number of the last agent of the range.
+   * @param[in] threadNo The number of the calling thread.
+   * @param[in] steps    The simulations and the task.
+   */
+  static void stepAllTask(std::size_t begin, std::size_t end,
+                          std::size_t threadNo, void *steps);
+
+  /**
+   * @brief Puts to sleep the stationary agents whose agent neighbors are all
+   *        stationary, then wakes the sleeping agent neighbors of the agents
+   *        that are not.
+   */
+  void updateAgentSleep();
+
+  /**
+   * @brief     Updates the positions and velocities of a range of agents. The
+   *            task of the parallel loop of updateAgents().
+   * @param[in] begin     The number of the first agent of the range.
+   * @param[in] end       One past the number of the last agent of the range.
+   * @param[in] threadNo  The number of the calling thread.
+   * @param[in] simulator The simulation.
+   */
+  static void updateAgentsTask(std::size_t begin, std::size_t end,
+                               std::size_t threadNo, void *simulator);
+
+  /**
+   * @brief     Wakes a sleeping agent, so that it is stepped again.
+   * @param[in] agentNo The number of the agent to be woken.
+   */
+  void wakeAgent(std::size_t agentNo);
+
   std::vector<Agent *> agents_;
-  std::vector<Obstacle *> obstacles_;
-  Agent *defaultAgent_;
+  std::vector<Vector2> agentCandidatePositions_;
+  std::vector<Vector2> agentPositions_;
+  std::vector<Vector2> agentPrefVelocities_;
+  std::vector<Vector2> agentVelocities_;
+  std::vector<float> agentMaxSpeeds_;
+  std::vector<float> agentRadii_;
+  std::vector<std::size_t> agentHandles_;
+  std::vector<std::size_t> agentNos_;
+  std::vector<std::size_t> freeAgentHandles_;
+  std::vector<AgentProfile> agentProfiles_;
+  std::vector<std::size_t> freeAgentProfiles_;
+  std::vector<void *> agentStorage_;
+  std::vector<void *> freeAgentStorage_;
+  std::vector<std::vector<Vector2> > dynamicObstacles_;
+  std::vector<std::size_t> freeDynamicObstacles_;
+  std::vector<std::vector<Line> > projLines_;
+  std::vector<Vector2> frontAgentPositions_;
+  std::vector<Vector2> frontAgentPrefVelocities_;
+  std::vector<Vector2> frontAgentVelocities_;
+  std::vector<std::size_t> frontAgentHandles_;
+  StepProfile stepProfile_;
+  StepProfileCallback stepProfileCallback_;
+  void *stepProfileUserData_;
+  std::size_t numStaticObstacleVertices_;
+  std::size_t agentSortInterval_;
+  std::size_t agentSortSteps_;
+  std::size_t defaultAgentProfileNo_;
+  std::size_t lastAgentProfileNo_;
+  Executor *executor_;
+  StepThread *stepThread_;
+  ThreadPool *threadPool_;
+  TrajectoryRecorder *trajectoryRecorder_;
+  AgentGrid *agentGrid_;
   KdTree *kdTree_;
+  ObstacleWorld *obstacleWorld_;
+  Vector2 defaultVelocity_;
+  float agentNeighborSkin_;
+  float agentSleepThreshold_;
+  float frontGlobalTime_;
   float globalTime_;
   float timeStep_;
+  AgentNeighborSearch agentNeighborSearch_;
+  bool agentCandidatesStale_;
+  bool agentNeighborHeap_;
+  bool agentProfilesChanged_;
+  bool agentTreeSerial_;
+  bool deterministic_;
+  bool dynamicObstaclesChanged_;
+  bool stepPending_;
+  bool subStepping_;
 
+  friend class Agent;
+  friend class AgentGrid;
   friend class KdTree;
+  friend class RegionSimulator;
+  friend class TrajectoryRecorder;
 };
 } /* namespace RVO */
 
@@ -0,0 +1,412 @@
+/*
+ * RegionSimulator.cc
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+/**
+ * @file  RegionSimulator.cc
+ * @brief Defines the RegionSimulator class.
+ */
+
+#include "RegionSimulator.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Agent.h"
+#include "RVOSimulator.h"
+#include "Transport.h"
+
+namespace RVO {
+namespace {
+/**
+ * @relates RegionSimulator
+ * @brief   The size in bytes of the header of the data sent to a region, the
+ *          number of agents and the number of ghost agents.
+ */
+const std::size_t RVO_REGION_DATA_HEADER_SIZE = 16U;
+
+/**
+ * @relates RegionSimulator
+ * @brief   The size in bytes of an agent handed off to a region.
+ */
+const std::size_t RVO_REGION_DATA_AGENT_SIZE = 64U;
+
+/**
+ * @relates RegionSimulator
+ * @brief   The size in bytes of a ghost agent copied to a region.
+ */
+const std::size_t RVO_REGION_DATA_GHOST_AGENT_SIZE = 32U;
+
+/**
+ * @relates RegionSimulator
+ * @brief   Reads a little-endian unsigned integer from the data sent to a
+ *          region.
+ * @param[in] data     A pointer to the integer.
+ * @param[in] numBytes The size in bytes of the integer.
+ * @return    The integer.
+ */
+std::size_t readRegionData(const unsigned char *data, std::size_t numBytes) {
+  std::size_t value = 0U;
+
+  for (std::size_t i = numBytes; i-- != 0U;) {
+    value = (value << 8U) | data[i];
+  }
+
+  return value;
+}
+
+/**
+ * @relates RegionSimulator
+ * @brief   Reads a 32-bit float from the data sent to a region.
+ * @param[in] data A pointer to the float.
+ * @return    The float.
+ */
+float readRegionData(const unsigned char *data) {
+  const unsigned int bits =
+      static_cast<unsigned int>(readRegionData(data, 4U));
+  float value = 0.0F;
+  std::memcpy(&value, &bits, sizeof(value));
+
+  return value;
+}
+
+/**
+ * @relates RegionSimulator
+ * @brief   Writes a little-endian unsigned integer to the data sent to a
+ *          region.
+ * @param[in] data     A pointer to the integer.
+ * @param[in] value    The integer.
+ * @param[in] numBytes The size in bytes of the integer.
+ */
+void writeRegionData(unsigned char *data, std::size_t value,
+                     std::size_t numBytes) {
+  for (std::size_t i = 0U; i < numBytes; ++i) {
+    data[i] = static_cast<unsigned char>(value & 0xFFU);
+    value >>= 8U;
+  }
+}
+
+/**
+ * @relates RegionSimulator
+ * @brief   Writes a 32-bit float to the data sent to a region.
+ * @param[in] data  A pointer to the float.
+ * @param[in] value The float.
+ */
+void writeRegionData(unsigned char *data, float value) {
+  unsigned int bits = 0U;
+  std::memcpy(&bits, &value, sizeof(bits));
+  writeRegionData(data, bits, 4U);
+}
+} /* namespace */
+
+RegionSimulator::RegionSimulator(RVOSimulator *simulator, Transport *transport,
+                                 const std::vector<float> &columnBounds,
+                                 const std::vector<float> &rowBounds,
+                                 float haloWidth)
+    : columnBounds_(columnBounds),
+      rowBounds_(rowBounds),
+      receiveBuffers_(transport->getNumRegions()),
+      sendBuffers_(transport->getNumRegions()),
+      simulator_(simulator),
+      transport_(transport),
+      /* Without a neighbor distance, so that ghost agents do not widen the
+       * cells of the agent grid. */
+      ghostAgentProfileNo_(
+          simulator->addAgentProfile(0.0F, 0U, 0.0F, 0.0F, 0.0F, 0.0F)),
+      regionNo_(transport->getRegionNo()),
+      haloWidth_(haloWidth) {
+  if (transport->getNumRegions() !=
+          (columnBounds.size() + 1U) * (rowBounds.size() + 1U) ||
+      regionNo_ >= transport->getNumRegions()) {
+    regionNo_ = RVO_ERROR;
+  }
+}
+
+RegionSimulator::~RegionSimulator() {}
+
+std::size_t RegionSimulator::addAgent(std::size_t agentId,
+                                      const Vector2 &position) {
+  const std::size_t agentNo = simulator_->addAgent(position);
+
+  if (agentNo != RVO_ERROR) {
+    setAgentId(agentNo, agentId);
+  }
+
+  return agentNo;
+}
+
+void RegionSimulator::doStep() {
+  exchangeAgents();
+  simulator_->doStep();
+}
+
+void RegionSimulator::exchangeAgents() {
+  simulator_->waitStep();
+
+  if (regionNo_ == RVO_ERROR) {
+    /* Sends no agents, but still takes part in the exchange so that the other
+     * regions do not wait for this one. */
+    for (std::size_t i = 0U; i < sendBuffers_.size(); ++i) {
+      sendBuffers_[i].clear();
+    }
+
+    transport_->exchange(&sendBuffers_[0], &receiveBuffers_[0]);
+
+    return;
+  }
+
+  removeGhostAgents();
+
+  const std::size_t numColumns = columnBounds_.size() + 1U;
+  std::vector<std::vector<std::size_t> > agentNos(sendBuffers_.size());
+  std::vector<std::vector<std::size_t> > ghostAgentNos(sendBuffers_.size());
+  std::vector<std::size_t> handedOffAgentNos;
+
+  for (std::size_t i = 0U; i < simulator_->getNumAgents(); ++i) {
+    const Vector2 &position = simulator_->getAgentPosition(i);
+    const std::size_t regionNo = getRegionNo(position);
+
+    /* Every region whose bounds are within the halo width of the agent, a
+     * superset of those within the halo width in Euclidean distance. */
+    const std::size_t beginColumn = static_cast<std::size_t>(
+        std::upper_bound(columnBounds_.begin(), columnBounds_.end(),
+                         position.x() - haloWidth_) -
+        columnBounds_.begin());
+    const std::size_t endColumn = static_cast<std::size_t>(
+        std::upper_bound(columnBounds_.begin(), columnBounds_.end(),
+                         position.x() + haloWidth_) -
+        columnBounds_.begin());
+    const std::size_t beginRow = static_cast<std::size_t>(
+        std::upper_bound(rowBounds_.begin(), rowBounds_.end(),
+                         position.y() - haloWidth_) -
+        rowBounds_.begin());
+    const std::size_t endRow = static_cast<std::size_t>(
+        std::upper_bound(rowBounds_.begin(), rowBounds_.end(),
+                         position.y() + haloWidth_) -
+        rowBounds_.begin());
+
+    for (std::size_t row = beginRow; row <= endRow; ++row) {
+      for (std::size_t column = beginColumn; column <= endColumn; ++column) {
+        const std::size_t ghostRegionNo = row * numColumns + column;
+
+        if (ghostRegionNo != regionNo) {
+          ghostAgentNos[ghostRegionNo].push_back(i);
+        }
+      }
+    }
+
+    if (regionNo != regionNo_) {
+      agentNos[regionNo].push_back(i);
+      handedOffAgentNos.push_back(i);
+    }
+  }
+
+  for (std::size_t i = 0U; i < sendBuffers_.size(); ++i) {
+    sendAgents(i, agentNos[i], ghostAgentNos[i]);
+  }
+
+  /* The agents handed off by this region that remain within its halo are
+   * kept as ghost agents. */
+  std::vector<unsigned char> ghostAgents;
+  ghostAgents.swap(sendBuffers_[regionNo_]);
+
+  /* In decreasing order, since removing an agent moves the last agent into
+   * its place. */
+  for (std::size_t i = handedOffAgentNos.size(); i-- != 0U;) {
+    simulator_->removeAgent(handedOffAgentNos[i]);
+  }
+
+  transport_->exchange(&sendBuffers_[0], &receiveBuffers_[0]);
+
+  for (std::size_t i = 0U; i < receiveBuffers_.size(); ++i) {
+    if (i != regionNo_) {
+      receiveAgents(receiveBuffers_[i]);
+    }
+  }
+
+  receiveAgents(ghostAgents);
+}
+
+bool RegionSimulator::getAgentGhost(std::size_t agentNo) const {
+  return simulator_->agents_[agentNo]->ghost_;
+}
+
+std::size_t RegionSimulator::getAgentId(std::size_t agentNo) const {
+  return agentIds_[simulator_->getAgentHandle(agentNo)];
+}
+
+std::size_t RegionSimulator::getRegionNo(const Vector2 &position) const {
+  const std::size_t column = static_cast<std::size_t>(
+      std::upper_bound(columnBounds_.begin(), columnBounds_.end(),
+                       position.x()) -
+      columnBounds_.begin());
+  const std::size_t row = static_cast<std::size_t>(
+      std::upper_bound(rowBounds_.begin(), rowBounds_.end(), position.y()) -
+      rowBounds_.begin());
+
+  return row * (columnBounds_.size() + 1U) + column;
+}
+
+void RegionSimulator::receiveAgents(const std::vector<unsigned char> &data) {
+  if (data.size() < RVO_REGION_DATA_HEADER_SIZE) {
+    return;
+  }
+
+  const unsigned char *in = &data[0];
+  const std::size_t numAgents = readRegionData(in, 8U);
+  const std::size_t numGhostAgents = readRegionData(in + 8U, 8U);
+  const std::size_t dataSize = data.size() - RVO_REGION_DATA_HEADER_SIZE;
+
+  if (numAgents > dataSize / RVO_REGION_DATA_AGENT_SIZE ||
+      numGhostAgents > (dataSize - numAgents * RVO_REGION_DATA_AGENT_SIZE) /
+                           RVO_REGION_DATA_GHOST_AGENT_SIZE) {
+    return;
+  }
+
+  in += RVO_REGION_DATA_HEADER_SIZE;
+
+  for (std::size_t i = 0U; i < numAgents; ++i) {
+    const std::size_t agentNo = simulator_->addAgent(
+        Vector2(readRegionData(in + 8U), readRegionData(in + 12U)),
+        readRegionData(in + 40U), readRegionData(in + 56U, 8U),
+        readRegionData(in + 44U), readRegionData(in + 48U),
+        readRegionData(in + 32U), readRegionData(in + 36U),
+        Vector2(readRegionData(in + 16U), readRegionData(in + 20U)));
+    simulator_->setAgentPrefVelocity(
+        agentNo, Vector2(readRegionData(in + 24U), readRegionData(in + 28U)));
+    setAgentId(agentNo, readRegionData(in, 8U));
+    in += RVO_REGION_DATA_AGENT_SIZE;
+  }
+
+  if (numGhostAgents == 0U) {
+    return;
+  }
+
+  /* The ghost agents share one agent profile, and are added all at once. */
+  std::vector<Vector2> positions(numGhostAgents);
+
+  for (std::size_t i = 0U; i < numGhostAgents; ++i) {
+    const unsigned char *const ghostIn =
+        in + i * RVO_REGION_DATA_GHOST_AGENT_SIZE;
+    positions[i] =
+        Vector2(readRegionData(ghostIn + 8U), readRegionData(ghostIn + 12U));
+  }
+
+  const std::size_t agentNo = simulator_->addAgents(
+      &positions[0], numGhostAgents, ghostAgentProfileNo_);
+
+  for (std::size_t i = 0U; i < numGhostAgents; ++i) {
+    Agent *const agent = simulator_->agents_[agentNo + i];
+    agent->ghost_ = true;
+    agent->sleeping_ = true;
+    simulator_->agentVelocities_[agentNo + i] =
+        Vector2(readRegionData(in + 16U), readRegionData(in + 20U));
+    simulator_->agentRadii_[agentNo + i] = readRegionData(in + 24U);
+    setAgentId(agentNo + i, readRegionData(in, 8U));
+    in += RVO_REGION_DATA_GHOST_AGENT_SIZE;
+  }
+}
+
+void RegionSimulator::removeGhostAgents() {
+  /* In decreasing order, since removing an agent moves the last agent into
+   * its place. */
+  for (std::size_t i = simulator_->getNumAgents(); i-- != 0U;) {
+    if (simulator_->agents_[i]->ghost_) {
+      simulator_->removeAgent(i);
+    }
+  }
+}
+
+void RegionSimulator::sendAgents(
+    std::size_t regionNo, const std::vector<std::size_t> &agentNos,
+    const std::vector<std::size_t> &ghostAgentNos) {
+  std::vector<unsigned char> &data = sendBuffers_[regionNo];
+  data.clear();
+
+  if (agentNos.empty() && ghostAgentNos.empty()) {
+    return;
+  }
+
+  data.resize(RVO_REGION_DATA_HEADER_SIZE +
+              agentNos.size() * RVO_REGION_DATA_AGENT_SIZE +
+              ghostAgentNos.size() * RVO_REGION_DATA_GHOST_AGENT_SIZE);
+
+  unsigned char *out = &data[0];
+  writeRegionData(out, agentNos.size(), 8U);
+  writeRegionData(out + 8U, ghostAgentNos.size(), 8U);
+  out += RVO_REGION_DATA_HEADER_SIZE;
+
+  for (std::size_t i = 0U; i < agentNos.size() + ghostAgentNos.size(); ++i) {
+    const bool ghost = i >= agentNos.size();
+    const std::size_t agentNo =
+        ghost ? ghostAgentNos[i - agentNos.size()] : agentNos[i];
+    const Vector2 &position = simulator_->getAgentPosition(agentNo);
+    const Vector2 &velocity = simulator_->getAgentVelocity(agentNo);
+
+    writeRegionData(out, getAgentId(agentNo), 8U);
+    writeRegionData(out + 8U, position.x());
+    writeRegionData(out + 12U, position.y());
+    writeRegionData(out + 16U, velocity.x());
+    writeRegionData(out + 20U, velocity.y());
+
+    if (ghost) {
+      writeRegionData(out + 24U, simulator_->getAgentRadius(agentNo));
+      writeRegionData(out + 28U, 0U, 4U);
+      out += RVO_REGION_DATA_GHOST_AGENT_SIZE;
+    } else {
+      const Vector2 &prefVelocity = simulator_->getAgentPrefVelocity(agentNo);
+
+      writeRegionData(out + 24U, prefVelocity.x());
+      writeRegionData(out + 28U, prefVelocity.y());
+      writeRegionData(out + 32U, simulator_->getAgentRadius(agentNo));
+      writeRegionData(out + 36U, simulator_->getAgentMaxSpeed(agentNo));
+      writeRegionData(out + 40U, simulator_->getAgentNeighborDist(agentNo));
+      writeRegionData(out + 44U, simulator_->getAgentTimeHorizon(agentNo));
+      writeRegionData(out + 48U, simulator_->getAgentTimeHorizonObst(agentNo));
+      writeRegionData(out + 52U, 0U, 4U);
+      writeRegionData(out + 56U, simulator_->getAgentMaxNeighbors(agentNo),
+                      8U);
+      out += RVO_REGION_DATA_AGENT_SIZE;
+    }
+  }
+}
+
+void RegionSimulator::setAgentId(std::size_t agentNo, std::size_t agentId) {
+  const std::size_t agentHandle = simulator_->getAgentHandle(agentNo);
+
+  if (agentHandle >= agentIds_.size()) {
+    agentIds_.resize(agentHandle + 1U);
+  }
+
+  agentIds_[agentHandle] = agentId;
+}
+} /* namespace RVO */
@@ -0,0 +1,226 @@
+/*
+ * RegionSimulator.h
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+#ifndef RVO_REGION_SIMULATOR_H_
+#define RVO_REGION_SIMULATOR_H_
+
+/**
+ * @file  RegionSimulator.h
+ * @brief Declares the RegionSimulator class.
+ */
+
+#include <cstddef>
+#include <vector>
+
+#include "Export.h"
+#include "Vector2.h"
+
+namespace RVO {
+class RVOSimulator;
+class Transport;
+
+/**
+ * @brief Defines one region of a simulation decomposed into a grid of
+ *        rectangular regions, each run by its own simulation in its own
+ *        process or thread. Each region owns the agents whose positions lie
+ *        in it and, before each simulation step, hands off the agents that
+ *        have left it and receives read-only copies, or ghost agents, of the
+ *        agents of the other regions near its borders, so that its agents
+ *        compute the same new velocities as in an undivided simulation.
+ */
+class RVO_EXPORT RegionSimulator {
+ public:
+  /**
+   * @brief     Constructs a region simulator instance.
+   * @param[in] simulator    The simulation of the region, with the obstacles
+   *                         of the whole simulation, which may be shared by
+   *                         the regions of the same process with
+   *                         RVOSimulator::setObstacleWorld().
+   * @param[in] transport    The transport between the regions. Its region
+   *                         number is the number of this region.
+   * @param[in] columnBounds The increasing x-coordinates of the borders
+   *                         between the columns of regions, one fewer than the
+   *                         columns. The outer columns are unbounded.
+   * @param[in] rowBounds    The increasing y-coordinates of the borders
+   *                         between the rows of regions, one fewer than the
+   *                         rows. The outer rows are unbounded.
+   * @param[in] haloWidth    The distance from its borders within which the
+   *                         agents of the other regions are copied to a
+   *                         region. At least the largest neighbor distance of
+   *                         any agent for the results to match an undivided
+   *                         simulation.
+   * @note      Regions are numbered by row, then by column. The number of
+   *            columns times the number of rows must equal the number of
+   *            regions of the transport, and the region number of the
+   *            transport must be less than it. Otherwise, getRegionNo()
+   *            returns RVO::RVO_ERROR and the region exchanges no agents. The
+   *            simulation and the transport are not owned by the region
+   *            simulator.
+   */
+  RegionSimulator(RVOSimulator *simulator, Transport *transport,
+                  const std::vector<float> &columnBounds,
+                  const std::vector<float> &rowBounds, float haloWidth);
+
+  /**
+   * @brief Destroys this region simulator instance.
+   */
+  ~RegionSimulator();
+
+  /**
+   * @brief     Adds a new agent with default properties to the simulation of
+   *            this region. It is handed off to the region in which it lies at
+   *            the next simulation step.
+   * @param[in] agentId  The identifier of the agent, unique among the agents
+   *                     of all regions.
+   * @param[in] position The two-dimensional starting position of this agent.
+   * @return    The number of the agent in the simulation of this region, or
+   *            RVO::RVO_ERROR when the agent defaults have not been set.
+   */
+  std::size_t addAgent(std::size_t agentId, const Vector2 &position);
+
+  /**
+   * @brief Exchanges agents with the other regions, then performs a
+   *        simulation step of the agents of this region. Called by every
+   *        region.
+   */
+  void doStep();
+
+  /**
+   * @brief Hands off the agents that have left this region to the regions in
+   *        which they lie, and replaces the ghost agents of this region with
+   *        those of the present positions of the agents of the other
+   *        regions. Called by every region.
+   */
+  void exchangeAgents();
+
+  /**
+   * @brief     Returns whether a specified agent of the simulation of this
+   *            region is a ghost agent, owned by another region. Ghost agents
+   *            are replaced at each simulation step, never stepped, and
+   *            reported as sleeping by RVOSimulator::getAgentSleeping().
+   * @param[in] agentNo The number of the agent in the simulation of this
+   *                    region.
+   * @return    True if the agent is a ghost agent.
+   */
+  bool getAgentGhost(std::size_t agentNo) const;
+
+  /**
+   * @brief     Returns the identifier of a specified agent of the simulation of
+   *            this region.
+   * @param[in] agentNo The number of the agent in the simulation of this
+   *                    region.
+   * @return    The identifier of the agent, unchanged when it is handed off to
+   *            another region.
+   */
+  std::size_t getAgentId(std::size_t agentNo) const;
+
+  /**
+   * @brief  Returns the distance from its borders within which the agents of
+   *         the other regions are copied to a region.
+   * @return The halo width.
+   */
+  float getHaloWidth() const { return haloWidth_; }
+
+  /**
+   * @brief  Returns the number of this region.
+   * @return The number of this region, or RVO::RVO_ERROR when the regions do
+   *         not match the regions of the transport.
+   */
+  std::size_t getRegionNo() const { return regionNo_; }
+
+  /**
+   * @brief     Returns the number of the region in which a specified
+   *            two-dimensional position lies.
+   * @param[in] position The two-dimensional position.
+   * @return    The number of the region.
+   */
+  std::size_t getRegionNo(const Vector2 &position) const;
+
+  /**
+   * @brief  Returns the simulation of this region.
+   * @return A pointer to the simulation of this region.
+   */
+  RVOSimulator *getSimulator() const { return simulator_; }
+
+ private:
+  /* Not implemented. */
+  RegionSimulator(const RegionSimulator &other);
+
+  /* Not implemented. */
+  RegionSimulator &operator=(const RegionSimulator &other);
+
+  /**
+   * @brief     Adds the agents and ghost agents received from another region
+   *            to the simulation of this region.
+   * @param[in] data The data received from the region.
+   */
+  void receiveAgents(const std::vector<unsigned char> &data);
+
+  /**
+   * @brief Removes the ghost agents from the simulation of this region.
+   */
+  void removeGhostAgents();
+
+  /**
+   * @brief     Writes the agents and ghost agents to be sent to a region.
+   * @param[in] regionNo      The number of the region.
+   * @param[in] agentNos      The numbers of the agents to be handed off to
+   *                          the region.
+   * @param[in] ghostAgentNos The numbers of the agents to be copied to the
+   *                          region as ghost agents.
+   */
+  void sendAgents(std::size_t regionNo,
+                  const std::vector<std::size_t> &agentNos,
+                  const std::vector<std::size_t> &ghostAgentNos);
+
+  /**
+   * @brief     Sets the identifier of a specified agent.
+   * @param[in] agentNo The number of the agent whose identifier is to be set.
+   * @param[in] agentId The identifier of the agent.
+   */
+  void setAgentId(std::size_t agentNo, std::size_t agentId);
+
+  std::vector<float> columnBounds_;
+  std::vector<float> rowBounds_;
+  std::vector<std::size_t> agentIds_;
+  std::vector<std::vector<unsigned char> > receiveBuffers_;
+  std::vector<std::vector<unsigned char> > sendBuffers_;
+  RVOSimulator *simulator_;
+  Transport *transport_;
+  std::size_t ghostAgentProfileNo_;
+  std::size_t regionNo_;
+  float haloWidth_;
+};
+} /* namespace RVO */
+
+#endif /* RVO_REGION_SIMULATOR_H_ */
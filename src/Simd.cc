@@ -0,0 +1,665 @@
+/*
+ * Simd.cc
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+/**
+ * @file  Simd.cc
+ * @brief Defines the vectorized kernels of the simulation.
+ */
+
+#include "Simd.h"
+
+#include <cmath>
+
+#include "Line.h"
+#include "Vector2.h"
+
+#if !defined(RVO_DISABLE_SIMD) &&                  \
+    (defined(__SSE2__) || defined(_M_X64) ||        \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define RVO_HAVE_SSE2 1
+#include <emmintrin.h>
+
+#if defined(__GNUC__)
+/* GCC and Clang compile individual functions for AVX and detect it at run
+ * time. */
+#define RVO_HAVE_AVX 1
+#include <immintrin.h>
+#endif /* __GNUC__ */
+#endif /* !RVO_DISABLE_SIMD && (__SSE2__ || _M_X64 || _M_IX86_FP >= 2) */
+
+#if !defined(RVO_DISABLE_SIMD) && defined(__aarch64__) && defined(__ARM_NEON)
+#define RVO_HAVE_NEON 1
+#include <arm_neon.h>
+#endif /* !RVO_DISABLE_SIMD && __aarch64__ && __ARM_NEON */
+
+namespace RVO {
+namespace {
+/**
+ * @relates AgentLineBatch
+ * @brief   Defines a function that computes the agent ORCA lines of a batch of
+ *          agent neighbors.
+ */
+typedef void (*AgentLinesFunction)(const AgentLineBatch &batch,
+                                   std::size_t numNeighbors,
+                                   const Vector2 &velocity,
+                                   float invTimeHorizon, float invTimeStep,
+                                   Line *lines);
+
+/**
+ * @brief Defines a function that computes the squared distances from a
+ *        position to an array of points.
+ */
+typedef void (*DistancesSqFunction)(const float *pointsX, const float *pointsY,
+                                    std::size_t numPoints,
+                                    const Vector2 &position, float *distSq);
+
+#if RVO_HAVE_AVX
+/**
+ * @brief  Returns whether the processor and operating system support AVX
+ *         instructions.
+ * @return True if AVX instructions are supported.
+ */
+bool supportsAvx() {
+  __builtin_cpu_init();
+
+  return __builtin_cpu_supports("avx") != 0;
+}
+#endif /* RVO_HAVE_AVX */
+
+/**
+ * @brief      Computes the squared distances from a position to an array of
+ *             points one point at a time. Also computes the remaining points
+ *             of the vectorized kernels.
+ * @param[in]  pointsX   The x-coordinates of the points.
+ * @param[in]  pointsY   The y-coordinates of the points.
+ * @param[in]  numPoints The number of points.
+ * @param[in]  position  The position.
+ * @param[out] distSq    The squared distances.
+ */
+void computeDistancesSqScalar(const float *pointsX, const float *pointsY,
+                              std::size_t numPoints, const Vector2 &position,
+                              float *distSq) {
+  for (std::size_t i = 0U; i < numPoints; ++i) {
+    const float distX = pointsX[i] - position.x();
+    const float distY = pointsY[i] - position.y();
+    distSq[i] = distX * distX + distY * distY;
+  }
+}
+
+#if !RVO_HAVE_SSE2 && !RVO_HAVE_NEON
+/**
+ * @relates    AgentLineBatch
+ * @brief      Computes the agent ORCA lines of a batch of agent neighbors one
+ *             neighbor at a time. The vectorized kernels perform the same
+ *             operations in the same order.
+ * @param[in]  batch          The batch of agent neighbors.
+ * @param[in]  numNeighbors   The number of agent neighbors in the batch.
+ * @param[in]  velocity       The velocity of the agent.
+ * @param[in]  invTimeHorizon The inverse of the time horizon of the agent.
+ * @param[in]  invTimeStep    The inverse of the time step of the simulation.
+ * @param[out] lines          The agent ORCA lines.
+ */
+void computeAgentLinesScalar(const AgentLineBatch &batch,
+                             std::size_t numNeighbors, const Vector2 &velocity,
+                             float invTimeHorizon, float invTimeStep,
+                             Line *lines) {
+  for (std::size_t i = 0U; i < numNeighbors; ++i) {
+    const Vector2 relativePosition(batch.relativePositionX[i],
+                                   batch.relativePositionY[i]);
+    const Vector2 relativeVelocity(batch.relativeVelocityX[i],
+                                   batch.relativeVelocityY[i]);
+    const float distSq = absSq(relativePosition);
+    const float combinedRadius = batch.combinedRadius[i];
+    const float combinedRadiusSq = combinedRadius * combinedRadius;
+
+    Line &line = lines[i];
+    Vector2 u;
+
+    if (distSq > combinedRadiusSq) {
+      /* No collision. */
+      const Vector2 w = relativeVelocity - invTimeHorizon * relativePosition;
+      /* Vector from cutoff center to relative velocity. */
+      const float wLengthSq = absSq(w);
+
+      const float dotProduct = w * relativePosition;
+
+      if (dotProduct < 0.0F &&
+          dotProduct * dotProduct > combinedRadiusSq * wLengthSq) {
+        /* Project on cut-off circle. */
+        const float wLength = std::sqrt(wLengthSq);
+        const Vector2 unitW = w / wLength;
+
+        line.direction = Vector2(unitW.y(), -unitW.x());
+        u = (combinedRadius * invTimeHorizon - wLength) * unitW;
+      } else {
+        /* Project on legs. */
+        const float leg = std::sqrt(distSq - combinedRadiusSq);
+
+        if (det(relativePosition, w) > 0.0F) {
+          /* Project on left leg. */
+          line.direction = Vector2(relativePosition.x() * leg -
+                                       relativePosition.y() * combinedRadius,
+                                   relativePosition.x() * combinedRadius +
+                                       relativePosition.y() * leg) /
+                           distSq;
+        } else {
+          /* Project on right leg. */
+          line.direction = -Vector2(relativePosition.x() * leg +
+                                        relativePosition.y() * combinedRadius,
+                                    -relativePosition.x() * combinedRadius +
+                                        relativePosition.y() * leg) /
+                           distSq;
+        }
+
+        u = (relativeVelocity * line.direction) * line.direction -
+            relativeVelocity;
+      }
+    } else {
+      /* Collision. Project on cut-off circle of time timeStep. */
+
+      /* Vector from cutoff center to relative velocity. */
+      const Vector2 w = relativeVelocity - invTimeStep * relativePosition;
+
+      const float wLength = abs(w);
+      const Vector2 unitW = w / wLength;
+
+      line.direction = Vector2(unitW.y(), -unitW.x());
+      u = (combinedRadius * invTimeStep - wLength) * unitW;
+    }
+
+    line.point = velocity + 0.5F * u;
+  }
+}
+#endif /* !RVO_HAVE_SSE2 && !RVO_HAVE_NEON */
+
+#if RVO_HAVE_SSE2 || RVO_HAVE_NEON
+/**
+ * @relates    AgentLineBatch
+ * @brief      Writes lanes of vectorized agent ORCA lines to lines.
+ * @param[in]  directionX   The x-coordinates of the directions of the lines.
+ * @param[in]  directionY   The y-coordinates of the directions of the lines.
+ * @param[in]  pointX       The x-coordinates of the points on the lines.
+ * @param[in]  pointY       The y-coordinates of the points on the lines.
+ * @param[in]  numLines     The number of lanes to write.
+ * @param[out] lines        The agent ORCA lines.
+ */
+void storeAgentLines(const float *directionX, const float *directionY,
+                     const float *pointX, const float *pointY,
+                     std::size_t numLines, Line *lines) {
+  for (std::size_t i = 0U; i < numLines; ++i) {
+    lines[i].direction = Vector2(directionX[i], directionY[i]);
+    lines[i].point = Vector2(pointX[i], pointY[i]);
+  }
+}
+#endif /* RVO_HAVE_SSE2 || RVO_HAVE_NEON */
+
+#if RVO_HAVE_SSE2
+/**
+ * @relates   AgentLineBatch
+ * @brief     Selects between the lanes of two vectors.
+ * @param[in] mask  The selection mask.
+ * @param[in] value The vector whose lanes are selected where the mask is set.
+ * @param[in] other The vector whose lanes are selected elsewhere.
+ * @return    The selected lanes.
+ */
+inline __m128 selectSse2(__m128 mask, __m128 value, __m128 other) {
+  return _mm_or_ps(_mm_and_ps(mask, value), _mm_andnot_ps(mask, other));
+}
+
+/**
+ * @relates AgentLineBatch
+ * @brief   Computes the agent ORCA lines of a batch of agent neighbors four
+ *          neighbors at a time using SSE2 instructions.
+ */
+void computeAgentLinesSse2(const AgentLineBatch &batch,
+                           std::size_t numNeighbors, const Vector2 &velocity,
+                           float invTimeHorizon, float invTimeStep,
+                           Line *lines) {
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0F);
+  const __m128 half = _mm_set1_ps(0.5F);
+  const __m128 signMask = _mm_set1_ps(-0.0F);
+  const __m128 invTimeHorizonV = _mm_set1_ps(invTimeHorizon);
+  const __m128 invTimeStepV = _mm_set1_ps(invTimeStep);
+  const __m128 velocityX = _mm_set1_ps(velocity.x());
+  const __m128 velocityY = _mm_set1_ps(velocity.y());
+
+  for (std::size_t i = 0U; i < numNeighbors; i += 4U) {
+    const __m128 px = _mm_loadu_ps(batch.relativePositionX + i);
+    const __m128 py = _mm_loadu_ps(batch.relativePositionY + i);
+    const __m128 vx = _mm_loadu_ps(batch.relativeVelocityX + i);
+    const __m128 vy = _mm_loadu_ps(batch.relativeVelocityY + i);
+    const __m128 r = _mm_loadu_ps(batch.combinedRadius + i);
+
+    const __m128 distSq = _mm_add_ps(_mm_mul_ps(px, px), _mm_mul_ps(py, py));
+    const __m128 rSq = _mm_mul_ps(r, r);
+    const __m128 collision = _mm_cmpngt_ps(distSq, rSq);
+
+    /* Cut-off circle, of time timeStep on collision. */
+    const __m128 s = selectSse2(collision, invTimeStepV, invTimeHorizonV);
+    const __m128 wx = _mm_sub_ps(vx, _mm_mul_ps(s, px));
+    const __m128 wy = _mm_sub_ps(vy, _mm_mul_ps(s, py));
+    const __m128 wLengthSq = _mm_add_ps(_mm_mul_ps(wx, wx), _mm_mul_ps(wy, wy));
+    const __m128 dotProduct =
+        _mm_add_ps(_mm_mul_ps(wx, px), _mm_mul_ps(wy, py));
+    const __m128 onCircle = _mm_or_ps(
+        collision,
+        _mm_and_ps(_mm_cmplt_ps(dotProduct, zero),
+                   _mm_cmpgt_ps(_mm_mul_ps(dotProduct, dotProduct),
+                                _mm_mul_ps(rSq, wLengthSq))));
+    const __m128 wLength = _mm_sqrt_ps(wLengthSq);
+    const __m128 invWLength = _mm_div_ps(one, wLength);
+    const __m128 unitWX = _mm_mul_ps(wx, invWLength);
+    const __m128 unitWY = _mm_mul_ps(wy, invWLength);
+    const __m128 scale = _mm_sub_ps(_mm_mul_ps(r, s), wLength);
+
+    /* Legs. */
+    const __m128 leg = _mm_sqrt_ps(_mm_sub_ps(distSq, rSq));
+    const __m128 invDistSq = _mm_div_ps(one, distSq);
+    const __m128 onLeftLeg = _mm_cmpgt_ps(
+        _mm_sub_ps(_mm_mul_ps(px, wy), _mm_mul_ps(py, wx)), zero);
+    const __m128 legX = selectSse2(
+        onLeftLeg,
+        _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(px, leg), _mm_mul_ps(py, r)),
+                   invDistSq),
+        _mm_xor_ps(
+            _mm_mul_ps(_mm_add_ps(_mm_mul_ps(px, leg), _mm_mul_ps(py, r)),
+                       invDistSq),
+            signMask));
+    const __m128 legY = selectSse2(
+        onLeftLeg,
+        _mm_mul_ps(_mm_add_ps(_mm_mul_ps(px, r), _mm_mul_ps(py, leg)),
+                   invDistSq),
+        _mm_xor_ps(
+            _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(py, leg), _mm_mul_ps(px, r)),
+                       invDistSq),
+            signMask));
+    const __m128 legDotProduct =
+        _mm_add_ps(_mm_mul_ps(vx, legX), _mm_mul_ps(vy, legY));
+
+    const __m128 ux =
+        selectSse2(onCircle, _mm_mul_ps(scale, unitWX),
+                   _mm_sub_ps(_mm_mul_ps(legX, legDotProduct), vx));
+    const __m128 uy =
+        selectSse2(onCircle, _mm_mul_ps(scale, unitWY),
+                   _mm_sub_ps(_mm_mul_ps(legY, legDotProduct), vy));
+
+    float directionX[4];
+    float directionY[4];
+    float pointX[4];
+    float pointY[4];
+
+    _mm_storeu_ps(directionX, selectSse2(onCircle, unitWY, legX));
+    _mm_storeu_ps(directionY,
+                  selectSse2(onCircle, _mm_xor_ps(unitWX, signMask), legY));
+    _mm_storeu_ps(pointX, _mm_add_ps(velocityX, _mm_mul_ps(half, ux)));
+    _mm_storeu_ps(pointY, _mm_add_ps(velocityY, _mm_mul_ps(half, uy)));
+
+    storeAgentLines(directionX, directionY, pointX, pointY,
+                    numNeighbors - i < 4U ? numNeighbors - i : 4U, lines + i);
+  }
+}
+
+/**
+ * @brief Computes the squared distances from a position to an array of points
+ *        four points at a time using SSE2 instructions.
+ */
+void computeDistancesSqSse2(const float *pointsX, const float *pointsY,
+                            std::size_t numPoints, const Vector2 &position,
+                            float *distSq) {
+  const __m128 positionX = _mm_set1_ps(position.x());
+  const __m128 positionY = _mm_set1_ps(position.y());
+  std::size_t i = 0U;
+
+  for (; i + 4U <= numPoints; i += 4U) {
+    const __m128 distX = _mm_sub_ps(_mm_loadu_ps(pointsX + i), positionX);
+    const __m128 distY = _mm_sub_ps(_mm_loadu_ps(pointsY + i), positionY);
+    _mm_storeu_ps(distSq + i, _mm_add_ps(_mm_mul_ps(distX, distX),
+                                         _mm_mul_ps(distY, distY)));
+  }
+
+  computeDistancesSqScalar(pointsX + i, pointsY + i, numPoints - i, position,
+                           distSq + i);
+}
+#endif /* RVO_HAVE_SSE2 */
+
+#if RVO_HAVE_AVX
+/**
+ * @relates   AgentLineBatch
+ * @brief     Selects between the lanes of two vectors.
+ * @param[in] mask  The selection mask.
+ * @param[in] value The vector whose lanes are selected where the mask is set.
+ * @param[in] other The vector whose lanes are selected elsewhere.
+ * @return    The selected lanes.
+ */
+__attribute__((target("avx"))) inline __m256 selectAvx(__m256 mask,
+                                                        __m256 value,
+                                                        __m256 other) {
+  return _mm256_blendv_ps(other, value, mask);
+}
+
+/**
+ * @relates AgentLineBatch
+ * @brief   Computes the agent ORCA lines of a batch of agent neighbors eight
+ *          neighbors at a time using AVX instructions.
+ */
+__attribute__((target("avx"))) void computeAgentLinesAvx(
+    const AgentLineBatch &batch, std::size_t numNeighbors,
+    const Vector2 &velocity, float invTimeHorizon, float invTimeStep,
+    Line *lines) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0F);
+  const __m256 half = _mm256_set1_ps(0.5F);
+  const __m256 signMask = _mm256_set1_ps(-0.0F);
+  const __m256 invTimeHorizonV = _mm256_set1_ps(invTimeHorizon);
+  const __m256 invTimeStepV = _mm256_set1_ps(invTimeStep);
+  const __m256 velocityX = _mm256_set1_ps(velocity.x());
+  const __m256 velocityY = _mm256_set1_ps(velocity.y());
+
+  const __m256 px = _mm256_loadu_ps(batch.relativePositionX);
+  const __m256 py = _mm256_loadu_ps(batch.relativePositionY);
+  const __m256 vx = _mm256_loadu_ps(batch.relativeVelocityX);
+  const __m256 vy = _mm256_loadu_ps(batch.relativeVelocityY);
+  const __m256 r = _mm256_loadu_ps(batch.combinedRadius);
+
+  const __m256 distSq =
+      _mm256_add_ps(_mm256_mul_ps(px, px), _mm256_mul_ps(py, py));
+  const __m256 rSq = _mm256_mul_ps(r, r);
+  const __m256 collision = _mm256_cmp_ps(distSq, rSq, _CMP_NGT_UQ);
+
+  /* Cut-off circle, of time timeStep on collision. */
+  const __m256 s = selectAvx(collision, invTimeStepV, invTimeHorizonV);
+  const __m256 wx = _mm256_sub_ps(vx, _mm256_mul_ps(s, px));
+  const __m256 wy = _mm256_sub_ps(vy, _mm256_mul_ps(s, py));
+  const __m256 wLengthSq =
+      _mm256_add_ps(_mm256_mul_ps(wx, wx), _mm256_mul_ps(wy, wy));
+  const __m256 dotProduct =
+      _mm256_add_ps(_mm256_mul_ps(wx, px), _mm256_mul_ps(wy, py));
+  const __m256 onCircle = _mm256_or_ps(
+      collision,
+      _mm256_and_ps(_mm256_cmp_ps(dotProduct, zero, _CMP_LT_OQ),
+                    _mm256_cmp_ps(_mm256_mul_ps(dotProduct, dotProduct),
+                                  _mm256_mul_ps(rSq, wLengthSq), _CMP_GT_OQ)));
+  const __m256 wLength = _mm256_sqrt_ps(wLengthSq);
+  const __m256 invWLength = _mm256_div_ps(one, wLength);
+  const __m256 unitWX = _mm256_mul_ps(wx, invWLength);
+  const __m256 unitWY = _mm256_mul_ps(wy, invWLength);
+  const __m256 scale = _mm256_sub_ps(_mm256_mul_ps(r, s), wLength);
+
+  /* Legs. */
+  const __m256 leg = _mm256_sqrt_ps(_mm256_sub_ps(distSq, rSq));
+  const __m256 invDistSq = _mm256_div_ps(one, distSq);
+  const __m256 onLeftLeg = _mm256_cmp_ps(
+      _mm256_sub_ps(_mm256_mul_ps(px, wy), _mm256_mul_ps(py, wx)), zero,
+      _CMP_GT_OQ);
+  const __m256 legX = selectAvx(
+      onLeftLeg,
+      _mm256_mul_ps(
+          _mm256_sub_ps(_mm256_mul_ps(px, leg), _mm256_mul_ps(py, r)),
+          invDistSq),
+      _mm256_xor_ps(
+          _mm256_mul_ps(
+              _mm256_add_ps(_mm256_mul_ps(px, leg), _mm256_mul_ps(py, r)),
+              invDistSq),
+          signMask));
+  const __m256 legY = selectAvx(
+      onLeftLeg,
+      _mm256_mul_ps(
+          _mm256_add_ps(_mm256_mul_ps(px, r), _mm256_mul_ps(py, leg)),
+          invDistSq),
+      _mm256_xor_ps(
+          _mm256_mul_ps(
+              _mm256_sub_ps(_mm256_mul_ps(py, leg), _mm256_mul_ps(px, r)),
+              invDistSq),
+          signMask));
+  const __m256 legDotProduct =
+      _mm256_add_ps(_mm256_mul_ps(vx, legX), _mm256_mul_ps(vy, legY));
+
+  const __m256 ux =
+      selectAvx(onCircle, _mm256_mul_ps(scale, unitWX),
+                _mm256_sub_ps(_mm256_mul_ps(legX, legDotProduct), vx));
+  const __m256 uy =
+      selectAvx(onCircle, _mm256_mul_ps(scale, unitWY),
+                _mm256_sub_ps(_mm256_mul_ps(legY, legDotProduct), vy));
+
+  float directionX[8];
+  float directionY[8];
+  float pointX[8];
+  float pointY[8];
+
+  _mm256_storeu_ps(directionX, selectAvx(onCircle, unitWY, legX));
+  _mm256_storeu_ps(
+      directionY, selectAvx(onCircle, _mm256_xor_ps(unitWX, signMask), legY));
+  _mm256_storeu_ps(pointX, _mm256_add_ps(velocityX, _mm256_mul_ps(half, ux)));
+  _mm256_storeu_ps(pointY, _mm256_add_ps(velocityY, _mm256_mul_ps(half, uy)));
+
+  storeAgentLines(directionX, directionY, pointX, pointY, numNeighbors, lines);
+}
+
+/**
+ * @brief Computes the squared distances from a position to an array of points
+ *        eight points at a time using AVX instructions.
+ */
+__attribute__((target("avx"))) void computeDistancesSqAvx(
+    const float *pointsX, const float *pointsY, std::size_t numPoints,
+    const Vector2 &position, float *distSq) {
+  const __m256 positionX = _mm256_set1_ps(position.x());
+  const __m256 positionY = _mm256_set1_ps(position.y());
+  std::size_t i = 0U;
+
+  for (; i + 8U <= numPoints; i += 8U) {
+    const __m256 distX =
+        _mm256_sub_ps(_mm256_loadu_ps(pointsX + i), positionX);
+    const __m256 distY =
+        _mm256_sub_ps(_mm256_loadu_ps(pointsY + i), positionY);
+    _mm256_storeu_ps(distSq + i, _mm256_add_ps(_mm256_mul_ps(distX, distX),
+                                               _mm256_mul_ps(distY, distY)));
+  }
+
+  computeDistancesSqSse2(pointsX + i, pointsY + i, numPoints - i, position,
+                         distSq + i);
+}
+#endif /* RVO_HAVE_AVX */
+
+#if RVO_HAVE_NEON
+/**
+ * @relates AgentLineBatch
+ * @brief   Computes the agent ORCA lines of a batch of agent neighbors four
+ *          neighbors at a time using NEON instructions.
+ */
+void computeAgentLinesNeon(const AgentLineBatch &batch,
+                           std::size_t numNeighbors, const Vector2 &velocity,
+                           float invTimeHorizon, float invTimeStep,
+                           Line *lines) {
+  const float32x4_t zero = vdupq_n_f32(0.0F);
+  const float32x4_t half = vdupq_n_f32(0.5F);
+  const float32x4_t invTimeHorizonV = vdupq_n_f32(invTimeHorizon);
+  const float32x4_t invTimeStepV = vdupq_n_f32(invTimeStep);
+  const float32x4_t velocityX = vdupq_n_f32(velocity.x());
+  const float32x4_t velocityY = vdupq_n_f32(velocity.y());
+
+  for (std::size_t i = 0U; i < numNeighbors; i += 4U) {
+    const float32x4_t px = vld1q_f32(batch.relativePositionX + i);
+    const float32x4_t py = vld1q_f32(batch.relativePositionY + i);
+    const float32x4_t vx = vld1q_f32(batch.relativeVelocityX + i);
+    const float32x4_t vy = vld1q_f32(batch.relativeVelocityY + i);
+    const float32x4_t r = vld1q_f32(batch.combinedRadius + i);
+
+    const float32x4_t distSq = vaddq_f32(vmulq_f32(px, px), vmulq_f32(py, py));
+    const float32x4_t rSq = vmulq_f32(r, r);
+    const uint32x4_t collision = vmvnq_u32(vcgtq_f32(distSq, rSq));
+
+    /* Cut-off circle, of time timeStep on collision. */
+    const float32x4_t s = vbslq_f32(collision, invTimeStepV, invTimeHorizonV);
+    const float32x4_t wx = vsubq_f32(vx, vmulq_f32(s, px));
+    const float32x4_t wy = vsubq_f32(vy, vmulq_f32(s, py));
+    const float32x4_t wLengthSq =
+        vaddq_f32(vmulq_f32(wx, wx), vmulq_f32(wy, wy));
+    const float32x4_t dotProduct =
+        vaddq_f32(vmulq_f32(wx, px), vmulq_f32(wy, py));
+    const uint32x4_t onCircle = vorrq_u32(
+        collision, vandq_u32(vcltq_f32(dotProduct, zero),
+                             vcgtq_f32(vmulq_f32(dotProduct, dotProduct),
+                                       vmulq_f32(rSq, wLengthSq))));
+    const float32x4_t wLength = vsqrtq_f32(wLengthSq);
+    const float32x4_t invWLength = vdivq_f32(vdupq_n_f32(1.0F), wLength);
+    const float32x4_t unitWX = vmulq_f32(wx, invWLength);
+    const float32x4_t unitWY = vmulq_f32(wy, invWLength);
+    const float32x4_t scale = vsubq_f32(vmulq_f32(r, s), wLength);
+
+    /* Legs. */
+    const float32x4_t leg = vsqrtq_f32(vsubq_f32(distSq, rSq));
+    const float32x4_t invDistSq = vdivq_f32(vdupq_n_f32(1.0F), distSq);
+    const uint32x4_t onLeftLeg =
+        vcgtq_f32(vsubq_f32(vmulq_f32(px, wy), vmulq_f32(py, wx)), zero);
+    const float32x4_t legX = vbslq_f32(
+        onLeftLeg,
+        vmulq_f32(vsubq_f32(vmulq_f32(px, leg), vmulq_f32(py, r)), invDistSq),
+        vnegq_f32(vmulq_f32(vaddq_f32(vmulq_f32(px, leg), vmulq_f32(py, r)),
+                            invDistSq)));
+    const float32x4_t legY = vbslq_f32(
+        onLeftLeg,
+        vmulq_f32(vaddq_f32(vmulq_f32(px, r), vmulq_f32(py, leg)), invDistSq),
+        vnegq_f32(vmulq_f32(vsubq_f32(vmulq_f32(py, leg), vmulq_f32(px, r)),
+                            invDistSq)));
+    const float32x4_t legDotProduct =
+        vaddq_f32(vmulq_f32(vx, legX), vmulq_f32(vy, legY));
+
+    const float32x4_t ux =
+        vbslq_f32(onCircle, vmulq_f32(scale, unitWX),
+                  vsubq_f32(vmulq_f32(legX, legDotProduct), vx));
+    const float32x4_t uy =
+        vbslq_f32(onCircle, vmulq_f32(scale, unitWY),
+                  vsubq_f32(vmulq_f32(legY, legDotProduct), vy));
+
+    float directionX[4];
+    float directionY[4];
+    float pointX[4];
+    float pointY[4];
+
+    vst1q_f32(directionX, vbslq_f32(onCircle, unitWY, legX));
+    vst1q_f32(directionY, vbslq_f32(onCircle, vnegq_f32(unitWX), legY));
+    vst1q_f32(pointX, vaddq_f32(velocityX, vmulq_f32(half, ux)));
+    vst1q_f32(pointY, vaddq_f32(velocityY, vmulq_f32(half, uy)));
+
+    storeAgentLines(directionX, directionY, pointX, pointY,
+                    numNeighbors - i < 4U ? numNeighbors - i : 4U, lines + i);
+  }
+}
+
+/**
+ * @brief Computes the squared distances from a position to an array of points
+ *        four points at a time using NEON instructions.
+ */
+void computeDistancesSqNeon(const float *pointsX, const float *pointsY,
+                            std::size_t numPoints, const Vector2 &position,
+                            float *distSq) {
+  const float32x4_t positionX = vdupq_n_f32(position.x());
+  const float32x4_t positionY = vdupq_n_f32(position.y());
+  std::size_t i = 0U;
+
+  for (; i + 4U <= numPoints; i += 4U) {
+    const float32x4_t distX = vsubq_f32(vld1q_f32(pointsX + i), positionX);
+    const float32x4_t distY = vsubq_f32(vld1q_f32(pointsY + i), positionY);
+    vst1q_f32(distSq + i,
+              vaddq_f32(vmulq_f32(distX, distX), vmulq_f32(distY, distY)));
+  }
+
+  computeDistancesSqScalar(pointsX + i, pointsY + i, numPoints - i, position,
+                           distSq + i);
+}
+#endif /* RVO_HAVE_NEON */
+
+/**
+ * @relates AgentLineBatch
+ * @brief   Selects the widest agent ORCA line kernel that the processor
+ *          supports.
+ * @return  The selected kernel.
+ */
+AgentLinesFunction selectAgentLinesFunction() {
+#if RVO_HAVE_AVX
+  if (supportsAvx()) {
+    return &computeAgentLinesAvx;
+  }
+#endif /* RVO_HAVE_AVX */
+
+#if RVO_HAVE_SSE2
+  return &computeAgentLinesSse2;
+#elif RVO_HAVE_NEON
+  return &computeAgentLinesNeon;
+#else
+  return &computeAgentLinesScalar;
+#endif /* RVO_HAVE_SSE2 */
+}
+
+/**
+ * @brief  Selects the widest squared distance kernel that the processor
+ *         supports.
+ * @return The selected kernel.
+ */
+DistancesSqFunction selectDistancesSqFunction() {
+#if RVO_HAVE_AVX
+  if (supportsAvx()) {
+    return &computeDistancesSqAvx;
+  }
+#endif /* RVO_HAVE_AVX */
+
+#if RVO_HAVE_SSE2
+  return &computeDistancesSqSse2;
+#elif RVO_HAVE_NEON
+  return &computeDistancesSqNeon;
+#else
+  return &computeDistancesSqScalar;
+#endif /* RVO_HAVE_SSE2 */
+}
+} /* namespace */
+
+void computeAgentLines(const AgentLineBatch &batch, std::size_t numNeighbors,
+                       const Vector2 &velocity, float invTimeHorizon,
+                       float invTimeStep, Line *lines) {
+  static const AgentLinesFunction agentLinesFunction =
+      selectAgentLinesFunction();
+
+  agentLinesFunction(batch, numNeighbors, velocity, invTimeHorizon,
+                     invTimeStep, lines);
+}
+
+void computeDistancesSq(const float *pointsX, const float *pointsY,
+                        std::size_t numPoints, const Vector2 &position,
+                        float *distSq) {
+  static const DistancesSqFunction distancesSqFunction =
+      selectDistancesSqFunction();
+
+  distancesSqFunction(pointsX, pointsY, numPoints, position, distSq);
+}
+} /* namespace RVO */
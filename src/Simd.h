@@ -0,0 +1,124 @@
+/*
+ * Simd.h
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+#ifndef RVO_SIMD_H_
+#define RVO_SIMD_H_
+
+/**
+ * @file  Simd.h
+ * @brief Declares the vectorized kernels of the simulation.
+ */
+
+#include <cstddef>
+
+namespace RVO {
+class Line;
+class Vector2;
+
+/**
+ * @brief The maximum number of agent neighbors in an agent line batch.
+ */
+const std::size_t RVO_AGENT_LINE_BATCH_SIZE = 8U;
+
+/**
+ * @brief Defines a batch of agent neighbors of an agent, stored as one array
+ *        per component so that they can be loaded into vector registers.
+ */
+class AgentLineBatch {
+ public:
+  /**
+   * @brief The x-coordinates of the positions of the neighbors relative to
+   *        the agent.
+   */
+  float relativePositionX[RVO_AGENT_LINE_BATCH_SIZE];
+
+  /**
+   * @brief The y-coordinates of the positions of the neighbors relative to
+   *        the agent.
+   */
+  float relativePositionY[RVO_AGENT_LINE_BATCH_SIZE];
+
+  /**
+   * @brief The x-coordinates of the velocity of the agent relative to the
+   *        neighbors.
+   */
+  float relativeVelocityX[RVO_AGENT_LINE_BATCH_SIZE];
+
+  /**
+   * @brief The y-coordinates of the velocity of the agent relative to the
+   *        neighbors.
+   */
+  float relativeVelocityY[RVO_AGENT_LINE_BATCH_SIZE];
+
+  /**
+   * @brief The sums of the radii of the agent and the neighbors.
+   */
+  float combinedRadius[RVO_AGENT_LINE_BATCH_SIZE];
+};
+
+/**
+ * @brief      Computes the agent ORCA lines of a batch of agent neighbors
+ *             using the widest vector instructions supported by the processor.
+ *             Gives the same results as the scalar computation.
+ * @param[in]  batch          The batch of agent neighbors. All elements of its
+ *                            arrays must be initialized, including those past
+ *                            numNeighbors.
+ * @param[in]  numNeighbors   The number of agent neighbors in the batch. Must
+ *                            not exceed RVO_AGENT_LINE_BATCH_SIZE.
+ * @param[in]  velocity       The velocity of the agent.
+ * @param[in]  invTimeHorizon The inverse of the time horizon of the agent.
+ * @param[in]  invTimeStep    The inverse of the time step of the simulation.
+ * @param[out] lines          An array of at least numNeighbors elements to
+ *                            which the agent ORCA lines are written.
+ */
+void computeAgentLines(const AgentLineBatch &batch, std::size_t numNeighbors,
+                       const Vector2 &velocity, float invTimeHorizon,
+                       float invTimeStep, Line *lines);
+
+/**
+ * @brief      Computes the squared distances from a position to an array of
+ *             points using the widest vector instructions supported by the
+ *             processor. Gives the same results as absSq().
+ * @param[in]  pointsX   The x-coordinates of the points.
+ * @param[in]  pointsY   The y-coordinates of the points.
+ * @param[in]  numPoints The number of points.
+ * @param[in]  position  The position.
+ * @param[out] distSq    An array of at least numPoints elements to which the
+ *                       squared distances are written.
+ */
+void computeDistancesSq(const float *pointsX, const float *pointsY,
+                        std::size_t numPoints, const Vector2 &position,
+                        float *distSq);
+} /* namespace RVO */
+
+#endif /* RVO_SIMD_H_ */
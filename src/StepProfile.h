@@ -0,0 +1,116 @@
+/*
+ * StepProfile.h
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+#ifndef RVO_STEP_PROFILE_H_
+#define RVO_STEP_PROFILE_H_
+
+/**
+ * @file  StepProfile.h
+ * @brief Declares the StepProfile class.
+ */
+
+#include <cstddef>
+
+#include "Export.h"
+
+namespace RVO {
+/**
+ * @brief Defines the wall time of each phase of a simulation step and counts
+ *        of the work done by the phases.
+ * @note  Only recorded when the library is built with RVO_ENABLE_PROFILING
+ *        defined. Otherwise all values remain zero.
+ */
+class RVO_EXPORT StepProfile {
+ public:
+  /**
+   * @brief Constructs a step profile instance with all values zero.
+   */
+  StepProfile();
+
+  /**
+   * @brief The number of agents inserted into the agent neighbors of an agent,
+   *        including those later displaced by nearer agents.
+   */
+  std::size_t agentNeighborsInserted;
+
+  /**
+   * @brief The number of agent k-D tree nodes visited by the agent neighbor
+   *        queries. Zero when the agent grid is searched instead.
+   */
+  std::size_t agentTreeNodesVisited;
+
+  /**
+   * @brief The wall time in seconds of building the agent k-D tree or agent
+   *        grid.
+   */
+  double buildAgentTreeTime;
+
+  /**
+   * @brief The wall time in seconds of computing the agent and obstacle
+   *        neighbors of the agents.
+   */
+  double computeAgentNeighborsTime;
+
+  /**
+   * @brief The wall time in seconds of computing the new velocities of the
+   *        agents.
+   */
+  double computeAgentNewVelocitiesTime;
+
+  /**
+   * @brief The number of agents for which the two-dimensional linear program
+   *        failed and the three-dimensional linear program was solved.
+   */
+  std::size_t linearProgram3Calls;
+
+  /**
+   * @brief The number of obstacle ORCA lines skipped because the velocity
+   *        obstacle of the obstacle was already covered by previous lines.
+   */
+  std::size_t obstacleLinesSkipped;
+
+  /**
+   * @brief The number of obstacle k-D tree nodes visited by the obstacle
+   *        neighbor queries.
+   */
+  std::size_t obstacleTreeNodesVisited;
+
+  /**
+   * @brief The wall time in seconds of updating the positions and velocities
+   *        of the agents.
+   */
+  double updateAgentsTime;
+};
+} /* namespace RVO */
+
+#endif /* RVO_STEP_PROFILE_H_ */
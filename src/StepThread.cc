@@ -0,0 +1,112 @@
+/*
+ * StepThread.cc
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+/**
+ * @file  StepThread.cc
+ * @brief Defines the StepThread class.
+ */
+
+#include "StepThread.h"
+
+namespace RVO {
+/* The thread is started last, once the members it reads are initialized. */
+StepThread::StepThread()
+    : function_(NULL),
+      userData_(NULL),
+      running_(false),
+      stopped_(false),
+      thread_(&StepThread::run, this) {}
+
+StepThread::~StepThread() {
+  wait();
+
+  {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+
+  startCondition_.notify_one();
+  thread_.join();
+}
+
+void StepThread::start(Function function, void *userData) {
+  {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    function_ = function;
+    userData_ = userData;
+    running_ = true;
+  }
+
+  startCondition_.notify_one();
+}
+
+void StepThread::wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  while (running_) {
+    finishCondition_.wait(lock);
+  }
+}
+
+void StepThread::run() {
+  for (;;) {
+    Function function = NULL;
+    void *userData = NULL;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+
+      while (!stopped_ && (!running_ || function_ == NULL)) {
+        startCondition_.wait(lock);
+      }
+
+      if (stopped_) {
+        break;
+      }
+
+      function = function_;
+      userData = userData_;
+      function_ = NULL;
+    }
+
+    function(userData);
+
+    {
+      const std::lock_guard<std::mutex> lock(mutex_);
+      running_ = false;
+    }
+
+    finishCondition_.notify_all();
+  }
+}
+} /* namespace RVO */
@@ -0,0 +1,106 @@
+/*
+ * StepThread.h
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+#ifndef RVO_STEP_THREAD_H_
+#define RVO_STEP_THREAD_H_
+
+/**
+ * @file  StepThread.h
+ * @brief Declares the StepThread class.
+ */
+
+#include <condition_variable> /* NOLINT(build/c++11) */
+#include <mutex>              /* NOLINT(build/c++11) */
+#include <thread>             /* NOLINT(build/c++11) */
+
+namespace RVO {
+/**
+ * @brief Defines a persistent thread that runs one function at a time in the
+ *        background, such as an asynchronous simulation step.
+ */
+class StepThread {
+ public:
+  /**
+   * @brief     Defines a function run by the thread.
+   * @param[in] userData The user data passed to start().
+   */
+  typedef void (*Function)(void *userData);
+
+  /**
+   * @brief Constructs a step thread instance and starts its thread.
+   */
+  StepThread();
+
+  /**
+   * @brief Waits for the function, if any, stops the thread, and destroys
+   *        this step thread instance.
+   */
+  ~StepThread();
+
+  /**
+   * @brief     Starts running a function on the thread and returns at once.
+   * @param[in] function The function to be run.
+   * @param[in] userData User data passed to the function.
+   * @note      Must not be called again before wait().
+   */
+  void start(Function function, void *userData);
+
+  /**
+   * @brief Waits until the function started last, if any, has returned.
+   */
+  void wait();
+
+ private:
+  /* Not implemented. */
+  StepThread(const StepThread &other);
+
+  /* Not implemented. */
+  StepThread &operator=(const StepThread &other);
+
+  /**
+   * @brief Waits for functions and runs them until the thread is stopped.
+   */
+  void run();
+
+  std::mutex mutex_;
+  std::condition_variable startCondition_;
+  std::condition_variable finishCondition_;
+  Function function_;
+  void *userData_;
+  bool running_;
+  bool stopped_;
+  std::thread thread_;
+};
+} /* namespace RVO */
+
+#endif /* RVO_STEP_THREAD_H_ */
@@ -0,0 +1,153 @@
+/*
+ * ThreadPool.cc
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+/**
+ * @file  ThreadPool.cc
+ * @brief Defines the ThreadPool class.
+ */
+
+#include "ThreadPool.h"
+
+namespace RVO {
+ThreadPool::ThreadPool(std::size_t numThreads)
+    : nextItem_(0U),
+      task_(NULL),
+      userData_(NULL),
+      chunkSize_(1U),
+      generation_(0U),
+      numItems_(0U),
+      numRunning_(0U),
+      stopped_(false) {
+  for (std::size_t i = 1U; i < numThreads; ++i) {
+    threads_.push_back(std::thread(&ThreadPool::runWorker, this, i));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+
+  startCondition_.notify_all();
+
+  for (std::size_t i = 0U; i < threads_.size(); ++i) {
+    threads_[i].join();
+  }
+}
+
+std::size_t ThreadPool::getNumThreads() const { return threads_.size() + 1U; }
+
+void ThreadPool::parallelFor(std::size_t numItems, std::size_t chunkSize,
+                             Task task, void *userData) {
+  if (chunkSize == 0U) {
+    chunkSize = 1U;
+  }
+
+  if (threads_.empty() || numItems <= chunkSize) {
+    /* Not worth waking the pool. */
+    task(0U, numItems, 0U, userData);
+    return;
+  }
+
+  {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    task_ = task;
+    userData_ = userData;
+    chunkSize_ = chunkSize;
+    numItems_ = numItems;
+    numRunning_ = threads_.size();
+    nextItem_.store(0U, std::memory_order_relaxed);
+    ++generation_;
+  }
+
+  startCondition_.notify_all();
+
+  runTask(0U);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  while (numRunning_ != 0U) {
+    finishCondition_.wait(lock);
+  }
+}
+
+void ThreadPool::runTask(std::size_t threadNo) {
+  for (;;) {
+    const std::size_t begin =
+        nextItem_.fetch_add(chunkSize_, std::memory_order_relaxed);
+
+    if (begin >= numItems_) {
+      break;
+    }
+
+    const std::size_t end =
+        numItems_ - begin < chunkSize_ ? numItems_ : begin + chunkSize_;
+
+    task_(begin, end, threadNo, userData_);
+  }
+}
+
+void ThreadPool::runWorker(std::size_t threadNo) {
+  std::size_t generation = 0U;
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+
+      while (!stopped_ && generation_ == generation) {
+        startCondition_.wait(lock);
+      }
+
+      if (stopped_) {
+        break;
+      }
+
+      generation = generation_;
+    }
+
+    runTask(threadNo);
+
+    bool finished = false;
+
+    {
+      const std::lock_guard<std::mutex> lock(mutex_);
+      finished = --numRunning_ == 0U;
+    }
+
+    if (finished) {
+      finishCondition_.notify_one();
+    }
+  }
+}
+} /* namespace RVO */
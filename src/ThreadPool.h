@@ -0,0 +1,125 @@
+/*
+ * ThreadPool.h
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+#ifndef RVO_THREAD_POOL_H_
+#define RVO_THREAD_POOL_H_
+
+/**
+ * @file  ThreadPool.h
+ * @brief Declares the ThreadPool class.
+ */
+
+#include <atomic>             /* NOLINT(build/c++11) */
+#include <condition_variable> /* NOLINT(build/c++11) */
+#include <cstddef>
+#include <mutex>  /* NOLINT(build/c++11) */
+#include <thread> /* NOLINT(build/c++11) */
+#include <vector>
+
+#include "Executor.h"
+
+namespace RVO {
+/**
+ * @brief Defines a persistent pool of threads that runs parallel loops by
+ *        handing out ranges of items dynamically, so that threads that finish
+ *        early take over the remaining items.
+ */
+class ThreadPool : public Executor {
+ public:
+  /**
+   * @brief     Constructs a thread pool instance and starts its threads.
+   * @param[in] numThreads The number of threads, including the thread that
+   *                       calls parallelFor(). At least one.
+   */
+  explicit ThreadPool(std::size_t numThreads);
+
+  /**
+   * @brief Stops the threads and destroys this thread pool instance.
+   */
+  ~ThreadPool();
+
+  /**
+   * @brief  Returns the number of threads that may run a parallel loop.
+   * @return The number of threads, including the calling thread.
+   */
+  std::size_t getNumThreads() const;
+
+  /**
+   * @brief     Runs a parallel loop on the calling thread, as thread zero, and
+   *            on the threads of the pool.
+   * @param[in] numItems  The number of items.
+   * @param[in] chunkSize The number of items in a range.
+   * @param[in] task      The function to be called on each range.
+   * @param[in] userData  User data passed to the function.
+   * @note      Must not be called concurrently or from within a task.
+   */
+  void parallelFor(std::size_t numItems, std::size_t chunkSize, Task task,
+                   void *userData);
+
+ private:
+  /* Not implemented. */
+  ThreadPool(const ThreadPool &other);
+
+  /* Not implemented. */
+  ThreadPool &operator=(const ThreadPool &other);
+
+  /**
+   * @brief     Processes ranges of items of the present parallel loop until
+   *            none remain.
+   * @param[in] threadNo The number of the calling thread.
+   */
+  void runTask(std::size_t threadNo);
+
+  /**
+   * @brief     Waits for parallel loops and processes their items until the
+   *            pool is stopped. The function of each thread of the pool.
+   * @param[in] threadNo The number of the calling thread.
+   */
+  void runWorker(std::size_t threadNo);
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable startCondition_;
+  std::condition_variable finishCondition_;
+  std::atomic<std::size_t> nextItem_;
+  Task task_;
+  void *userData_;
+  std::size_t chunkSize_;
+  std::size_t generation_;
+  std::size_t numItems_;
+  std::size_t numRunning_;
+  bool stopped_;
+};
+} /* namespace RVO */
+
+#endif /* RVO_THREAD_POOL_H_ */
@@ -0,0 +1,151 @@
+/*
+ * TrajectoryFormat.cc
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+/**
+ * @file  TrajectoryFormat.cc
+ * @brief Defines the encoding of trajectory files.
+ */
+
+#include "TrajectoryFormat.h"
+
+#include <cstring>
+#include <limits>
+
+namespace RVO {
+const unsigned char *readTrajectoryDelta(const unsigned char *data,
+                                         const unsigned char *end, int *value) {
+  std::size_t bits = 0U;
+  data = readTrajectoryVarint(data, end, &bits);
+
+  if (data == NULL || bits > std::numeric_limits<unsigned int>::max()) {
+    return NULL;
+  }
+
+  const unsigned int zigzag = static_cast<unsigned int>(bits);
+  const int magnitude = static_cast<int>(zigzag >> 1U);
+  *value = (zigzag & 1U) != 0U ? -magnitude - 1 : magnitude;
+
+  return data;
+}
+
+std::size_t readTrajectoryData(const unsigned char *data, std::size_t numBytes,
+                               bool &valid) { /* NOLINT(runtime/references) */
+  std::size_t value = 0U;
+
+  for (std::size_t i = numBytes; i-- != 0U;) {
+    if (value > (std::numeric_limits<std::size_t>::max() >> 8U)) {
+      valid = false;
+    }
+
+    value = (value << 8U) | data[i];
+  }
+
+  return value;
+}
+
+float readTrajectoryData(const unsigned char *data) {
+  bool valid = true;
+  const unsigned int bits =
+      static_cast<unsigned int>(readTrajectoryData(data, 4U, valid));
+  float value = 0.0F;
+  std::memcpy(&value, &bits, sizeof(value));
+
+  return value;
+}
+
+const unsigned char *readTrajectoryVarint(const unsigned char *data,
+                                          const unsigned char *end,
+                                          std::size_t *value) {
+  const std::size_t numDigits = std::numeric_limits<std::size_t>::digits;
+  std::size_t result = 0U;
+
+  for (std::size_t shift = 0U; data != end; shift += 7U) {
+    const std::size_t byte = *data++;
+    const std::size_t bits = byte & 0x7FU;
+
+    if (shift >= numDigits) {
+      if (bits != 0U) {
+        return NULL;
+      }
+    } else {
+      if (shift + 7U > numDigits && (bits >> (numDigits - shift)) != 0U) {
+        return NULL;
+      }
+
+      result |= bits << shift;
+    }
+
+    if ((byte & 0x80U) == 0U) {
+      *value = result;
+
+      return data;
+    }
+  }
+
+  return NULL;
+}
+
+unsigned char *writeTrajectoryDelta(unsigned char *data, int value) {
+  /* Maps small magnitudes of either sign to small unsigned integers. */
+  const unsigned int zigzag =
+      value < 0 ? (static_cast<unsigned int>(-(value + 1)) << 1U) | 1U
+                : static_cast<unsigned int>(value) << 1U;
+
+  return writeTrajectoryVarint(data, zigzag);
+}
+
+void writeTrajectoryData(unsigned char *data, std::size_t value,
+                         std::size_t numBytes) {
+  for (std::size_t i = 0U; i < numBytes; ++i) {
+    data[i] = static_cast<unsigned char>(value & 0xFFU);
+    value >>= 8U;
+  }
+}
+
+void writeTrajectoryData(unsigned char *data, float value) {
+  unsigned int bits = 0U;
+  std::memcpy(&bits, &value, sizeof(bits));
+  writeTrajectoryData(data, bits, 4U);
+}
+
+unsigned char *writeTrajectoryVarint(unsigned char *data, std::size_t value) {
+  while (value >= 0x80U) {
+    *data++ = static_cast<unsigned char>((value & 0x7FU) | 0x80U);
+    value >>= 7U;
+  }
+
+  *data++ = static_cast<unsigned char>(value);
+
+  return data;
+}
+} /* namespace RVO */
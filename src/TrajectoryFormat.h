@@ -0,0 +1,182 @@
+/*
+ * TrajectoryFormat.h
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+#ifndef RVO_TRAJECTORY_FORMAT_H_
+#define RVO_TRAJECTORY_FORMAT_H_
+
+/**
+ * @file  TrajectoryFormat.h
+ * @brief Declares the encoding of trajectory files written by the
+ *        TrajectoryRecorder class and read by the TrajectoryReader class.
+ *
+ * A trajectory file consists of a header, a sequence of chunks of frames, an
+ * index of the chunks and the times of the frames, and a footer, all stored
+ * little-endian. Each chunk lists the handles of its agents, which do not
+ * change within the chunk, followed by the positions and velocities of the
+ * agents in each frame, quantized to integers. The first frame of a chunk
+ * stores the integers themselves and each later frame their differences from
+ * the previous frame, all as zigzag variable-length integers.
+ */
+
+#include <cstddef>
+
+namespace RVO {
+/**
+ * @brief The magic number at the start of a trajectory file.
+ */
+const char RVO_TRAJECTORY_MAGIC[8] = {'R', 'V', 'O', '2', 'T', 'R', 'A', 'J'};
+
+/**
+ * @brief The magic number at the end of a trajectory file.
+ */
+const char RVO_TRAJECTORY_END_MAGIC[8] = {'R', 'V', 'O', '2',
+                                          'T', 'E', 'N', 'D'};
+
+/**
+ * @brief The version of the trajectory file format.
+ */
+const std::size_t RVO_TRAJECTORY_VERSION = 1U;
+
+/**
+ * @brief The size in bytes of the header of a trajectory file: the magic
+ *        number, the version, and the position and velocity quanta.
+ */
+const std::size_t RVO_TRAJECTORY_HEADER_SIZE = 32U;
+
+/**
+ * @brief The size in bytes of an entry of the index of a trajectory file: the
+ *        offset of the chunk, the number of its first frame, its number of
+ *        agents and its number of frames.
+ */
+const std::size_t RVO_TRAJECTORY_CHUNK_SIZE = 24U;
+
+/**
+ * @brief The size in bytes of the footer of a trajectory file: the offset of
+ *        the index, the numbers of chunks and frames, and the end magic
+ *        number.
+ */
+const std::size_t RVO_TRAJECTORY_FOOTER_SIZE = 32U;
+
+/**
+ * @brief The largest magnitude of a quantized coordinate, chosen so that the
+ *        difference of two coordinates fits in an int.
+ */
+const int RVO_TRAJECTORY_MAX_QUANTIZED = (1 << 30) - 1;
+
+/**
+ * @brief The largest size in bytes of a zigzag variable-length integer.
+ */
+const std::size_t RVO_TRAJECTORY_MAX_DELTA_SIZE = 5U;
+
+/**
+ * @brief The largest size in bytes of an unsigned variable-length integer.
+ */
+const std::size_t RVO_TRAJECTORY_MAX_VARINT_SIZE = 10U;
+
+/**
+ * @brief      Reads a zigzag variable-length integer from trajectory data.
+ * @param[in]  data  A pointer to the integer.
+ * @param[in]  end   One past the end of the data.
+ * @param[out] value The integer.
+ * @return     A pointer past the integer, or NULL if it is truncated or too
+ *             large.
+ */
+const unsigned char *readTrajectoryDelta(const unsigned char *data,
+                                         const unsigned char *end, int *value);
+
+/**
+ * @brief          Reads a little-endian unsigned integer from trajectory data.
+ * @param[in]      data     A pointer to the integer.
+ * @param[in]      numBytes The size in bytes of the integer.
+ * @param[in, out] valid    Set to false if the integer does not fit in a
+ *                          std::size_t.
+ * @return         The integer.
+ */
+std::size_t readTrajectoryData(const unsigned char *data, std::size_t numBytes,
+                               bool &valid); /* NOLINT(runtime/references) */
+
+/**
+ * @brief     Reads a 32-bit float from trajectory data.
+ * @param[in] data A pointer to the float.
+ * @return    The float.
+ */
+float readTrajectoryData(const unsigned char *data);
+
+/**
+ * @brief      Reads an unsigned variable-length integer from trajectory data.
+ * @param[in]  data  A pointer to the integer.
+ * @param[in]  end   One past the end of the data.
+ * @param[out] value The integer.
+ * @return     A pointer past the integer, or NULL if it is truncated or does
+ *             not fit in a std::size_t.
+ */
+const unsigned char *readTrajectoryVarint(const unsigned char *data,
+                                          const unsigned char *end,
+                                          std::size_t *value);
+
+/**
+ * @brief     Writes a zigzag variable-length integer to trajectory data.
+ * @param[in] data  A pointer to at least RVO_TRAJECTORY_MAX_DELTA_SIZE bytes
+ *                  to which the integer is written.
+ * @param[in] value The integer.
+ * @return    A pointer past the integer.
+ */
+unsigned char *writeTrajectoryDelta(unsigned char *data, int value);
+
+/**
+ * @brief     Writes a little-endian unsigned integer to trajectory data.
+ * @param[in] data     A pointer to the integer.
+ * @param[in] value    The integer.
+ * @param[in] numBytes The size in bytes of the integer.
+ */
+void writeTrajectoryData(unsigned char *data, std::size_t value,
+                         std::size_t numBytes);
+
+/**
+ * @brief     Writes a 32-bit float to trajectory data.
+ * @param[in] data  A pointer to the float.
+ * @param[in] value The float.
+ */
+void writeTrajectoryData(unsigned char *data, float value);
+
+/**
+ * @brief     Writes an unsigned variable-length integer to trajectory data.
+ * @param[in] data  A pointer to at least RVO_TRAJECTORY_MAX_VARINT_SIZE bytes
+ *                  to which the integer is written.
+ * @param[in] value The integer.
+ * @return    A pointer past the integer.
+ */
+unsigned char *writeTrajectoryVarint(unsigned char *data, std::size_t value);
+} /* namespace RVO */
+
+#endif /* RVO_TRAJECTORY_FORMAT_H_ */
@@ -0,0 +1,376 @@
+/*
+ * TrajectoryReader.cc
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+/**
+ * @file  TrajectoryReader.cc
+ * @brief Defines the TrajectoryReader class.
+ */
+
+#include "TrajectoryReader.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif /* _WIN32 */
+
+#include "TrajectoryFormat.h"
+
+namespace RVO {
+namespace {
+/**
+ * @relates TrajectoryReader
+ * @brief   Maps a file into memory for reading.
+ * @param[in]  path The path of the file.
+ * @param[out] size The size in bytes of the file.
+ * @return     A pointer to the mapped file, or NULL if it could not be opened
+ *             or mapped, or is empty.
+ */
+const unsigned char *mapTrajectoryFile(const char *path, std::size_t *size) {
+  void *data = NULL;
+#ifdef _WIN32
+  const HANDLE file =
+      CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                  FILE_ATTRIBUTE_NORMAL, NULL);
+
+  if (file == INVALID_HANDLE_VALUE) {
+    return NULL;
+  }
+
+  LARGE_INTEGER fileSize;
+
+  if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+    const HANDLE mapping =
+        CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (mapping != NULL) {
+      /* The view keeps the mapping and file open once their handles close. */
+      data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);
+    }
+
+    *size = static_cast<std::size_t>(fileSize.QuadPart);
+  }
+
+  CloseHandle(file);
+#else
+  const int file = ::open(path, O_RDONLY);
+
+  if (file < 0) {
+    return NULL;
+  }
+
+  struct stat status;
+
+  if (fstat(file, &status) == 0 && status.st_size > 0) {
+    /* The mapping keeps the file open once its descriptor closes. */
+    *size = static_cast<std::size_t>(status.st_size);
+    data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, file, 0);
+
+    if (data == MAP_FAILED) {
+      data = NULL;
+    }
+  }
+
+  ::close(file);
+#endif /* _WIN32 */
+
+  return static_cast<const unsigned char *>(data);
+}
+
+/**
+ * @relates TrajectoryReader
+ * @brief   Unmaps a file mapped by mapTrajectoryFile() from memory.
+ * @param[in] data A pointer to the mapped file.
+ * @param[in] size The size in bytes of the file.
+ */
+void unmapTrajectoryFile(const unsigned char *data, std::size_t size) {
+  void *const view = const_cast<unsigned char *>(data);
+#ifdef _WIN32
+  static_cast<void>(size);
+  UnmapViewOfFile(view);
+#else
+  munmap(view, size);
+#endif /* _WIN32 */
+}
+} /* namespace */
+
+TrajectoryReader::TrajectoryReader()
+    : data_(NULL),
+      index_(NULL),
+      frameTimes_(NULL),
+      cachedFrameEnd_(NULL),
+      cachedChunkNo_(0U),
+      cachedFrameNo_(0U),
+      numChunks_(0U),
+      numFrames_(0U),
+      size_(0U),
+      positionQuantum_(0.0F),
+      velocityQuantum_(0.0F) {}
+
+TrajectoryReader::~TrajectoryReader() { close(); }
+
+void TrajectoryReader::close() {
+  if (data_ != NULL) {
+    unmapTrajectoryFile(data_, size_);
+  }
+
+  std::vector<std::size_t>().swap(handles_);
+  std::vector<int>().swap(quantized_);
+  data_ = NULL;
+  index_ = NULL;
+  frameTimes_ = NULL;
+  cachedFrameEnd_ = NULL;
+  numChunks_ = 0U;
+  numFrames_ = 0U;
+  size_ = 0U;
+  positionQuantum_ = 0.0F;
+  velocityQuantum_ = 0.0F;
+}
+
+std::size_t TrajectoryReader::getFrameChunkNo(std::size_t frameNo) const {
+  std::size_t begin = 0U;
+  std::size_t end = numChunks_;
+
+  /* The last chunk whose first frame is no later than the frame. */
+  while (end - begin > 1U) {
+    const std::size_t middle = begin + (end - begin) / 2U;
+    bool valid = true;
+
+    if (readTrajectoryData(index_ + middle * RVO_TRAJECTORY_CHUNK_SIZE + 8U,
+                           8U, valid) <= frameNo) {
+      begin = middle;
+    } else {
+      end = middle;
+    }
+  }
+
+  return begin;
+}
+
+std::size_t TrajectoryReader::getFrameNumAgents(std::size_t frameNo) const {
+  if (frameNo >= numFrames_) {
+    return 0U;
+  }
+
+  bool valid = true;
+
+  return readTrajectoryData(
+      index_ + getFrameChunkNo(frameNo) * RVO_TRAJECTORY_CHUNK_SIZE + 16U, 4U,
+      valid);
+}
+
+float TrajectoryReader::getFrameTime(std::size_t frameNo) const {
+  if (frameNo >= numFrames_) {
+    return 0.0F;
+  }
+
+  return readTrajectoryData(frameTimes_ + 4U * frameNo);
+}
+
+bool TrajectoryReader::open(const char *path) {
+  close();
+
+  std::size_t size = 0U;
+  const unsigned char *const data = mapTrajectoryFile(path, &size);
+
+  if (data == NULL) {
+    return false;
+  }
+
+  const std::size_t headerEnd = RVO_TRAJECTORY_HEADER_SIZE;
+  bool valid =
+      size >= RVO_TRAJECTORY_HEADER_SIZE + RVO_TRAJECTORY_FOOTER_SIZE &&
+      std::memcmp(data, RVO_TRAJECTORY_MAGIC, sizeof(RVO_TRAJECTORY_MAGIC)) ==
+          0 &&
+      std::memcmp(data + size - sizeof(RVO_TRAJECTORY_END_MAGIC),
+                  RVO_TRAJECTORY_END_MAGIC,
+                  sizeof(RVO_TRAJECTORY_END_MAGIC)) == 0;
+  std::size_t indexOffset = 0U;
+  std::size_t numChunks = 0U;
+  std::size_t numFrames = 0U;
+  float positionQuantum = 0.0F;
+  float velocityQuantum = 0.0F;
+
+  if (valid) {
+    const unsigned char *const footer =
+        data + size - RVO_TRAJECTORY_FOOTER_SIZE;
+    const std::size_t indexEnd = size - RVO_TRAJECTORY_FOOTER_SIZE;
+
+    valid = readTrajectoryData(data + 8U, 4U, valid) == RVO_TRAJECTORY_VERSION;
+    positionQuantum = readTrajectoryData(data + 16U);
+    velocityQuantum = readTrajectoryData(data + 20U);
+    indexOffset = readTrajectoryData(footer, 8U, valid);
+    numChunks = readTrajectoryData(footer + 8U, 8U, valid);
+    numFrames = readTrajectoryData(footer + 16U, 8U, valid);
+
+    /* The index is the chunk entries followed by the frame times. */
+    valid = valid && positionQuantum > 0.0F && velocityQuantum > 0.0F &&
+            indexOffset >= headerEnd && indexOffset <= indexEnd &&
+            numChunks <= (indexEnd - indexOffset) / RVO_TRAJECTORY_CHUNK_SIZE;
+
+    if (valid) {
+      const std::size_t timesSize =
+          indexEnd - indexOffset - numChunks * RVO_TRAJECTORY_CHUNK_SIZE;
+      valid = numFrames <= timesSize / 4U && timesSize == 4U * numFrames;
+    }
+  }
+
+  std::size_t chunkOffset = headerEnd;
+  std::size_t chunkFrameNo = 0U;
+
+  for (std::size_t i = 0U; valid && i < numChunks; ++i) {
+    const unsigned char *const entry =
+        data + indexOffset + i * RVO_TRAJECTORY_CHUNK_SIZE;
+    const std::size_t offset = readTrajectoryData(entry, 8U, valid);
+    const std::size_t firstFrameNo = readTrajectoryData(entry + 8U, 8U, valid);
+    const std::size_t chunkNumFrames =
+        readTrajectoryData(entry + 20U, 4U, valid);
+
+    valid = valid && offset >= chunkOffset && offset <= indexOffset &&
+            firstFrameNo == chunkFrameNo && chunkNumFrames > 0U &&
+            chunkNumFrames <= numFrames - chunkFrameNo;
+    chunkOffset = offset;
+    chunkFrameNo += chunkNumFrames;
+  }
+
+  if (!valid || chunkFrameNo != numFrames) {
+    unmapTrajectoryFile(data, size);
+
+    return false;
+  }
+
+  data_ = data;
+  index_ = data + indexOffset;
+  frameTimes_ = index_ + numChunks * RVO_TRAJECTORY_CHUNK_SIZE;
+  numChunks_ = numChunks;
+  numFrames_ = numFrames;
+  size_ = size;
+  positionQuantum_ = positionQuantum;
+  velocityQuantum_ = velocityQuantum;
+
+  return true;
+}
+
+bool TrajectoryReader::readFrame(std::size_t frameNo, std::size_t *handles,
+                                 Vector2 *positions, Vector2 *velocities) {
+  if (frameNo >= numFrames_) {
+    return false;
+  }
+
+  const std::size_t chunkNo = getFrameChunkNo(frameNo);
+  const unsigned char *const entry =
+      index_ + chunkNo * RVO_TRAJECTORY_CHUNK_SIZE;
+  bool valid = true;
+  const std::size_t firstFrameNo = readTrajectoryData(entry + 8U, 8U, valid);
+  const std::size_t numAgents = readTrajectoryData(entry + 16U, 4U, valid);
+  const unsigned char *const end =
+      chunkNo + 1U < numChunks_
+          ? data_ + readTrajectoryData(entry + RVO_TRAJECTORY_CHUNK_SIZE, 8U,
+                                       valid)
+          : index_;
+  const unsigned char *in = cachedFrameEnd_;
+  std::size_t nextFrameNo = cachedFrameNo_ + 1U;
+
+  /* Frames are decoded from the cached frame when it precedes the frame in
+   * the same chunk, and otherwise from the start of the chunk. */
+  if (in == NULL || cachedChunkNo_ != chunkNo || cachedFrameNo_ > frameNo) {
+    in = data_ + readTrajectoryData(entry, 8U, valid);
+    nextFrameNo = firstFrameNo;
+
+    /* Each handle takes at least one byte. */
+    if (numAgents > static_cast<std::size_t>(end - in)) {
+      in = NULL;
+    } else {
+      handles_.resize(numAgents);
+      quantized_.assign(4U * numAgents, 0);
+    }
+
+    for (std::size_t i = 0U; in != NULL && i < numAgents; ++i) {
+      in = readTrajectoryVarint(in, end, &handles_[i]);
+    }
+  }
+
+  for (; in != NULL && nextFrameNo <= frameNo; ++nextFrameNo) {
+    for (std::size_t i = 0U; in != NULL && i < quantized_.size(); ++i) {
+      int delta = 0;
+      in = readTrajectoryDelta(in, end, &delta);
+
+      if (in != NULL &&
+          (delta > 0 ? quantized_[i] > RVO_TRAJECTORY_MAX_QUANTIZED - delta
+                     : quantized_[i] < -RVO_TRAJECTORY_MAX_QUANTIZED - delta)) {
+        in = NULL;
+      } else if (in != NULL) {
+        quantized_[i] += delta;
+      }
+    }
+  }
+
+  cachedFrameEnd_ = in;
+
+  if (in == NULL) {
+    return false;
+  }
+
+  cachedChunkNo_ = chunkNo;
+  cachedFrameNo_ = frameNo;
+
+  const double positionQuantum = positionQuantum_;
+  const double velocityQuantum = velocityQuantum_;
+
+  for (std::size_t i = 0U; i < numAgents; ++i) {
+    const int *const values = &quantized_[4U * i];
+
+    if (handles != NULL) {
+      handles[i] = handles_[i];
+    }
+
+    if (positions != NULL) {
+      positions[i] = Vector2(static_cast<float>(values[0] * positionQuantum),
+                             static_cast<float>(values[1] * positionQuantum));
+    }
+
+    if (velocities != NULL) {
+      velocities[i] = Vector2(static_cast<float>(values[2] * velocityQuantum),
+                              static_cast<float>(values[3] * velocityQuantum));
+    }
+  }
+
+  return true;
+}
+} /* namespace RVO */
@@ -0,0 +1,169 @@
+/*
+ * TrajectoryReader.h
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+#ifndef RVO_TRAJECTORY_READER_H_
+#define RVO_TRAJECTORY_READER_H_
+
+/**
+ * @file  TrajectoryReader.h
+ * @brief Declares the TrajectoryReader class.
+ */
+
+#include <cstddef>
+#include <vector>
+
+#include "Export.h"
+#include "Vector2.h"
+
+namespace RVO {
+/**
+ * @brief Defines a reader of the trajectory files written by
+ *        TrajectoryRecorder, which maps a file into memory and decodes any of
+ *        its frames on demand. Reading the frames of a chunk in order decodes
+ *        each frame once.
+ */
+class RVO_EXPORT TrajectoryReader {
+ public:
+  /**
+   * @brief Constructs a trajectory reader instance with no file open.
+   */
+  TrajectoryReader();
+
+  /**
+   * @brief Closes the file, if any, and destroys this trajectory reader
+   *        instance.
+   */
+  ~TrajectoryReader();
+
+  /**
+   * @brief Closes the file, if any, unmapping it from memory.
+   */
+  void close();
+
+  /**
+   * @brief     Returns the number of agents in the specified frame.
+   * @param[in] frameNo The number of the frame.
+   * @return    The number of agents in the frame, or zero if there is no such
+   *            frame.
+   */
+  std::size_t getFrameNumAgents(std::size_t frameNo) const;
+
+  /**
+   * @brief     Returns the global time of the simulation at the specified
+   *            frame.
+   * @param[in] frameNo The number of the frame.
+   * @return    The global time at the frame, or zero if there is no such
+   *            frame.
+   */
+  float getFrameTime(std::size_t frameNo) const;
+
+  /**
+   * @brief  Returns the number of frames in the file.
+   * @return The number of frames, or zero if no file is open.
+   */
+  std::size_t getNumFrames() const { return numFrames_; }
+
+  /**
+   * @brief  Returns the precision to which the positions were recorded.
+   * @return The position quantum, or zero if no file is open.
+   */
+  float getPositionQuantum() const { return positionQuantum_; }
+
+  /**
+   * @brief  Returns the precision to which the velocities were recorded.
+   * @return The velocity quantum, or zero if no file is open.
+   */
+  float getVelocityQuantum() const { return velocityQuantum_; }
+
+  /**
+   * @brief  Returns whether a file is open.
+   * @return True if a file is open.
+   */
+  bool isOpen() const { return data_ != NULL; }
+
+  /**
+   * @brief     Opens a trajectory file for reading and maps it into memory,
+   *            closing the file, if any, that is open.
+   * @param[in] path The path of the file.
+   * @return    True if the file was opened and its header and index are valid.
+   */
+  bool open(const char *path);
+
+  /**
+   * @brief      Decodes the specified frame.
+   * @param[in]  frameNo    The number of the frame.
+   * @param[out] handles    An array of getFrameNumAgents() elements to which
+   *                        the handles of the agents are written, or NULL.
+   * @param[out] positions  An array of getFrameNumAgents() elements to which
+   *                        the positions of the agents are written, or NULL.
+   * @param[out] velocities An array of getFrameNumAgents() elements to which
+   *                        the velocities of the agents are written, or NULL.
+   * @return     True if the frame was decoded, false if there is no such frame
+   *             or its data is corrupt.
+   */
+  bool readFrame(std::size_t frameNo, std::size_t *handles,
+                 Vector2 *positions, Vector2 *velocities);
+
+ private:
+  /* Not implemented. */
+  TrajectoryReader(const TrajectoryReader &other);
+
+  /* Not implemented. */
+  TrajectoryReader &operator=(const TrajectoryReader &other);
+
+  /**
+   * @brief     Returns the number of the chunk that contains the specified
+   *            frame.
+   * @param[in] frameNo The number of the frame. Must be less than the number
+   *                    of frames.
+   * @return    The number of the chunk.
+   */
+  std::size_t getFrameChunkNo(std::size_t frameNo) const;
+
+  std::vector<std::size_t> handles_;
+  std::vector<int> quantized_;
+  const unsigned char *data_;
+  const unsigned char *index_;
+  const unsigned char *frameTimes_;
+  const unsigned char *cachedFrameEnd_;
+  std::size_t cachedChunkNo_;
+  std::size_t cachedFrameNo_;
+  std::size_t numChunks_;
+  std::size_t numFrames_;
+  std::size_t size_;
+  float positionQuantum_;
+  float velocityQuantum_;
+};
+} /* namespace RVO */
+
+#endif /* RVO_TRAJECTORY_READER_H_ */
@@ -0,0 +1,282 @@
+/*
+ * TrajectoryRecorder.cc
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+/**
+ * @file  TrajectoryRecorder.cc
+ * @brief Defines the TrajectoryRecorder class.
+ */
+
+#include "TrajectoryRecorder.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "RVOSimulator.h"
+#include "StepThread.h"
+#include "TrajectoryFormat.h"
+
+namespace RVO {
+namespace {
+/**
+ * @relates TrajectoryRecorder
+ * @brief   Quantizes a coordinate to the nearest multiple of a quantum.
+ * @param[in] value      The coordinate.
+ * @param[in] invQuantum The inverse of the quantum.
+ * @return    The number of multiples of the quantum, clamped to
+ *            RVO_TRAJECTORY_MAX_QUANTIZED in magnitude.
+ */
+int quantizeTrajectoryValue(float value, double invQuantum) {
+  const double multiples =
+      std::floor(static_cast<double>(value) * invQuantum + 0.5);
+
+  /* Not a number. */
+  if (multiples != multiples) {
+    return 0;
+  }
+
+  if (multiples >= RVO_TRAJECTORY_MAX_QUANTIZED) {
+    return RVO_TRAJECTORY_MAX_QUANTIZED;
+  }
+
+  if (multiples <= -RVO_TRAJECTORY_MAX_QUANTIZED) {
+    return -RVO_TRAJECTORY_MAX_QUANTIZED;
+  }
+
+  return static_cast<int>(multiples);
+}
+} /* namespace */
+
+TrajectoryRecorder::TrajectoryRecorder()
+    : file_(NULL),
+      writeThread_(NULL),
+      framesPerChunk_(0U),
+      numFrames_(0U),
+      numWrittenFrames_(0U),
+      offset_(0U),
+      positionQuantum_(0.0F),
+      velocityQuantum_(0.0F),
+      failed_(false) {}
+
+TrajectoryRecorder::~TrajectoryRecorder() { close(); }
+
+bool TrajectoryRecorder::close() {
+  if (file_ == NULL) {
+    return false;
+  }
+
+  if (!chunk_.times.empty()) {
+    flushChunk();
+  }
+
+  writeThread_->wait();
+  delete writeThread_;
+  writeThread_ = NULL;
+
+  buffer_.assign(RVO_TRAJECTORY_FOOTER_SIZE, 0U);
+  writeTrajectoryData(&buffer_[0U], offset_, 8U);
+  writeTrajectoryData(&buffer_[8U], index_.size() / RVO_TRAJECTORY_CHUNK_SIZE,
+                      8U);
+  writeTrajectoryData(&buffer_[16U], numWrittenFrames_, 8U);
+  std::memcpy(&buffer_[24U], RVO_TRAJECTORY_END_MAGIC,
+              sizeof(RVO_TRAJECTORY_END_MAGIC));
+
+  bool written = !failed_;
+
+  if (written && !index_.empty()) {
+    written = std::fwrite(&index_.front(), 1U, index_.size(), file_) ==
+                  index_.size() &&
+              std::fwrite(&frameTimes_.front(), 1U, frameTimes_.size(),
+                          file_) == frameTimes_.size();
+  }
+
+  written = written && std::fwrite(&buffer_.front(), 1U, buffer_.size(),
+                                   file_) == buffer_.size();
+  written = std::fclose(file_) == 0 && written;
+  file_ = NULL;
+
+  std::vector<unsigned char>().swap(buffer_);
+  std::vector<unsigned char>().swap(frameTimes_);
+  std::vector<unsigned char>().swap(index_);
+  std::vector<int>().swap(quantized_);
+
+  return written;
+}
+
+void TrajectoryRecorder::flushChunk() {
+  writeThread_->wait();
+
+  pendingChunk_.handles.swap(chunk_.handles);
+  pendingChunk_.positions.swap(chunk_.positions);
+  pendingChunk_.times.swap(chunk_.times);
+  pendingChunk_.velocities.swap(chunk_.velocities);
+  chunk_.handles.clear();
+  chunk_.positions.clear();
+  chunk_.times.clear();
+  chunk_.velocities.clear();
+
+  writeThread_->start(&TrajectoryRecorder::writeChunkTask, this);
+}
+
+bool TrajectoryRecorder::open(const char *path, float positionQuantum,
+                              float velocityQuantum,
+                              std::size_t framesPerChunk) {
+  close();
+
+  if (!(positionQuantum > 0.0F) || !(velocityQuantum > 0.0F) ||
+      framesPerChunk == 0U) {
+    return false;
+  }
+
+  std::FILE *const file = std::fopen(path, "wb");
+
+  if (file == NULL) {
+    return false;
+  }
+
+  unsigned char header[RVO_TRAJECTORY_HEADER_SIZE] = {0U};
+  std::memcpy(header, RVO_TRAJECTORY_MAGIC, sizeof(RVO_TRAJECTORY_MAGIC));
+  writeTrajectoryData(header + 8U, RVO_TRAJECTORY_VERSION, 4U);
+  writeTrajectoryData(header + 16U, positionQuantum);
+  writeTrajectoryData(header + 20U, velocityQuantum);
+
+  if (std::fwrite(header, 1U, sizeof(header), file) != sizeof(header)) {
+    std::fclose(file);
+
+    return false;
+  }
+
+  file_ = file;
+  writeThread_ = new StepThread();
+  framesPerChunk_ = framesPerChunk;
+  numFrames_ = 0U;
+  numWrittenFrames_ = 0U;
+  offset_ = sizeof(header);
+  positionQuantum_ = positionQuantum;
+  velocityQuantum_ = velocityQuantum;
+  failed_ = false;
+
+  return true;
+}
+
+void TrajectoryRecorder::recordFrame(const RVOSimulator &simulator) {
+  if (file_ == NULL) {
+    return;
+  }
+
+  const std::vector<std::size_t> &handles = simulator.agentHandles_;
+
+  if (!chunk_.times.empty() &&
+      (chunk_.times.size() == framesPerChunk_ || chunk_.handles != handles)) {
+    flushChunk();
+  }
+
+  if (chunk_.times.empty()) {
+    chunk_.handles = handles;
+  }
+
+  chunk_.positions.insert(chunk_.positions.end(),
+                          simulator.agentPositions_.begin(),
+                          simulator.agentPositions_.end());
+  chunk_.times.push_back(simulator.globalTime_);
+  chunk_.velocities.insert(chunk_.velocities.end(),
+                           simulator.agentVelocities_.begin(),
+                           simulator.agentVelocities_.end());
+  ++numFrames_;
+}
+
+void TrajectoryRecorder::writeChunk() {
+  const std::size_t numAgents = pendingChunk_.handles.size();
+  const std::size_t numFrames = pendingChunk_.times.size();
+  const double invPositionQuantum = 1.0 / positionQuantum_;
+  const double invVelocityQuantum = 1.0 / velocityQuantum_;
+
+  buffer_.resize(numAgents * RVO_TRAJECTORY_MAX_VARINT_SIZE +
+                 numFrames * numAgents * 4U * RVO_TRAJECTORY_MAX_DELTA_SIZE +
+                 1U);
+  unsigned char *const begin = &buffer_.front();
+  unsigned char *out = begin;
+
+  for (std::size_t i = 0U; i < numAgents; ++i) {
+    out = writeTrajectoryVarint(out, pendingChunk_.handles[i]);
+  }
+
+  /* The first frame is stored as its differences from zero. */
+  quantized_.assign(4U * numAgents, 0);
+
+  for (std::size_t i = 0U; i < numFrames * numAgents; ++i) {
+    const Vector2 &position = pendingChunk_.positions[i];
+    const Vector2 &velocity = pendingChunk_.velocities[i];
+    int *const previous = &quantized_[4U * (i % numAgents)];
+    const int values[4] = {
+        quantizeTrajectoryValue(position.x(), invPositionQuantum),
+        quantizeTrajectoryValue(position.y(), invPositionQuantum),
+        quantizeTrajectoryValue(velocity.x(), invVelocityQuantum),
+        quantizeTrajectoryValue(velocity.y(), invVelocityQuantum)};
+
+    for (std::size_t j = 0U; j < 4U; ++j) {
+      out = writeTrajectoryDelta(out, values[j] - previous[j]);
+      previous[j] = values[j];
+    }
+  }
+
+  const std::size_t size = static_cast<std::size_t>(out - begin);
+
+  if (failed_ || std::fwrite(begin, 1U, size, file_) != size) {
+    failed_ = true;
+
+    return;
+  }
+
+  const std::size_t indexSize = index_.size();
+  index_.resize(indexSize + RVO_TRAJECTORY_CHUNK_SIZE);
+  writeTrajectoryData(&index_[indexSize], offset_, 8U);
+  writeTrajectoryData(&index_[indexSize + 8U], numWrittenFrames_, 8U);
+  writeTrajectoryData(&index_[indexSize + 16U], numAgents, 4U);
+  writeTrajectoryData(&index_[indexSize + 20U], numFrames, 4U);
+
+  const std::size_t frameTimesSize = frameTimes_.size();
+  frameTimes_.resize(frameTimesSize + 4U * numFrames);
+
+  for (std::size_t i = 0U; i < numFrames; ++i) {
+    writeTrajectoryData(&frameTimes_[frameTimesSize + 4U * i],
+                        pendingChunk_.times[i]);
+  }
+
+  numWrittenFrames_ += numFrames;
+  offset_ += size;
+}
+
+void TrajectoryRecorder::writeChunkTask(void *recorder) {
+  static_cast<TrajectoryRecorder *>(recorder)->writeChunk();
+}
+} /* namespace RVO */
@@ -0,0 +1,194 @@
+/*
+ * TrajectoryRecorder.h
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+#ifndef RVO_TRAJECTORY_RECORDER_H_
+#define RVO_TRAJECTORY_RECORDER_H_
+
+/**
+ * @file  TrajectoryRecorder.h
+ * @brief Declares the TrajectoryRecorder class.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#include "Export.h"
+#include "Vector2.h"
+
+namespace RVO {
+class RVOSimulator;
+class StepThread;
+
+/**
+ * @brief Defines a recorder of the positions and velocities of the agents of a
+ *        simulation at each step to a trajectory file, which TrajectoryReader
+ *        reads. Frames are recorded in chunks, which are quantized, delta
+ *        compressed and written on a background thread while the next chunk
+ *        is recorded.
+ */
+class RVO_EXPORT TrajectoryRecorder {
+ public:
+  /**
+   * @brief Constructs a trajectory recorder instance with no file open.
+   */
+  TrajectoryRecorder();
+
+  /**
+   * @brief Closes the file, if any, and destroys this trajectory recorder
+   *        instance.
+   */
+  ~TrajectoryRecorder();
+
+  /**
+   * @brief  Writes the frames not yet written and the index of the frames,
+   *         then closes the file.
+   * @return True if the file was open and every frame recorded since it was
+   *         opened was written successfully.
+   */
+  bool close();
+
+  /**
+   * @brief  Returns the number of frames recorded since the file was opened.
+   * @return The number of frames recorded.
+   */
+  std::size_t getNumFrames() const { return numFrames_; }
+
+  /**
+   * @brief  Returns whether a file is open.
+   * @return True if a file is open.
+   */
+  bool isOpen() const { return file_ != NULL; }
+
+  /**
+   * @brief     Opens a trajectory file for writing, closing the file, if any,
+   *            that is open.
+   * @param[in] path            The path of the file, which is replaced if it
+   *                            exists.
+   * @param[in] positionQuantum The precision to which positions are recorded.
+   *                            Must be positive. Positions are rounded to the
+   *                            nearest multiple and clamped to about one
+   *                            billion multiples from the origin.
+   * @param[in] velocityQuantum The precision to which velocities are recorded.
+   *                            Must be positive.
+   * @param[in] framesPerChunk  The largest number of frames in a chunk. Must be
+   *                            positive. Larger chunks compress better but
+   *                            take more memory and more time to seek into.
+   * @return    True if the file was opened.
+   */
+  bool open(const char *path, float positionQuantum, float velocityQuantum,
+            std::size_t framesPerChunk);
+
+  /**
+   * @brief     Records the positions and velocities of the agents of a
+   *            simulation and its global time as a frame, if a file is open.
+   *            Starts a new chunk when the agents, or their order, differ
+   *            from those of the previous frame.
+   * @param[in] simulator The simulation.
+   * @note      Must not be called while an asynchronous step of the
+   *            simulation is pending. Use RVOSimulator::setTrajectoryRecorder()
+   *            to record every step, including asynchronous steps.
+   */
+  void recordFrame(const RVOSimulator &simulator);
+
+ private:
+  /**
+   * @brief Defines the frames of a chunk of a trajectory file.
+   */
+  class Chunk {
+   public:
+    /**
+     * @brief The handles of the agents of the frames.
+     */
+    std::vector<std::size_t> handles;
+
+    /**
+     * @brief The positions of the agents in each frame, frame after frame.
+     */
+    std::vector<Vector2> positions;
+
+    /**
+     * @brief The global times of the frames.
+     */
+    std::vector<float> times;
+
+    /**
+     * @brief The velocities of the agents in each frame, frame after frame.
+     */
+    std::vector<Vector2> velocities;
+  };
+
+  /* Not implemented. */
+  TrajectoryRecorder(const TrajectoryRecorder &other);
+
+  /* Not implemented. */
+  TrajectoryRecorder &operator=(const TrajectoryRecorder &other);
+
+  /**
+   * @brief Waits until the chunk being written, if any, is written, then
+   *        starts writing the chunk being recorded.
+   */
+  void flushChunk();
+
+  /**
+   * @brief Encodes the chunk being written and writes it to the file. Run on
+   *        the background thread.
+   */
+  void writeChunk();
+
+  /**
+   * @brief     Writes the chunk being written. The function run on the
+   *            background thread.
+   * @param[in] recorder The trajectory recorder.
+   */
+  static void writeChunkTask(void *recorder);
+
+  std::vector<unsigned char> buffer_;
+  std::vector<unsigned char> frameTimes_;
+  std::vector<unsigned char> index_;
+  std::vector<int> quantized_;
+  Chunk chunk_;
+  Chunk pendingChunk_;
+  std::FILE *file_;
+  StepThread *writeThread_;
+  std::size_t framesPerChunk_;
+  std::size_t numFrames_;
+  std::size_t numWrittenFrames_;
+  std::size_t offset_;
+  float positionQuantum_;
+  float velocityQuantum_;
+  bool failed_;
+};
+} /* namespace RVO */
+
+#endif /* RVO_TRAJECTORY_RECORDER_H_ */
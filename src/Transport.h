@@ -0,0 +1,89 @@
+/*
+ * Transport.h
+ * RVO2 Library
+ *
+ * SPDX-FileCopyrightText: 2008 University of North Carolina at Chapel Hill
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Please send all bug reports to <geom@cs.unc.edu>.
+ *
+ * The authors may be contacted via:
+ *
+ * Jur van den Berg, Stephen J. Guy, Jamie Snape, Ming C. Lin, Dinesh Manocha
+ * Dept. of Computer Science
+ * 201 S. Columbia St.
+ * Frederick P. Brooks, Jr. Computer Science Bldg.
+ * Chapel Hill, N.C. 27599-3175
+ * United States of America
+ *
+ * <https://gamma.cs.unc.edu/RVO2/>
+ */
+
+#ifndef RVO_TRANSPORT_H_
+#define RVO_TRANSPORT_H_
+
+/**
+ * @file  Transport.h
+ * @brief Declares the Transport class.
+ */
+
+#include <cstddef>
+#include <vector>
+
+#include "Export.h"
+
+namespace RVO {
+/**
+ * @brief Defines an interface to the communication between the regions of a
+ *        decomposed simulation, each run by a RegionSimulator in its own
+ *        process or thread. May be implemented on top of MPI or sockets.
+ */
+class RVO_EXPORT Transport {
+ public:
+  /**
+   * @brief Destroys this transport instance.
+   */
+  virtual ~Transport();
+
+  /**
+   * @brief      Sends data to every other region and receives the data that
+   *             every other region sends to this one, as MPI_Alltoallv()
+   *             would. Called by every region once for each simulation step,
+   *             and returns once all data for this region has been received.
+   * @param[in]  sendBuffers    The data to be sent to each region, listed by
+   *                            region number. The data for this region is
+   *                            empty.
+   * @param[out] receiveBuffers The data received from each region, listed by
+   *                            region number, to be resized to fit.
+   */
+  virtual void exchange(const std::vector<unsigned char> *sendBuffers,
+                        std::vector<unsigned char> *receiveBuffers) = 0;
+
+  /**
+   * @brief  Returns the number of regions, the same in every region.
+   * @return The number of regions, at least one.
+   */
+  virtual std::size_t getNumRegions() const = 0;
+
+  /**
+   * @brief  Returns the number of the region of this transport, as an MPI rank
+   *         would be.
+   * @return The number of the region, less than getNumRegions().
+   */
+  virtual std::size_t getRegionNo() const = 0;
+};
+} /* namespace RVO */
+
+#endif /* RVO_TRANSPORT_H_ */